@@ -1,193 +1,484 @@
 #include "ap33772.hpp"
 
 AP33772 *AP33772::inst = nullptr;
+AP33772 *AP33772::int_owner = nullptr;
 
-AP33772::AP33772() : i2c(I2C()), num_pdo(0), req_pps_volt(0), exist_pps(0), pps_index(0) {
+AP33772::AP33772()
+    : i2c(I2C()), regs(&i2c), num_pdo(0), req_pps_volt(0), exist_pps(0), pps_index(0) {
   reset();
   begin();
 }
 
+/*
+ * INT is raised for every event in AP33772_EVENT_MASK and drops when
+ * CMD_STATUS is read. The pin IRQ is level triggered and masks itself, then
+ * a DMA read of CMD_STATUS runs the state machine from its completion
+ * callback. New source capabilities chain reads of CMD_PDONUM and
+ * CMD_SRCPDO, and a request made before they arrived chains the RDO write.
+ * The pin is unmasked when the chain ends, no event is lost meanwhile.
+ */
 void AP33772::begin() {
-  read_from_reg(CMD_STATUS, 1);
-  status.read_status = read_buff[0];
+  set_mask((AP33772_MASKS)AP33772_EVENT_MASK);
+  init_pins();
+  poll();  // pick up anything latched before we were listening
+}
 
-  if (status.is_ovp) event_flag.ovp = 1;
-  if (status.is_ocp) event_flag.ocp = 1;
+void AP33772::init_pins() {
+  if (AP33772_INTERRUPT_PIN == PIN_UNUSED || int_owner == this) return;
+  gpio_init(AP33772_INTERRUPT_PIN);
+  gpio_set_dir(AP33772_INTERRUPT_PIN, GPIO_IN);
+  if (AP33772_INT_LEVEL == GPIO_IRQ_LEVEL_HIGH)
+    gpio_pull_down(AP33772_INTERRUPT_PIN);
+  else
+    gpio_pull_up(AP33772_INTERRUPT_PIN);
+
+  int_owner = this;
+  gpio_add_raw_irq_handler(AP33772_INTERRUPT_PIN, int_isr);
+  gpio_set_irq_enabled(AP33772_INTERRUPT_PIN, AP33772_INT_LEVEL, true);
+  irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+void AP33772::poll() {
+  uint32_t save = save_and_disable_interrupts();
+  status_pending = true;
+  start_status_read();
+  restore_interrupts(save);
+}
+
+void AP33772::int_isr() {
+  if (!(gpio_get_irq_event_mask(AP33772_INTERRUPT_PIN) & AP33772_INT_LEVEL)) return;
+  gpio_set_irq_enabled(AP33772_INTERRUPT_PIN, AP33772_INT_LEVEL, false);
+  int_owner->status_pending = true;
+  int_owner->start_status_read();
+}
+
+/* called from IRQ context or with interrupts disabled */
+void AP33772::start_status_read() {
+  if (!status_pending || neg_busy) return;
+  status_pending = false;
+  neg_busy = true;
+  if (!neg_read(NEG_STATUS, CMD_STATUS, neg_buff, 1)) {
+    /* queue full, the still-active pin retries */
+    neg_busy = false;
+    if (AP33772_INTERRUPT_PIN != PIN_UNUSED)
+      gpio_set_irq_enabled(AP33772_INTERRUPT_PIN, AP33772_INT_LEVEL, true);
+  }
+}
+
+bool AP33772::neg_read(NEG_STEP step, AP33772_CMDS cmd, uint8_t *dst, size_t len) {
+  neg_step = step;
+  neg_reg = cmd;
+  return i2c.read_async(&neg_xfer, AP33772_ADDRESS, &neg_reg, dst, len, neg_done, this);
+}
+
+/* I2C IRQ context */
+void AP33772::neg_done(I2CTransfer *xfer, void *ctx) {
+  AP33772 *self = static_cast<AP33772 *>(ctx);
+  if (xfer->result >= 0) {
+    switch (self->neg_step) {
+      case NEG_STATUS:
+        if (self->on_status() &&
+            self->neg_read(NEG_PDONUM, CMD_PDONUM, &self->neg_buff[SRCPDO_LENGTH], 1))
+          return;
+        break;
+      case NEG_PDONUM:
+        if (self->neg_read(NEG_SRCPDO, CMD_SRCPDO, self->neg_buff, SRCPDO_LENGTH))
+          return;
+        break;
+      case NEG_SRCPDO:
+        if (self->on_pdos()) return;
+        break;
+      case NEG_RDO:
+        break;
+    }
+  }
+  self->finish_neg();
+}
+
+/* @return true if new source capabilities should be read */
+bool AP33772::on_status() {
+  status.read_status = neg_buff[0];
+  bool fetch = false;
 
   if (status.is_ready) {  // negotiation finished
     if (status.is_new_pdo) {
-      if (status.is_successful)
+      if (status.is_successful) {
         event_flag.new_neg_success = 1;
-      else
+        fetch = true;
+      } else {
         event_flag.new_neg_fail = 1;
+        state = AP33772_REJECTED;
+        emit(AP33772_FAILED);
+      }
     } else {
-      if (status.is_successful)
+      if (status.is_successful) {
         event_flag.neg_success = 1;
-      else
+        state = AP33772_CONTRACT;
+        emit(AP33772_ACCEPTED);
+      } else {
         event_flag.neg_failed = 1;
+        state = AP33772_REJECTED;
+        emit(AP33772_FAILED);
+      }
     }
   }
-  sleep_ms(10);
 
-  // if negotiation is good, load in PDOs from charger
-  if (event_flag.new_neg_success) {
-    event_flag.new_neg_success = 0;
-
-    read_from_reg(CMD_PDONUM, 1);
-    num_pdo = read_buff[0];
+  if (status.is_ovp) event_flag.ovp = 1;
+  if (status.is_ocp) event_flag.ocp = 1;
+  if (status.is_otp) event_flag.otp = 1;
+  if (status.is_ovp || status.is_ocp || status.is_otp) {
+    state = AP33772_FAULT;
+    emit(AP33772_PROTECTION);
+  }
+  if (status.is_dr) {
+    event_flag.dr = 1;
+    emit(AP33772_DERATING);
+  }
+  return fetch;
+}
 
-    read_from_reg(CMD_SRCPDO, SRCPDO_LENGTH);
-    for (int i = 0; i < num_pdo; ++i) {
-      pdo_data[i].byte0 = read_buff[i * 4];
-      pdo_data[i].byte1 = read_buff[i * 4 + 1];
-      pdo_data[i].byte2 = read_buff[i * 4 + 2];
-      pdo_data[i].byte3 = read_buff[i * 4 + 3];
+/*
+ * neg_buff holds CMD_SRCPDO .. CMD_PDONUM. The source starts out on the 5V
+ * PDO, so without a request sent that is the contract.
+ *
+ * @return true if the RDO write was chained
+ */
+bool AP33772::on_pdos() {
+  num_pdo = neg_buff[SRCPDO_LENGTH];
+  if (num_pdo > AP33772_MAX_PDO) num_pdo = AP33772_MAX_PDO;
+  exist_pps = 0;
+  pps_index = 0;
+  index_pdo = 0;
+  for (int i = 0; i < num_pdo; ++i) {
+    pdo_data[i].byte0 = neg_buff[i * 4];
+    pdo_data[i].byte1 = neg_buff[i * 4 + 1];
+    pdo_data[i].byte2 = neg_buff[i * 4 + 2];
+    pdo_data[i].byte3 = neg_buff[i * 4 + 3];
 
-      if ((pdo_data[i].byte3 & 0xF0) == 0xC0) {  // PPS profile found
-        pps_index = i;                           // store index
-        exist_pps = 1;                           // turn on flag
-      }
+    if ((pdo_data[i].byte3 & 0xF0) == 0xC0) {  // PPS profile found
+      pps_index = i;                           // store index
+      exist_pps = 1;                           // turn on flag
     }
   }
+  event_flag.new_neg_success = 0;
+
+  bool chained = send_request();
+  if (!chained) state = AP33772_CONTRACT;
+  emit(AP33772_SOURCE_CAPS);
+  return chained;
+}
+
+/* called from IRQ context or with interrupts disabled */
+void AP33772::start_request() {
+  if (neg_busy || num_pdo == 0) return;
+  neg_busy = true;
+  if (!send_request()) neg_busy = false;
+}
+
+/*
+ * Turns the pending set_voltage() / set_max_current() into an RDO write.
+ * The request is only dropped once the write is queued, a full queue keeps
+ * it for the end of the next chain.
+ *
+ * @return true if the RDO write was queued
+ */
+bool AP33772::send_request() {
+  bool changed = false;
+  if (pending_voltage > 0_mV) {
+    select_voltage(pending_voltage);
+    changed = true;
+  }
+  if (pending_current > 0_mA && select_current(pending_current)) changed = true;
+  if (!changed) {
+    pending_current = 0_mA;  // above what the selected PDO offers
+    return false;
+  }
+
+  neg_buff[0] = CMD_RDO;
+  neg_buff[1] = rdo_data.byte0;
+  neg_buff[2] = rdo_data.byte1;
+  neg_buff[3] = rdo_data.byte2;
+  neg_buff[4] = rdo_data.byte3;
+  neg_step = NEG_RDO;
+  if (!i2c.write_async(&neg_xfer, AP33772_ADDRESS, neg_buff, 5, neg_done, this)) {
+    return false;
+  }
+  pending_voltage = 0_mV;
+  pending_current = 0_mA;
+  state = AP33772_NEGOTIATING;
+  return true;
 }
 
-void AP33772::set_voltage(uint16_t target_voltage) {
+/* the next status read waits for INT, or for poll() */
+void AP33772::finish_neg() {
+  neg_busy = false;
+  start_request();  // made while the chain ran, or retried after a full queue
+  start_status_read();
+  if (!neg_busy && AP33772_INTERRUPT_PIN != PIN_UNUSED)
+    gpio_set_irq_enabled(AP33772_INTERRUPT_PIN, AP33772_INT_LEVEL, true);
+}
+
+void AP33772::emit(AP33772_EVENT_TYPE type) {
+  if (callback == nullptr) return;
+  AP33772_EVENT event;
+  event.type = type;
+  event.state = state;
+  event.status = status.read_status;
+  event.time_us = time_us_32();
+  callback(event, callback_ctx);
+}
+
+/* both go through the negotiation chain, so the PDOs cannot change underneath */
+void AP33772::set_voltage(Millivolts target_voltage) {
+  uint32_t save = save_and_disable_interrupts();
+  pending_voltage = target_voltage;
+  start_request();
+  restore_interrupts(save);
+}
+
+void AP33772::set_max_current(Milliamps target_max_current) {
+  uint32_t save = save_and_disable_interrupts();
+  pending_current = target_max_current;
+  start_request();
+  restore_interrupts(save);
+}
+
+void AP33772::select_voltage(Millivolts target_voltage) {
   /*
   Step 1: Check if PPS can satisfy request
   Step 2: Scan PDOs to see what is the closest voltage to request (rounded down)
   Step 3: Compare found PDOs voltage and PPS max voltage
   */
   uint8_t temp_index = 0;
+  const PDO_DATA &pps = pdo_data[pps_index];
+  Millivolts pps_max = PD_PPS_VOLTAGE::decode(pps.pps.max_voltage);
 
-  if ((exist_pps) && (pdo_data[pps_index].pps.max_voltage * 100 >= target_voltage) &&
-      (pdo_data[pps_index].pps.min_voltage * 100 <= target_voltage)) {
+  if ((exist_pps) && (pps_max >= target_voltage) &&
+      (PD_PPS_VOLTAGE::decode(pps.pps.min_voltage) <= target_voltage)) {
     index_pdo = pps_index;
-    req_pps_volt = target_voltage / 20;  // unit in 20mV/LSB
+    req_pps_volt = PD_PPS_RDO_VOLTAGE::encode(target_voltage);
     rdo_data.pps.obj_pos = pps_index + 1;
-    rdo_data.pps.op_current = pdo_data[pps_index].pps.max_current;
+    rdo_data.pps.op_current = pps.pps.max_current;
     rdo_data.pps.voltage = req_pps_volt;
-    write_rdo();
     return;
   } else {
     // Step 2: Scan PDOs to see what is the closest voltage to request (rounded
     // down)
     for (int i = 0; i < num_pdo - exist_pps; ++i) {
-      if (pdo_data[i].fixed.voltage * 50 <= target_voltage) temp_index = i;
+      if (PD_FIXED_VOLTAGE::decode(pdo_data[i].fixed.voltage) <= target_voltage)
+        temp_index = i;
     }
 
     // Step 3: Compare found PDOs voltage and PPS max voltage
-    if (pdo_data[temp_index].fixed.voltage * 50 >
-        pdo_data[pps_index].pps.max_voltage * 100) {
+    if (PD_FIXED_VOLTAGE::decode(pdo_data[temp_index].fixed.voltage) > pps_max) {
       index_pdo = temp_index;
       rdo_data.fixed.obj_pos = temp_index + 1;
       rdo_data.fixed.max_current = pdo_data[index_pdo].fixed.max_current;
       rdo_data.fixed.op_current = pdo_data[index_pdo].fixed.max_current;
-      write_rdo();
       return;
     } else {  // PPS voltage >=  fixed PDO
       index_pdo = pps_index;
-      req_pps_volt =
-          pdo_data[pps_index].pps.max_voltage * 5;  // Convert units from 100mV -> 20mV
+      req_pps_volt = PD_PPS_RDO_VOLTAGE::encode(pps_max);
       rdo_data.pps.obj_pos = pps_index + 1;
-      rdo_data.pps.op_current = pdo_data[pps_index].pps.max_current;
+      rdo_data.pps.op_current = pps.pps.max_current;
       rdo_data.pps.voltage = req_pps_volt;
-      write_rdo();
       return;
     }
   }
 }
 
-void AP33772::set_max_current(uint16_t target_max_current) {
-  if (index_pdo == pps_index) {
-    if (target_max_current <= pdo_data[pps_index].pps.max_current * 50) {
-      rdo_data.pps.obj_pos = pps_index + 1;
-      rdo_data.pps.op_current = target_max_current / 50;  // 50mA LSB
-      rdo_data.pps.voltage = req_pps_volt;
-      write_rdo();
-    }
+bool AP33772::select_current(Milliamps target_max_current) {
+  if (target_max_current > get_max_current()) return false;
+  if (exist_pps && index_pdo == pps_index) {
+    rdo_data.pps.obj_pos = pps_index + 1;
+    rdo_data.pps.op_current = PD_PPS_CURRENT::encode(target_max_current);
+    rdo_data.pps.voltage = req_pps_volt;
   } else {
-    if (target_max_current <= pdo_data[index_pdo].fixed.max_current * 10) {
-      rdo_data.fixed.obj_pos = index_pdo + 1;
-      rdo_data.fixed.max_current = target_max_current / 10;  // 10mA LSB
-      rdo_data.fixed.op_current = target_max_current / 10;
-      write_rdo();
-    }
+    rdo_data.fixed.obj_pos = index_pdo + 1;
+    rdo_data.fixed.max_current = PD_FIXED_CURRENT::encode(target_max_current);
+    rdo_data.fixed.op_current = PD_FIXED_CURRENT::encode(target_max_current);
   }
+  return true;
+}
+
+Milliamps AP33772::get_max_current() const {
+  if (exist_pps && index_pdo == pps_index) {
+    return PD_PPS_CURRENT::decode(pdo_data[pps_index].pps.max_current);
+  }
+  return PD_FIXED_CURRENT::decode(pdo_data[index_pdo].fixed.max_current);
 }
 
 void AP33772::set_NTC(uint16_t TR25, uint16_t TR50, uint16_t TR75, uint16_t TR100) {
   write_buff[0] = TR25 & 0xFF;
   write_buff[1] = (TR25 >> 8) & 0xFF;
-  write_to_reg(CMD_TR25, 2);
+  write_to_reg(CMD_TR25);
   sleep_ms(5);
 
   write_buff[0] = TR50 & 0xFF;
   write_buff[1] = (TR50 >> 8) & 0xFF;
-  write_to_reg(CMD_TR50, 2);
+  write_to_reg(CMD_TR50);
   sleep_ms(5);
 
   write_buff[0] = TR75 & 0xFF;
   write_buff[1] = (TR75 >> 8) & 0xFF;
-  write_to_reg(CMD_TR75, 2);
+  write_to_reg(CMD_TR75);
   sleep_ms(5);
 
   write_buff[0] = TR100 & 0xFF;
   write_buff[1] = (TR100 >> 8) & 0xFF;
-  write_to_reg(CMD_TR100, 2);
+  write_to_reg(CMD_TR100);
 }
 
-void AP33772::set_derating_temp(uint8_t temp) {
-  write_buff[0] = temp;
-  write_to_reg(CMD_DRTHRESH, 1);
+void AP33772::set_derating_temp(Centidegrees temp) {
+  write_buff[0] = AP33772_TEMP::encode(temp);
+  write_to_reg(CMD_DRTHRESH);
 }
 
+/* the mask is shadowed, so these only touch the bus when a bit changes */
 void AP33772::set_mask(AP33772_MASKS mask) {
-  read_from_reg(CMD_MASK, 1);
-  write_buff[0] = read_buff[0] | mask;
-  sleep_ms(5);
-  write_to_reg(CMD_MASK, 1);
+  regs.update_bits(CMD_MASK, mask, mask);
 }
 
 void AP33772::clear_mask(AP33772_MASKS mask) {
-  read_from_reg(CMD_MASK, 1);
-  write_buff[0] = read_buff[0] & ~mask;
-  sleep_ms(5);
-  write_to_reg(CMD_MASK, 1);
+  regs.update_bits(CMD_MASK, mask, 0);
 }
 
-void AP33772::read_from_reg(AP33772_CMDS cmd, uint8_t num_bytes) {
+void AP33772::read_from_reg(AP33772_CMDS cmd) {
   /* clear the read buffer */
   for (int i = 0; i < READ_BUFF_LENGTH; ++i) {
     read_buff[i] = 0;
   }
-  i2c.read_bytes(AP33772_ADDRESS, cmd, read_buff, num_bytes);
+  regs.read(cmd, read_buff);
+}
+
+void AP33772::write_to_reg(AP33772_CMDS cmd) {
+  regs.write(cmd, write_buff);
+}
+
+/*
+ * A negative delay makes the timer fire at a fixed rate measured from the
+ * start of each callback, so a slow read does not stretch the period.
+ */
+bool AP33772::start_telemetry(uint32_t period_us) {
+  if (tele_running) stop_telemetry();
+  samples.clear();
+  for (uint8_t t = 0; t < AP33772_NUM_TIERS; ++t) {
+    tiers[t].clear();
+    windows[t].inputs = 0;
+  }
+  tele_stats = {};
+  tele_running = add_repeating_timer_us(-(int64_t)period_us, telemetry_tick, this,
+                                        &tele_timer);
+  return tele_running;
+}
+
+void AP33772::stop_telemetry() {
+  if (!tele_running) return;
+  cancel_repeating_timer(&tele_timer);
+  tele_running = false;
+  while (tele_reading) tight_loop_contents();
+}
+
+/*
+ * Alarm IRQ context. A blocking call holds the read in the I2C queue, so a
+ * tick that still finds the last one pending is skipped.
+ */
+bool AP33772::telemetry_tick(repeating_timer_t *timer) {
+  AP33772 *self = static_cast<AP33772 *>(timer->user_data);
+  if (self->tele_reading) {
+    ++self->tele_stats.missed;
+    return true;
+  }
+  self->tele_reading = true;
+  if (!self->i2c.read_async(&self->tele_xfer, AP33772_ADDRESS, &self->tele_reg,
+                            self->tele_burst, AP33772_TELEMETRY_LEN, telemetry_done,
+                            self)) {
+    self->tele_reading = false;
+    ++self->tele_stats.missed;
+  }
+  return true;
+}
+
+/* I2C IRQ context */
+void AP33772::telemetry_done(I2CTransfer *xfer, void *ctx) {
+  AP33772 *self = static_cast<AP33772 *>(ctx);
+  if (xfer->result >= 0)
+    self->record_sample();
+  else
+    ++self->tele_stats.failed;
+  self->tele_reading = false;
+}
+
+/* a sample enters tier 0 as a summary of one */
+void AP33772::record_sample() {
+  AP33772_SAMPLE sample;
+  sample.time_us = time_us_32();  // the read may have waited behind a blocking call
+  memcpy(sample.raw, tele_burst, AP33772_TELEMETRY_LEN);
+  samples.push(sample);
+  ++tele_stats.samples;
+
+  AP33772_SUMMARY in;
+  in.time_us = sample.time_us;
+  in.count = 1;
+  for (uint8_t c = 0; c < AP33772_TELEMETRY_LEN; ++c) {
+    in.lo[c] = in.hi[c] = sample.raw[c];
+    in.mean_q8[c] = sample.raw[c] << 8;
+  }
+  for (uint8_t t = 0; t < AP33772_NUM_TIERS; ++t) {
+    windows[t].fold(in);
+    if (windows[t].inputs < AP33772_DECIMATION) break;
+    in = windows[t].close();
+    tiers[t].push(in);
+  }
+}
+
+void AP33772::Window::fold(const AP33772_SUMMARY &in) {
+  if (inputs == 0) {
+    acc.time_us = in.time_us;
+    acc.count = 0;
+    for (uint8_t c = 0; c < AP33772_TELEMETRY_LEN; ++c) {
+      acc.lo[c] = 0xff;
+      acc.hi[c] = 0;
+      sum[c] = 0;
+    }
+  }
+  for (uint8_t c = 0; c < AP33772_TELEMETRY_LEN; ++c) {
+    if (in.lo[c] < acc.lo[c]) acc.lo[c] = in.lo[c];
+    if (in.hi[c] > acc.hi[c]) acc.hi[c] = in.hi[c];
+    sum[c] += (uint32_t)in.mean_q8[c] * in.count;
+  }
+  acc.count += in.count;
+  ++inputs;
 }
 
-void AP33772::write_to_reg(AP33772_CMDS cmd, uint8_t num_bytes) {
-  i2c.write_bytes(AP33772_ADDRESS, cmd, write_buff, num_bytes);
+AP33772_SUMMARY AP33772::Window::close() {
+  for (uint8_t c = 0; c < AP33772_TELEMETRY_LEN; ++c) acc.mean_q8[c] = sum[c] / acc.count;
+  inputs = 0;
+  return acc;
 }
 
 void AP33772::write_rdo() {
+  state = AP33772_NEGOTIATING;  // before the write, INT may follow at once
   write_buff[0] = rdo_data.byte0;
   write_buff[1] = rdo_data.byte1;
   write_buff[2] = rdo_data.byte2;
   write_buff[3] = rdo_data.byte3;
-  write_to_reg(CMD_RDO, 4);
+  write_to_reg(CMD_RDO);
 }
 
-uint16_t AP33772::read_voltage() {
-  read_from_reg(CMD_VOLTAGE, 1);
-  return read_buff[0] * 80;  // returns 80mV / LSB
+Millivolts AP33772::read_voltage() {
+  read_from_reg(CMD_VOLTAGE);
+  return AP33772_ADC_VOLTAGE::decode(read_buff[0]);
 }
 
-uint16_t AP33772::read_current() {
-  read_from_reg(CMD_CURRENT, 1);
-  return read_buff[0] * 16;  // returns 24mA / LSB
+Milliamps AP33772::read_current() {
+  read_from_reg(CMD_CURRENT);
+  return AP33772_ADC_CURRENT::decode(read_buff[0]);
 }
 
-uint8_t AP33772::read_temp() {
-  read_from_reg(CMD_TEMP, 1);
-  return read_buff[0];
+Centidegrees AP33772::read_temp() {
+  read_from_reg(CMD_TEMP);
+  return AP33772_TEMP::decode(read_buff[0]);
 }
 
 void AP33772::reset() {
@@ -195,22 +486,33 @@ void AP33772::reset() {
   write_buff[1] = 0x00;
   write_buff[2] = 0x00;
   write_buff[3] = 0x00;
-  write_to_reg(CMD_RDO, 4);
+  write_to_reg(CMD_RDO);
+  regs.invalidate();  // the controller is powered from VBUS and resets with it
+
+  uint32_t save = save_and_disable_interrupts();
+  state = AP33772_WAIT_SOURCE;
+  num_pdo = 0;
+  exist_pps = 0;
+  restore_interrupts(save);
 }
 
+/* prints mV and mA as V and A with integer math */
 void AP33772::print_pdo() {
   printf("Source PDO Number: %i\n", num_pdo);
 
   for (int i = 0; i < num_pdo; ++i) {
     if ((pdo_data[i].byte3 & 0xF0) == 0xC0) {  // PPS PDO
-      printf("PDO[%i] - PPS: %4.3fV~", i + 1,
-             (float)pdo_data[i].pps.min_voltage * 100 / 1000);
-      printf("%4.3f @ ", (float)pdo_data[i].pps.max_voltage * 100 / 1000);
-      printf("%f4.3A\n", (float)pdo_data[i].pps.max_current * 50 / 1000);
+      int min_mv = PD_PPS_VOLTAGE::decode(pdo_data[i].pps.min_voltage).value();
+      int max_mv = PD_PPS_VOLTAGE::decode(pdo_data[i].pps.max_voltage).value();
+      int ma = PD_PPS_CURRENT::decode(pdo_data[i].pps.max_current).value();
+      printf("PDO[%i] - PPS: %d.%03dV~", i + 1, min_mv / 1000, min_mv % 1000);
+      printf("%d.%03dV @ ", max_mv / 1000, max_mv % 1000);
+      printf("%d.%03dA\n", ma / 1000, ma % 1000);
     } else if ((pdo_data[i].byte3 & 0xC0) == 0x00) {
-      printf("PDO[%i] - Fixed: %4.3fV ", i + 1,
-             (float)pdo_data[i].fixed.voltage * 50 / 1000);
-      printf("@ %4.3fA\n", (float)pdo_data[i].fixed.max_current * 10 / 1000);
+      int mv = PD_FIXED_VOLTAGE::decode(pdo_data[i].fixed.voltage).value();
+      int ma = PD_FIXED_CURRENT::decode(pdo_data[i].fixed.max_current).value();
+      printf("PDO[%i] - Fixed: %d.%03dV ", i + 1, mv / 1000, mv % 1000);
+      printf("@ %d.%03dA\n", ma / 1000, ma % 1000);
     }
   }
   printf("=========================================================\n");
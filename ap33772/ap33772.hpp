@@ -14,6 +14,9 @@
 #define _AP3372_H
 
 #include "../i2c/i2c.hpp"
+#include "../i2c/reg_cache.hpp"
+#include "../utils/history_ring.hpp"
+#include "../utils/units.hpp"
 
 enum AP33772_CMDS {
   CMD_SRCPDO = 0x00,
@@ -147,11 +150,125 @@ struct RDO_DATA {
   };
 };
 
+static const uint AP33772_INTERRUPT_PIN = PIN_UNUSED;
+/* INT is taken as push-pull, active high; use GPIO_IRQ_LEVEL_LOW if inverted */
+static const uint32_t AP33772_INT_LEVEL = GPIO_IRQ_LEVEL_HIGH;
 static const uint8_t AP33772_ADDRESS = 0x51;
 static const uint8_t READ_BUFF_LENGTH = 30;
 static const uint8_t WRITE_BUFF_LENGTH = 6;
 static const uint8_t SRCPDO_LENGTH = 28;
 
+/* ADC and NTC encodings of the telemetry registers */
+typedef UnitCode<Millivolts, 80> AP33772_ADC_VOLTAGE;
+typedef UnitCode<Milliamps, 24> AP33772_ADC_CURRENT;
+typedef UnitCode<Centidegrees, 100> AP33772_TEMP;  // 1C
+
+/* Telemetry sampler */
+static const uint8_t AP33772_TELEMETRY_LEN = CMD_TEMP - CMD_VOLTAGE + 1;
+static const uint16_t AP33772_SAMPLE_HISTORY = 256;  // power of two, keeps 255
+static const uint16_t AP33772_TIER_HISTORY = 64;     // summaries per tier, power of two
+static const uint8_t AP33772_NUM_TIERS = 2;
+static const uint8_t AP33772_DECIMATION = 16;  // inputs folded into one summary
+
+/* One burst read of CMD_VOLTAGE .. CMD_TEMP */
+struct AP33772_SAMPLE {
+  uint32_t time_us;                    // since boot, when the read started
+  uint8_t raw[AP33772_TELEMETRY_LEN];  // voltage, current, temp codes
+
+  Millivolts voltage() const { return AP33772_ADC_VOLTAGE::decode(raw[0]); }
+  Milliamps current() const { return AP33772_ADC_CURRENT::decode(raw[1]); }
+  Centidegrees temp() const { return AP33772_TEMP::decode(raw[2]); }
+};
+
+template <typename QUANTITY>
+struct AP33772_SPAN {
+  QUANTITY min;
+  QUANTITY max;
+  QUANTITY mean;
+};
+
+/**
+ * @brief Min, max and mean of each channel over AP33772_DECIMATION inputs.
+ * Tier 0 folds samples, tier 1 folds tier 0 summaries.
+ */
+struct AP33772_SUMMARY {
+  uint32_t time_us;  // first sample in the window
+  uint16_t count;    // samples covered
+  uint8_t lo[AP33772_TELEMETRY_LEN];
+  uint8_t hi[AP33772_TELEMETRY_LEN];
+  uint16_t mean_q8[AP33772_TELEMETRY_LEN];  // code * 256
+
+  AP33772_SPAN<Millivolts> voltage() const { return span<AP33772_ADC_VOLTAGE>(0); }
+  AP33772_SPAN<Milliamps> current() const { return span<AP33772_ADC_CURRENT>(1); }
+  AP33772_SPAN<Centidegrees> temp() const { return span<AP33772_TEMP>(2); }
+
+  template <typename CODE>
+  AP33772_SPAN<typename CODE::quantity> span(uint8_t channel) const {
+    return {CODE::decode(lo[channel]), CODE::decode(hi[channel]),
+            CODE::decode_q8(mean_q8[channel])};
+  }
+};
+
+struct AP33772_TELEMETRY_STATS {
+  uint32_t samples;  // reads completed
+  uint32_t missed;   // ticks skipped, the last read was still queued or in flight
+  uint32_t failed;   // reads the device did not answer
+};
+
+/* Negotiation state machine, see begin() */
+static const uint8_t AP33772_EVENT_MASK =
+    EN_READY | EN_SUCCESS | EN_NEWPDO | EN_OVP | EN_OCP | EN_OTP | EN_DR;
+static const uint8_t AP33772_MAX_PDO = SRCPDO_LENGTH / 4;
+
+enum AP33772_STATE {
+  AP33772_WAIT_SOURCE,  // no source capabilities yet
+  AP33772_NEGOTIATING,  // RDO sent, waiting for the source
+  AP33772_CONTRACT,     // the last request, or the default 5V, was accepted
+  AP33772_REJECTED,     // the source rejected the last request
+  AP33772_FAULT         // OVP, OCP or OTP tripped
+};
+
+enum AP33772_EVENT_TYPE {
+  AP33772_SOURCE_CAPS,  // new PDOs loaded, a pending request has been sent
+  AP33772_ACCEPTED,
+  AP33772_FAILED,
+  AP33772_PROTECTION,  // OVP, OCP or OTP, see status
+  AP33772_DERATING     // NTC above the derating threshold
+};
+
+struct AP33772_EVENT {
+  AP33772_EVENT_TYPE type;
+  AP33772_STATE state;  // after the event
+  uint8_t status;       // CMD_STATUS, see AP33772_MASKS
+  uint32_t time_us;     // since boot
+};
+
+/* called from IRQ context, must not call blocking methods of the driver */
+typedef void (*ap33772_callback_t)(const AP33772_EVENT &event, void *ctx);
+
+/* Status, telemetry and the RDO (which starts a negotiation) are volatile */
+struct AP33772_REGS {
+  static constexpr uint8_t ADDRESS = AP33772_ADDRESS;
+  static constexpr bool BYTE_COUNT = false;
+  static constexpr RegDesc REGS[] = {
+      {CMD_SRCPDO, SRCPDO_LENGTH, true},
+      {CMD_PDONUM, 1, true},
+      {CMD_STATUS, 1, true},
+      {CMD_MASK, 1, false},
+      {CMD_VOLTAGE, 1, true},
+      {CMD_CURRENT, 1, true},
+      {CMD_TEMP, 1, true},
+      {CMD_OCPTHRESH, 1, false},
+      {CMD_OTPTHRESH, 1, false},
+      {CMD_DRTHRESH, 1, false},
+      {CMD_TR25, 2, false},
+      {CMD_TR50, 2, false},
+      {CMD_TR75, 2, false},
+      {CMD_TR100, 2, false},
+      {CMD_RDO, 4, true},
+  };
+};
+
 /**
  * @class AP33772
  * @brief Singleton class
@@ -166,26 +283,49 @@ class AP33772 {
     return inst;
   }
 
-  /* TODO: decide if we need the INT pin, look at STUSB4500 for syntax */
+  /**
+   * @brief Routes the INT pin to a level IRQ. Does nothing if
+   * AP33772_INTERRUPT_PIN is PIN_UNUSED.
+   */
   void init_pins(void);
 
   /**
-   * @brief Checks if the power supply is compatible and fetches the PDO
-   * profile.
+   * @brief Enables the AP33772_EVENT_MASK events and starts listening for
+   * them. Returns after wire time, the source capabilities arrive later as
+   * an AP33772_SOURCE_CAPS event. Without an INT pin, call poll().
    */
   void begin(void);
 
   /**
-   * @brief Set VBUS voltage
-   * @param target_voltage desired voltage in mV
+   * @brief Reads the status once in the background, in place of INT.
+   */
+  void poll(void);
+
+  /**
+   * @brief Receives negotiation and protection events, see AP33772_EVENT.
+   */
+  void set_callback(ap33772_callback_t callback, void *ctx) {
+    this->callback = callback;
+    callback_ctx = ctx;
+  }
+
+  AP33772_STATE get_state(void) const { return state; }
+
+  /**
+   * @brief Set VBUS voltage. Returns at once, the RDO is written in the
+   * background and the result arrives as an AP33772_ACCEPTED or
+   * AP33772_FAILED event. Before the source capabilities are in, the request
+   * is kept and sent as soon as they arrive.
+   * @param target_voltage desired voltage
    */
-  void set_voltage(uint16_t target_voltage);
+  void set_voltage(Millivolts target_voltage);
 
   /**
-   * @brief Set maximum current before tripping at the wall plug
-   * @param target_max_current desired current in mA
+   * @brief Set maximum current before tripping at the wall plug. Sent like
+   * set_voltage(), together with it if both are pending.
+   * @param target_max_current desired current
    */
-  void set_max_current(uint16_t target_max_current);
+  void set_max_current(Milliamps target_max_current);
 
   /**
    * @brief Set resistance value of 10K NTC at 25C, 50C, 75C, and 100C.
@@ -201,9 +341,9 @@ class AP33772 {
   /**
    * @brief Set target temperature (C) when output power through USB-C is
    * reduced. Default is 120 C.
-   * @param temp temperature in Celcius
+   * @param temp temperature, rounded down to whole degrees
    */
-  void set_derating_temp(uint8_t temp);
+  void set_derating_temp(Centidegrees temp);
 
   /**
    * @brief set the mask to flag certain events
@@ -218,33 +358,34 @@ class AP33772 {
   void clear_mask(AP33772_MASKS mask);
 
   /**
-   * @brief Write the desired power profile back to the source
+   * @brief Write the desired power profile back to the source. The result
+   * arrives as an AP33772_ACCEPTED or AP33772_FAILED event.
    */
   void write_rdo(void);
 
   /**
    * @brief Read the VBUS voltage
-   * @return voltage in mV
+   * @return voltage, 80mV resolution
    */
-  uint16_t read_voltage(void);
+  Millivolts read_voltage(void);
 
   /**
    * @brief Read VBUS current
-   * @return current in mA
+   * @return current, 24mA resolution
    */
-  uint16_t read_current(void);
+  Milliamps read_current(void);
 
   /**
    * @brief Read NTC temperature
-   * @return temperature in C
+   * @return temperature, 1C resolution
    */
-  uint8_t read_temp(void);
+  Centidegrees read_temp(void);
 
   /**
    * @brief Read maximum VBUS current
-   * @return current in mA
+   * @return maximum current of the selected PDO
    */
-  uint16_t get_max_current(void) const;
+  Milliamps get_max_current(void) const;
 
   /**
    * @brief Hard reset the power supply. Will cause temporary power outage
@@ -256,16 +397,91 @@ class AP33772 {
    */
   void print_pdo(void);
 
+  /**
+   * @brief Samples VBUS voltage, current and the NTC temperature every
+   * period_us from a repeating timer. Each tick starts one 3-byte DMA read,
+   * and the completion IRQ timestamps the sample, stores it and folds it
+   * into the decimation tiers. Ticks that find the last read still queued
+   * behind a blocking call are skipped and counted, the rate stays fixed.
+   *
+   * @return false if no timer slot was free
+   */
+  bool start_telemetry(uint32_t period_us);
+  void stop_telemetry(void);
+
+  /**
+   * @brief Copies up to max of the newest samples into dst, oldest first.
+   * Safe to call while sampling.
+   *
+   * @return number of samples copied
+   */
+  size_t dump_samples(AP33772_SAMPLE *dst, size_t max) const {
+    return samples.copy_latest(dst, max);
+  }
+
+  /**
+   * @brief Same as dump_samples() for a decimation tier. Tier 0 covers
+   * AP33772_DECIMATION samples per summary, each further tier
+   * AP33772_DECIMATION times more.
+   */
+  size_t dump_summaries(uint8_t tier, AP33772_SUMMARY *dst, size_t max) const {
+    if (tier >= AP33772_NUM_TIERS) return 0;
+    return tiers[tier].copy_latest(dst, max);
+  }
+
+  const AP33772_TELEMETRY_STATS &get_telemetry_stats(void) const { return tele_stats; }
+
+  /**
+   * @brief Drops the RAM copy of the configuration registers.
+   */
+  void invalidate_cache(void) { regs.invalidate(); }
+
+  /**
+   * @return bus transactions avoided by the register cache.
+   */
+  uint32_t get_saved_transactions(void) const { return regs.get_saved(); }
+
  private:
   AP33772();
   ~AP33772();
   AP33772(AP33772 const &) = delete;
   AP33772 &operator=(AP33772 const &) = delete;
 
-  void read_from_reg(AP33772_CMDS cmd, uint8_t num_bytes);
-  void write_to_reg(AP33772_CMDS cmd, uint8_t num_bytes);
+  void read_from_reg(AP33772_CMDS cmd);
+  void write_to_reg(AP33772_CMDS cmd);
+
+  /* Folds inputs into the next summary of one tier */
+  struct Window {
+    AP33772_SUMMARY acc;
+    uint32_t sum[AP33772_TELEMETRY_LEN];  // mean_q8 * count
+    uint8_t inputs;
+
+    void fold(const AP33772_SUMMARY &in);
+    AP33772_SUMMARY close();
+  };
+
+  /* negotiation transfers, in the order they chain */
+  enum NEG_STEP : uint8_t { NEG_STATUS, NEG_PDONUM, NEG_SRCPDO, NEG_RDO };
+
+  static void int_isr(void);
+  void start_status_read(void);
+  bool neg_read(NEG_STEP step, AP33772_CMDS cmd, uint8_t *dst, size_t len);
+  static void neg_done(I2CTransfer *xfer, void *ctx);
+  bool on_status(void);
+  bool on_pdos(void);
+  void start_request(void);
+  bool send_request(void);
+  void finish_neg(void);
+  void emit(AP33772_EVENT_TYPE type);
+  void select_voltage(Millivolts target_voltage);
+  bool select_current(Milliamps target_max_current);
+
+  static bool telemetry_tick(repeating_timer_t *timer);
+  static void telemetry_done(I2CTransfer *xfer, void *ctx);
+  void record_sample(void);
 
   I2C i2c;
+  RegCache<AP33772_REGS> regs;
   uint8_t read_buff[READ_BUFF_LENGTH]{0};
   uint8_t write_buff[WRITE_BUFF_LENGTH]{0};
   uint8_t num_pdo;
@@ -277,7 +493,33 @@ class AP33772 {
   AP33772_STATUS status{0};
   AP33772_EVENT_FLAG event_flag{0};
   RDO_DATA rdo_data{0};
-  PDO_DATA pdo_data[7]{0};
+  PDO_DATA pdo_data[AP33772_MAX_PDO]{0};
+
+  /* Negotiation state machine, see begin() */
+  static AP33772 *int_owner;
+  ap33772_callback_t callback = nullptr;
+  void *callback_ctx = nullptr;
+  volatile AP33772_STATE state = AP33772_WAIT_SOURCE;
+  I2CTransfer neg_xfer;
+  NEG_STEP neg_step = NEG_STATUS;
+  uint8_t neg_reg = CMD_STATUS;
+  uint8_t neg_buff[SRCPDO_LENGTH + 1];  // SRCPDO then PDONUM, as the register map
+  volatile bool status_pending = false;
+  volatile bool neg_busy = false;
+  Millivolts pending_voltage;  // 0 if none
+  Milliamps pending_current;   // 0 if none
+
+  /* Telemetry sampler, see start_telemetry() */
+  repeating_timer_t tele_timer;
+  bool tele_running = false;
+  I2CTransfer tele_xfer;
+  uint8_t tele_reg = CMD_VOLTAGE;
+  uint8_t tele_burst[AP33772_TELEMETRY_LEN];
+  volatile bool tele_reading = false;
+  AP33772_TELEMETRY_STATS tele_stats = {};
+  HistoryRing<AP33772_SAMPLE, AP33772_SAMPLE_HISTORY> samples;
+  HistoryRing<AP33772_SUMMARY, AP33772_TIER_HISTORY> tiers[AP33772_NUM_TIERS];
+  Window windows[AP33772_NUM_TIERS] = {};
 };
 
 #endif  // End _AP33772_H
@@ -3,9 +3,18 @@ add_library(${LIB_NAME} INTERFACE)
 
 target_sources(${LIB_NAME} INTERFACE 
     ${CMAKE_CURRENT_LIST_DIR}/${LIB_NAME}.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/${LIB_NAME}_batch.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/pio_${LIB_NAME}.cpp
 )
 
+pico_generate_pio_header(${LIB_NAME} ${CMAKE_CURRENT_LIST_DIR}/pio_${LIB_NAME}.pio)
+
 target_link_libraries(${LIB_NAME} INTERFACE 
 pico_stdlib
 hardware_i2c
+hardware_dma
+hardware_irq
+hardware_sync
+hardware_pio
+hardware_clocks
 )
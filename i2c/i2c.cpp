@@ -1,5 +1,170 @@
 #include "i2c.hpp"
 
+#include "hardware/sync.h"
+#include "pio_i2c.hpp"
+
+/* DMA engine state, one per hardware block so every I2C object sharing a
+ * block also shares its queue. */
+struct I2CAsyncEngine {
+  bool ready;
+  int tx_chan;
+  int rx_chan;
+  I2CTransfer *queue[I2C_ASYNC_QUEUE_LEN];
+  volatile uint8_t head;
+  volatile uint8_t count;
+  volatile uint8_t blocking;  // blocking calls holding the bus, see I2C::lock()
+  I2CTransfer *volatile active;
+  bool failed;
+  size_t cmd_pos;
+  size_t cmd_total;
+  uint16_t cmd_buf[I2C_DMA_CHUNK_LEN];
+};
+
+static I2CAsyncEngine engines[NUM_I2CS];
+
+static void async_start(uint index);
+
+/* Copies the next run of command words into cmd_buf and lets DMA push them
+ * into the TX FIFO. STOP/RESTART/CMD bits are encoded per word. */
+static void async_stage(uint index) {
+  I2CAsyncEngine *e = &engines[index];
+  I2CTransfer *xfer = e->active;
+  i2c_inst_t *i2c = i2c_get_instance(index);
+
+  size_t n = e->cmd_total - e->cmd_pos;
+  if (n > I2C_DMA_CHUNK_LEN) n = I2C_DMA_CHUNK_LEN;
+
+  for (size_t i = 0; i < n; ++i, ++e->cmd_pos) {
+    uint16_t word;
+    if (e->cmd_pos < xfer->src_len) {
+      word = xfer->src[e->cmd_pos];
+    } else {
+      word = I2C_IC_DATA_CMD_CMD_BITS;
+      if (e->cmd_pos == xfer->src_len && xfer->src_len > 0)
+        word |= I2C_IC_DATA_CMD_RESTART_BITS;
+    }
+    if (e->cmd_pos == e->cmd_total - 1) word |= I2C_IC_DATA_CMD_STOP_BITS;
+    e->cmd_buf[i] = word;
+  }
+
+  dma_channel_config c = dma_channel_get_default_config(e->tx_chan);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, i2c_get_dreq(i2c, true));
+  dma_channel_configure(e->tx_chan, &c, &i2c_get_hw(i2c)->data_cmd, e->cmd_buf, n, true);
+}
+
+static void async_finish(uint index) {
+  I2CAsyncEngine *e = &engines[index];
+  I2CTransfer *xfer = e->active;
+
+  /* the last byte may still be on its way out of the RX FIFO */
+  if (xfer->dst_len > 0 && !e->failed) {
+    while (dma_channel_is_busy(e->rx_chan)) tight_loop_contents();
+  }
+
+  xfer->result = e->failed ? PICO_ERROR_GENERIC : (int)(xfer->src_len + xfer->dst_len);
+  xfer->done = true;
+  e->active = nullptr;
+  if (xfer->callback) xfer->callback(xfer, xfer->ctx);
+
+  /* a transfer submitted by the callback is already running */
+  if (e->active != nullptr) return;
+  if (e->count > 0 && !e->blocking) {
+    async_start(index);
+  } else {
+    /* hand the block back to the blocking SDK calls */
+    i2c_get_hw(i2c_get_instance(index))->intr_mask = 0;
+  }
+}
+
+static void async_start(uint index) {
+  I2CAsyncEngine *e = &engines[index];
+  i2c_inst_t *i2c = i2c_get_instance(index);
+  i2c_hw_t *hw = i2c_get_hw(i2c);
+
+  e->active = e->queue[e->head];
+  e->head = (e->head + 1) % I2C_ASYNC_QUEUE_LEN;
+  --e->count;
+  e->failed = false;
+  e->cmd_pos = 0;
+  e->cmd_total = e->active->src_len + e->active->dst_len;
+
+  hw->enable = 0;
+  hw->tar = e->active->addr;
+  hw->enable = 1;
+  (void)hw->clr_intr;
+  hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+
+  if (e->active->dst_len > 0) {
+    dma_channel_config c = dma_channel_get_default_config(e->rx_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, i2c_get_dreq(i2c, false));
+    dma_channel_configure(e->rx_chan, &c, e->active->dst, &hw->data_cmd,
+                          e->active->dst_len, true);
+  }
+  async_stage(index);
+}
+
+static void i2c_async_irq(uint index) {
+  I2CAsyncEngine *e = &engines[index];
+  i2c_hw_t *hw = i2c_get_hw(i2c_get_instance(index));
+  uint32_t status = hw->intr_stat;
+
+  if (status & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+    /* NACK or arbitration loss, the controller issues a STOP on its own */
+    e->failed = true;
+    e->cmd_pos = e->cmd_total;
+    /* the abort must not look like a completion, or dma_async_irq() restages
+     * the next transfer over its first run once STOP_DET has started it */
+    dma_channel_set_irq0_enabled(e->tx_chan, false);
+    dma_channel_abort(e->tx_chan);
+    dma_channel_acknowledge_irq0(e->tx_chan);
+    dma_channel_set_irq0_enabled(e->tx_chan, true);
+    dma_channel_abort(e->rx_chan);
+    (void)hw->clr_tx_abrt;
+  }
+  if (status & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+    (void)hw->clr_stop_det;
+    if (e->active) async_finish(index);
+  }
+}
+
+static void i2c0_async_irq() { i2c_async_irq(0); }
+static void i2c1_async_irq() { i2c_async_irq(1); }
+
+static void dma_async_irq() {
+  for (uint i = 0; i < NUM_I2CS; ++i) {
+    I2CAsyncEngine *e = &engines[i];
+    if (!e->ready || !dma_channel_get_irq0_status(e->tx_chan)) continue;
+    dma_channel_acknowledge_irq0(e->tx_chan);
+    if (e->active && e->cmd_pos < e->cmd_total) async_stage(i);
+  }
+}
+
+static void async_init(uint index) {
+  static bool dma_irq_installed = false;
+  I2CAsyncEngine *e = &engines[index];
+
+  e->tx_chan = dma_claim_unused_channel(true);
+  e->rx_chan = dma_claim_unused_channel(true);
+  dma_channel_set_irq0_enabled(e->tx_chan, true);
+  if (!dma_irq_installed) {
+    irq_add_shared_handler(DMA_IRQ_0, dma_async_irq,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+    dma_irq_installed = true;
+  }
+
+  uint irq = index ? I2C1_IRQ : I2C0_IRQ;
+  irq_set_exclusive_handler(irq, index ? i2c1_async_irq : i2c0_async_irq);
+  irq_set_enabled(irq, true);
+  e->ready = true;
+}
+
 void I2C::init() {
   i2c = pin_to_inst(sda);
   i2c_init(i2c, baudrate);
@@ -9,47 +174,60 @@ void I2C::init() {
   gpio_pull_up(scl);
 }
 
+I2C::I2C(PIOI2C *bus)
+    : sda(bus->get_sda()), scl(bus->get_scl()), pio(bus) {}
+
+uint I2C::get_index() { return pio ? pio->get_id() : i2c_get_index(i2c); }
+
 i2c_inst_t *I2C::pin_to_inst(uint pin) { return ((pin >> 1) & 0b1) ? i2c1 : i2c0; }
 
 /* wrappers for devices using i2c functions directly */
 int I2C::write_blocking(uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+  BusLock lock(this);
+  if (pio) return pio->write_blocking(addr, src, len, nostop);
   return i2c_write_blocking(i2c, addr, src, len, nostop);
 }
 
 int I2C::read_blocking(uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+  BusLock lock(this);
+  if (pio) return pio->read_blocking(addr, dst, len, nostop);
   return i2c_read_blocking(i2c, addr, dst, len, nostop);
 }
 
 void I2C::reg_write_uint8(uint8_t address, uint8_t reg, uint8_t value) {
   uint8_t buff[2] = {reg, value};
-  i2c_write_blocking(i2c, address, buff, 2, false);
+  write_blocking(address, buff, 2, false);
 }
 
 uint8_t I2C::reg_read_uint8(uint8_t address, uint8_t reg) {
+  BusLock lock(this);
   uint8_t value;
-  i2c_write_blocking(i2c, address, &reg, 1, false);
-  i2c_read_blocking(i2c, address, (uint8_t *)&value, sizeof(uint8_t), false);
+  write_blocking(address, &reg, 1, false);
+  read_blocking(address, (uint8_t *)&value, sizeof(uint8_t), false);
   return value;
 }
 
 uint16_t I2C::reg_read_uint16(uint8_t address, uint8_t reg) {
+  BusLock lock(this);
   uint16_t value;
-  i2c_write_blocking(i2c, address, &reg, 1, true);
-  i2c_read_blocking(i2c, address, (uint8_t *)&value, sizeof(uint16_t), false);
+  write_blocking(address, &reg, 1, true);
+  read_blocking(address, (uint8_t *)&value, sizeof(uint16_t), false);
   return value;
 }
 
 uint32_t I2C::reg_read_uint32(uint8_t address, uint8_t reg) {
+  BusLock lock(this);
   uint32_t value;
-  i2c_write_blocking(i2c, address, &reg, 1, true);
-  i2c_read_blocking(i2c, address, (uint8_t *)&value, sizeof(uint32_t), false);
+  write_blocking(address, &reg, 1, true);
+  read_blocking(address, (uint8_t *)&value, sizeof(uint32_t), false);
   return value;
 }
 
 int16_t I2C::reg_read_int16(uint8_t address, uint8_t reg) {
+  BusLock lock(this);
   int16_t value;
-  i2c_write_blocking(i2c, address, &reg, 1, true);
-  i2c_read_blocking(i2c, address, (uint8_t *)&value, sizeof(int16_t), false);
+  write_blocking(address, &reg, 1, true);
+  read_blocking(address, (uint8_t *)&value, sizeof(int16_t), false);
   return value;
 }
 
@@ -59,12 +237,13 @@ int I2C::write_bytes(uint8_t address, uint8_t reg, const uint8_t *buf, int len)
   for (int x = 0; x < len; x++) {
     buffer[x + 1] = buf[x];
   }
-  return i2c_write_blocking(i2c, address, buffer, len + 1, false);
+  return write_blocking(address, buffer, len + 1, false);
 };
 
 int I2C::read_bytes(uint8_t address, uint8_t reg, uint8_t *buf, int len) {
-  i2c_write_blocking(i2c, address, &reg, 1, true);
-  i2c_read_blocking(i2c, address, buf, len, false);
+  BusLock lock(this);
+  write_blocking(address, &reg, 1, true);
+  read_blocking(address, buf, len, false);
   return len;
 };
 
@@ -75,6 +254,7 @@ uint8_t I2C::get_bits(uint8_t address, uint8_t reg, uint8_t shift, uint8_t mask)
 }
 
 void I2C::set_bits(uint8_t address, uint8_t reg, uint8_t shift, uint8_t mask) {
+  BusLock lock(this);
   uint8_t value;
   read_bytes(address, reg, &value, 1);
   value |= mask << shift;
@@ -82,9 +262,90 @@ void I2C::set_bits(uint8_t address, uint8_t reg, uint8_t shift, uint8_t mask) {
 }
 
 void I2C::clear_bits(uint8_t address, uint8_t reg, uint8_t shift, uint8_t mask) {
+  BusLock lock(this);
   uint8_t value;
   read_bytes(address, reg, &value, 1);
   value &= ~(mask << shift);
   write_bytes(address, reg, &value, 1);
 }
+
+bool I2C::submit(I2CTransfer *xfer) {
+  if (pio) return pio->submit(xfer);
+  uint index = i2c_get_index(i2c);
+  I2CAsyncEngine *e = &engines[index];
+  if (!e->ready) async_init(index);
+
+  xfer->done = false;
+  xfer->result = 0;
+  if (xfer->src_len + xfer->dst_len == 0) {
+    xfer->done = true;
+    if (xfer->callback) xfer->callback(xfer, xfer->ctx);
+    return true;
+  }
+
+  uint32_t save = save_and_disable_interrupts();
+  if (e->count == I2C_ASYNC_QUEUE_LEN) {
+    restore_interrupts(save);
+    return false;
+  }
+  e->queue[(e->head + e->count) % I2C_ASYNC_QUEUE_LEN] = xfer;
+  ++e->count;
+  if (e->active == nullptr && !e->blocking) async_start(index);
+  restore_interrupts(save);
+  return true;
+}
+
+bool I2C::write_async(I2CTransfer *xfer, uint8_t addr, const uint8_t *src, size_t len,
+                      i2c_callback_t callback, void *ctx) {
+  xfer->addr = addr;
+  xfer->src = src;
+  xfer->src_len = len;
+  xfer->dst = nullptr;
+  xfer->dst_len = 0;
+  xfer->callback = callback;
+  xfer->ctx = ctx;
+  return submit(xfer);
+}
+
+bool I2C::read_async(I2CTransfer *xfer, uint8_t addr, const uint8_t *reg, uint8_t *dst,
+                     size_t len, i2c_callback_t callback, void *ctx) {
+  xfer->addr = addr;
+  xfer->src = reg;
+  xfer->src_len = 1;
+  xfer->dst = dst;
+  xfer->dst_len = len;
+  xfer->callback = callback;
+  xfer->ctx = ctx;
+  return submit(xfer);
+}
+
+int I2C::wait(I2CTransfer *xfer) {
+  while (!xfer->done) tight_loop_contents();
+  return xfer->result;
+}
+
+bool I2C::is_busy() {
+  if (pio) return pio->is_busy();
+  I2CAsyncEngine *e = &engines[i2c_get_index(i2c)];
+  return e->active != nullptr || e->count > 0;
+}
+
+void I2C::lock() {
+  if (pio) return pio->lock();
+  I2CAsyncEngine *e = &engines[i2c_get_index(i2c)];
+  uint32_t save = save_and_disable_interrupts();
+  ++e->blocking;
+  restore_interrupts(save);
+  while (e->active != nullptr) tight_loop_contents();
+}
+
+/* the last holder starts whatever queued up meanwhile */
+void I2C::unlock() {
+  if (pio) return pio->unlock();
+  uint index = i2c_get_index(i2c);
+  I2CAsyncEngine *e = &engines[index];
+  uint32_t save = save_and_disable_interrupts();
+  if (--e->blocking == 0 && e->active == nullptr && e->count > 0) async_start(index);
+  restore_interrupts(save);
+}
 /* END OF FILE */
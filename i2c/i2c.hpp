@@ -17,10 +17,37 @@
 #include <climits>
 
 #include "../utils/common.hpp"
+#include "hardware/dma.h"
 #include "hardware/gpio.h"
 #include "hardware/i2c.h"
+#include "hardware/irq.h"
 #include "pico/stdlib.h"
 
+/* Async transfer params */
+static constexpr uint8_t I2C_ASYNC_QUEUE_LEN = 8;  // pending transfers per block
+static constexpr uint8_t I2C_DMA_CHUNK_LEN = 32;   // command words staged per DMA run
+
+struct I2CTransfer;
+class PIOI2C;
+typedef void (*i2c_callback_t)(I2CTransfer *xfer, void *ctx);
+
+/**
+ * @brief A single asynchronous transaction. The write phase (src) is sent
+ * first, then the read phase (dst) follows after a repeated start. Either
+ * phase may be empty. The struct must stay alive until done is set.
+ */
+struct I2CTransfer {
+  uint8_t addr;
+  const uint8_t *src;
+  size_t src_len;
+  uint8_t *dst;
+  size_t dst_len;
+  i2c_callback_t callback;  // optional, called from IRQ context
+  void *ctx;
+  volatile bool done;
+  volatile int result;  // bytes transferred or PICO_ERROR_GENERIC
+};
+
 class I2C {
  private:
   i2c_inst_t *i2c = PICO_DEFAULT_I2C;
@@ -28,6 +55,7 @@ class I2C {
   uint scl = I2C_DEFAULT_SCL;
   uint interrupt = PIN_UNUSED;
   uint32_t baudrate = I2C_DEFAULT_BAUDRATE;
+  PIOI2C *pio = nullptr;  // set when the bus is a PIO state machine
 
  public:
   I2C(uint sda, uint scl, uint32_t baudrate = I2C_DEFAULT_BAUDRATE)
@@ -37,7 +65,19 @@ class I2C {
 
   I2C() : I2C(I2C_DEFAULT_SDA, I2C_DEFAULT_SCL) {}
 
+  /**
+   * @brief Runs on a PIO I2C master instead of a hardware block. The bus
+   * must outlive every I2C using it.
+   */
+  I2C(PIOI2C *bus);
+
+  /* Destroying an I2C releases the block and its pins, so an I2C cannot be
+   * copied. Drivers that share a bus take an I2C * instead. */
+  I2C(I2C const &) = delete;
+  I2C &operator=(I2C const &) = delete;
+
   ~I2C() {
+    if (pio != nullptr) return;
     i2c_deinit(i2c);
     gpio_disable_pulls(sda);
     gpio_set_function(sda, GPIO_FUNC_NULL);
@@ -46,6 +86,11 @@ class I2C {
   }
 
   i2c_inst_t *pin_to_inst(uint pin);
+  /**
+   * @return hardware block index, or the PIO bus id if is_pio()
+   */
+  uint get_index();
+  bool is_pio() const { return pio != nullptr; }
   int write_blocking(uint8_t addr, const uint8_t *src, size_t len, bool nostop);
   int read_blocking(uint8_t addr, uint8_t *dst, size_t len, bool nostop);
 
@@ -62,6 +107,67 @@ class I2C {
   void set_bits(uint8_t address, uint8_t reg, uint8_t shift, uint8_t mask = 0b1);
   void clear_bits(uint8_t address, uint8_t reg, uint8_t shift, uint8_t mask = 0b1);
 
+  /* Async (DMA) transfers */
+
+  /**
+   * @brief Queues a transfer on this block's DMA engine and returns
+   * immediately. Transfers on the same block complete in submission order.
+   * While a blocking call holds the bus, new transfers wait in the queue.
+   *
+   * @param xfer transfer descriptor, owned by the caller
+   * @return false if the queue is full
+   */
+  bool submit(I2CTransfer *xfer);
+
+  /**
+   * @brief Fills out xfer as a plain write and submits it.
+   */
+  bool write_async(I2CTransfer *xfer, uint8_t addr, const uint8_t *src, size_t len,
+                   i2c_callback_t callback = nullptr, void *ctx = nullptr);
+
+  /**
+   * @brief Fills out xfer as a register read (write reg, repeated start,
+   * read len bytes) and submits it. reg must outlive the transfer.
+   */
+  bool read_async(I2CTransfer *xfer, uint8_t addr, const uint8_t *reg, uint8_t *dst,
+                  size_t len, i2c_callback_t callback = nullptr, void *ctx = nullptr);
+
+  /**
+   * @brief Blocks until xfer completes.
+   * @return bytes transferred or PICO_ERROR_GENERIC
+   */
+  int wait(I2CTransfer *xfer);
+
+  /**
+   * @return true while any transfer is queued or in flight on this block.
+   */
+  bool is_busy();
+
+  /* Bus ownership */
+
+  /**
+   * @brief Keeps async transfers off the bus. The call waits for the
+   * transfer in flight, and queued ones start when the last holder unlocks.
+   * Every blocking call takes the lock itself. Hold it across sequences that
+   * must not be split, e.g. a nostop write followed by a read. The lock
+   * nests. Do not take it from IRQ context, because the transfer it waits
+   * for completes in an IRQ.
+   */
+  void lock();
+  void unlock();
+
+  /**
+   * @brief Holds lock() for a scope.
+   */
+  class BusLock {
+   public:
+    explicit BusLock(I2C *bus) : bus(bus) { bus->lock(); }
+    ~BusLock() { bus->unlock(); }
+
+   private:
+    I2C *bus;
+  };
+
  private:
   void init();
 };
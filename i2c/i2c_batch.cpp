@@ -0,0 +1,77 @@
+#include "i2c_batch.hpp"
+
+I2CBatch::I2CBatch(I2C *i2c, uint8_t address, bool repeated_start, bool auto_increment)
+    : i2c(i2c),
+      address(address),
+      repeated_start(repeated_start),
+      auto_increment(auto_increment) {}
+
+bool I2CBatch::write(uint8_t reg, uint8_t value) { return write(reg, &value, 1); }
+
+bool I2CBatch::write(uint8_t reg, const uint8_t *buf, uint8_t len) {
+  if (data_len + len > I2C_BATCH_MAX_DATA) return false;
+
+  Op *last = num_ops ? &ops[num_ops - 1] : nullptr;
+  bool merge = auto_increment && last && last->dst == nullptr &&
+               (uint8_t)(last->reg + last->len) == reg;
+  if (!merge) {
+    if (num_ops == I2C_BATCH_MAX_OPS) return false;
+    last = &ops[num_ops++];
+    last->reg = reg;
+    last->len = 0;
+    last->offset = data_len;
+    last->dst = nullptr;
+  }
+
+  for (uint8_t i = 0; i < len; ++i) {
+    data[data_len++] = buf[i];
+  }
+  last->len += len;
+  return true;
+}
+
+bool I2CBatch::read(uint8_t reg, uint8_t *dst, uint8_t len) {
+  if (num_ops == I2C_BATCH_MAX_OPS) return false;
+  ops[num_ops++] = {reg, len, 0, dst};
+  return true;
+}
+
+int I2CBatch::run() {
+  uint8_t buffer[I2C_BATCH_MAX_DATA + 1];
+  uint64_t start = time_us_64();
+  int result = num_ops;
+  I2C::BusLock lock(i2c);  // repeated starts chain the ops into one transaction
+
+  for (uint8_t i = 0; i < num_ops; ++i) {
+    Op *op = &ops[i];
+    bool nostop = repeated_start && (i < num_ops - 1);
+    int ret;
+
+    if (op->dst == nullptr) {
+      buffer[0] = op->reg;
+      for (uint8_t j = 0; j < op->len; ++j) {
+        buffer[j + 1] = data[op->offset + j];
+      }
+      ret = i2c->write_blocking(address, buffer, op->len + 1, nostop);
+    } else {
+      ret = i2c->write_blocking(address, &op->reg, 1, true);
+      if (ret >= 0) ret = i2c->read_blocking(address, op->dst, op->len, nostop);
+    }
+
+    if (ret < 0) {
+      result = PICO_ERROR_GENERIC;
+      break;
+    }
+  }
+
+  run_us = time_us_64() - start;
+  clear();
+  return result;
+}
+
+void I2CBatch::clear() {
+  num_ops = 0;
+  data_len = 0;
+}
+
+/* END OF FILE */
@@ -0,0 +1,86 @@
+/** @file i2c_batch.hpp
+ *
+ * @brief A queue of register reads/writes for a single device that runs as
+ * one pipelined burst on the bus.
+ *
+ * @par
+ * Writes to adjacent registers are merged into one multi-byte write, and
+ * when the device allows it every operation after the first is joined with a
+ * repeated start so the whole batch costs one START ... STOP.
+ */
+
+#ifndef _I2C_BATCH_H
+#define _I2C_BATCH_H
+
+#include "i2c.hpp"
+
+static constexpr uint8_t I2C_BATCH_MAX_OPS = 16;
+static constexpr uint8_t I2C_BATCH_MAX_DATA = 64;
+
+class I2CBatch {
+ public:
+  /**
+   * @param i2c bus the device lives on
+   * @param address 7-bit device address
+   * @param repeated_start join operations with repeated starts instead of
+   * STOP/START pairs
+   * @param auto_increment device advances its register pointer on multi-byte
+   * accesses, required for write coalescing
+   */
+  I2CBatch(I2C *i2c, uint8_t address, bool repeated_start = true,
+           bool auto_increment = true);
+
+  /**
+   * @brief Queues a register write. Merged into the previous write when reg
+   * directly follows it.
+   *
+   * @return false if the batch is full
+   */
+  bool write(uint8_t reg, uint8_t value);
+  bool write(uint8_t reg, const uint8_t *buf, uint8_t len);
+
+  /**
+   * @brief Queues a register read, dst is filled in when run() returns.
+   *
+   * @return false if the batch is full
+   */
+  bool read(uint8_t reg, uint8_t *dst, uint8_t len);
+
+  /**
+   * @brief Sends every queued operation then clears the batch.
+   *
+   * @return number of operations put on the bus, or PICO_ERROR_GENERIC if the
+   * device did not acknowledge
+   */
+  int run();
+
+  void clear();
+
+  /* number of operations after coalescing */
+  uint8_t size() const { return num_ops; }
+
+  /* bus time of the last run() in microseconds */
+  uint32_t last_run_us() const { return run_us; }
+
+ private:
+  struct Op {
+    uint8_t reg;
+    uint8_t len;
+    uint8_t offset;  // into data[] for writes
+    uint8_t *dst;    // nullptr for writes
+  };
+
+  I2C *i2c;
+  uint8_t address;
+  bool repeated_start;
+  bool auto_increment;
+  Op ops[I2C_BATCH_MAX_OPS];
+  uint8_t num_ops = 0;
+  uint8_t data[I2C_BATCH_MAX_DATA];
+  uint8_t data_len = 0;
+  uint32_t run_us = 0;
+};
+
+#endif  // END _I2C_BATCH_H
+
+/* END OF FILE */
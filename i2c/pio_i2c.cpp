@@ -0,0 +1,442 @@
+/** @file pio_i2c.cpp
+ *
+ * @brief this module implements the PIO I2C master.
+ *
+ * @author Nathan Winslow
+ */
+
+#include "pio_i2c.hpp"
+
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+#include "pio_i2c.pio.h"
+
+/* TX record fields, see pio_i2c.pio */
+static constexpr uint PIO_I2C_ICOUNT_LSB = 10;
+static constexpr uint PIO_I2C_FINAL_LSB = 9;
+static constexpr uint PIO_I2C_DATA_LSB = 1;
+static constexpr uint PIO_I2C_NAK_LSB = 0;
+
+static constexpr uint8_t PIO_I2C_START_LEN = 3;     // header + 2 instructions
+static constexpr uint8_t PIO_I2C_REPSTART_LEN = 5;  // header + 4 instructions
+static constexpr uint8_t PIO_I2C_STOP_LEN = 4;      // header + 3 instructions
+
+PIOI2C *PIOI2C::buses[PIO_I2C_MAX_BUSES] = {nullptr};
+static_assert(PIO_I2C_MAX_BUSES == NUM_PIOS * NUM_PIO_STATE_MACHINES,
+              "every state machine of every PIO needs a bus id");
+
+/* zero initialised for any NUM_PIOS, so no PIO starts out as loaded */
+static bool program_loaded[NUM_PIOS];
+static uint program_offset[NUM_PIOS];
+
+/* Line states are set with pindirs: 1 releases the line, 0 pulls it low */
+static inline uint16_t scl_sda(bool scl, bool sda) {
+  return pio_encode_set(pio_pindirs, sda) | pio_encode_sideset_opt(1, scl) |
+         pio_encode_delay(7);
+}
+
+static const uint16_t start_records[PIO_I2C_START_LEN] = {
+    1u << PIO_I2C_ICOUNT_LSB, scl_sda(1, 0), scl_sda(0, 0)};
+
+static const uint16_t repstart_records[PIO_I2C_REPSTART_LEN] = {
+    3u << PIO_I2C_ICOUNT_LSB, scl_sda(0, 1), scl_sda(1, 1), scl_sda(1, 0), scl_sda(0, 0)};
+
+static const uint16_t stop_records[PIO_I2C_STOP_LEN] = {
+    2u << PIO_I2C_ICOUNT_LSB, scl_sda(0, 0), scl_sda(1, 0), scl_sda(1, 1)};
+
+PIOI2C::PIOI2C(PIO pio, uint sda, uint32_t baudrate)
+    : pio(pio),
+      sda(sda),
+      held(false),
+      tx_chan(-1),
+      sink_chan(-1),
+      rx_chan(-1),
+      head(0),
+      count(0),
+      active(nullptr),
+      pos(0),
+      total(0) {
+  uint index = pio_get_index(pio);
+  if (!program_loaded[index]) {
+    program_offset[index] = pio_add_program(pio, &pio_i2c_program);
+    program_loaded[index] = true;
+  }
+  offset = program_offset[index];
+  sm = pio_claim_unused_sm(pio, true);
+  id = index * NUM_PIO_STATE_MACHINES + sm;
+  buses[id] = this;
+
+  pio_sm_config c = pio_i2c_program_get_default_config(offset);
+  sm_config_set_out_pins(&c, sda, 1);
+  sm_config_set_set_pins(&c, sda, 1);
+  sm_config_set_in_pins(&c, sda);
+  sm_config_set_sideset_pins(&c, get_scl());
+  sm_config_set_jmp_pin(&c, sda);
+  sm_config_set_out_shift(&c, false, true, 16);
+  sm_config_set_in_shift(&c, false, true, 8);
+
+  /* Both lines start released. OE is inverted, so the pin value stays 0
+   * and pindirs picks between pulling low and letting the pull-up win. */
+  uint scl = get_scl();
+  uint32_t both = (1u << sda) | (1u << scl);
+  gpio_pull_up(sda);
+  gpio_pull_up(scl);
+  pio_sm_set_pins_with_mask(pio, sm, both, both);
+  pio_sm_set_pindirs_with_mask(pio, sm, both, both);
+  pio_gpio_init(pio, sda);
+  gpio_set_oeover(sda, GPIO_OVERRIDE_INVERT);
+  pio_gpio_init(pio, scl);
+  gpio_set_oeover(scl, GPIO_OVERRIDE_INVERT);
+  pio_sm_set_pins_with_mask(pio, sm, 0, both);
+
+  pio_sm_init(pio, sm, offset + pio_i2c_offset_entry_point, &c);
+  set_baudrate(baudrate);
+  pio_sm_set_enabled(pio, sm, true);
+}
+
+PIOI2C::~PIOI2C() {
+  while (is_busy()) tight_loop_contents();
+  pio_sm_set_enabled(pio, sm, false);
+  pio_sm_unclaim(pio, sm);
+  if (tx_chan >= 0) {
+    dma_channel_set_irq0_enabled(tx_chan, false);
+    dma_channel_set_irq0_enabled(sink_chan, false);
+    dma_channel_set_irq0_enabled(rx_chan, false);
+    dma_channel_unclaim(tx_chan);
+    dma_channel_unclaim(sink_chan);
+    dma_channel_unclaim(rx_chan);
+  }
+  buses[id] = nullptr;
+}
+
+void PIOI2C::set_baudrate(uint32_t baudrate) {
+  /* 32 PIO clocks per SCL period */
+  pio_sm_set_clkdiv(pio, sm, (float)clock_get_hz(clk_sys) / (32.0f * baudrate));
+}
+
+/* Low level helpers */
+bool PIOI2C::error() const { return pio_interrupt_get(pio, sm); }
+
+void PIOI2C::put(uint16_t record) {
+  while (pio_sm_is_tx_fifo_full(pio, sm)) {
+    if (error()) return;
+  }
+  /* halfword write so autopull sees the record straight away */
+  *(io_rw_16 *)&pio->txf[sm] = record;
+}
+
+void PIOI2C::start() {
+  for (uint8_t i = 0; i < PIO_I2C_START_LEN; ++i) put(start_records[i]);
+}
+
+void PIOI2C::repstart() {
+  for (uint8_t i = 0; i < PIO_I2C_REPSTART_LEN; ++i) put(repstart_records[i]);
+}
+
+void PIOI2C::stop() {
+  for (uint8_t i = 0; i < PIO_I2C_STOP_LEN; ++i) put(stop_records[i]);
+}
+
+void PIOI2C::rx_enable(bool enabled) {
+  if (enabled) {
+    hw_set_bits(&pio->sm[sm].shiftctrl, PIO_SM0_SHIFTCTRL_AUTOPUSH_BITS);
+    /* IN keeps counting while autopush is off, so the first IN after a write
+     * would push the stale ISR and shift every byte by one bit. Push it now,
+     * the caller drains the RX FIFO next. */
+    pio_sm_exec(pio, sm, pio_encode_push(false, false));
+  } else {
+    hw_clear_bits(&pio->sm[sm].shiftctrl, PIO_SM0_SHIFTCTRL_AUTOPUSH_BITS);
+  }
+}
+
+void PIOI2C::recover() {
+  pio_sm_drain_tx_fifo(pio, sm);
+  pio_sm_exec(pio, sm, pio_encode_jmp(offset + pio_i2c_offset_entry_point));
+  pio_interrupt_clear(pio, sm);
+}
+
+int PIOI2C::wait_idle() {
+  uint32_t stalled = 1u << (PIO_FDEBUG_TXSTALL_LSB + sm);
+  uint32_t start_us = time_us_32();
+
+  pio->fdebug = stalled;
+  while (!(pio->fdebug & stalled)) {
+    if (error()) return PICO_ERROR_GENERIC;
+    if (time_us_32() - start_us > PIO_I2C_TIMEOUT_US) return PICO_ERROR_TIMEOUT;
+  }
+  return error() ? PICO_ERROR_GENERIC : PICO_OK;
+}
+
+/* Blocking transfers */
+int PIOI2C::write_blocking(uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+  rx_enable(false);
+  held ? repstart() : start();
+  put((addr << 2) | 1u);
+  for (size_t i = 0; i < len && !error(); ++i) {
+    put((src[i] << PIO_I2C_DATA_LSB) | (1u << PIO_I2C_NAK_LSB));
+  }
+  if (!nostop) stop();
+
+  if (wait_idle() != PICO_OK) {
+    recover();
+    stop();
+    wait_idle();
+    held = false;
+    return PICO_ERROR_GENERIC;
+  }
+  held = nostop;
+  return len;
+}
+
+int PIOI2C::read_blocking(uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+  rx_enable(true);
+  while (!pio_sm_is_rx_fifo_empty(pio, sm)) (void)pio_sm_get(pio, sm);
+  held ? repstart() : start();
+  put((addr << 2) | 3u);
+
+  /* Clock each byte in with 0xFF, ACK all but the last */
+  size_t to_send = len;
+  size_t got = 0;
+  bool addr_byte = true;
+  while ((to_send || got < len) && !error()) {
+    if (to_send && !pio_sm_is_tx_fifo_full(pio, sm)) {
+      --to_send;
+      uint16_t last = to_send ? 0 : (1u << PIO_I2C_FINAL_LSB) | (1u << PIO_I2C_NAK_LSB);
+      put((0xFFu << PIO_I2C_DATA_LSB) | last);
+    }
+    if (!pio_sm_is_rx_fifo_empty(pio, sm)) {
+      uint8_t value = pio_sm_get(pio, sm);
+      if (addr_byte) {
+        addr_byte = false;  // our own address, read back
+      } else {
+        dst[got++] = value;
+      }
+    }
+  }
+  if (!nostop) stop();
+
+  if (wait_idle() != PICO_OK) {
+    recover();
+    stop();
+    wait_idle();
+    held = false;
+    return PICO_ERROR_GENERIC;
+  }
+  held = nostop;
+  return len;
+}
+
+/* Async transfers */
+
+/* Record index of a transfer: START, write address + src, repeated START,
+ * read address + dst, STOP. Unused phases are left out. */
+uint16_t PIOI2C::record(const I2CTransfer *xfer, size_t index) const {
+  size_t write_len = xfer->src_len ? xfer->src_len + 1 : 0;
+  size_t restart_len = (xfer->src_len && xfer->dst_len) ? PIO_I2C_REPSTART_LEN : 0;
+  size_t read_len = xfer->dst_len ? xfer->dst_len + 1 : 0;
+
+  if (index < lead) return (lead == PIO_I2C_START_LEN) ? start_records[index]
+                                                        : repstart_records[index];
+  index -= lead;
+
+  if (index < write_len) {
+    if (index == 0) return (xfer->addr << 2) | 1u;
+    return (xfer->src[index - 1] << PIO_I2C_DATA_LSB) | (1u << PIO_I2C_NAK_LSB);
+  }
+  index -= write_len;
+
+  if (index < restart_len) return repstart_records[index];
+  index -= restart_len;
+
+  if (index < read_len) {
+    if (index == 0) return (xfer->addr << 2) | 3u;
+    uint16_t data = 0xFFu << PIO_I2C_DATA_LSB;
+    if (index < xfer->dst_len) return data;  // ACK
+    return data | (1u << PIO_I2C_FINAL_LSB) | (1u << PIO_I2C_NAK_LSB);
+  }
+  index -= read_len;
+
+  return stop_records[index];
+}
+
+void PIOI2C::async_stage() {
+  size_t n = total - pos;
+  if (n > PIO_I2C_CHUNK_LEN) n = PIO_I2C_CHUNK_LEN;
+  for (size_t i = 0; i < n; ++i, ++pos) {
+    cmd_buf[i] = record(active, pos);
+  }
+
+  dma_channel_config c = dma_channel_get_default_config(tx_chan);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+  dma_channel_configure(tx_chan, &c, &pio->txf[sm], cmd_buf, n, true);
+}
+
+void PIOI2C::async_start() {
+  active = queue[head];
+  head = (head + 1) % I2C_ASYNC_QUEUE_LEN;
+  --count;
+
+  size_t write_len = active->src_len ? active->src_len + 1 : 0;
+  size_t read_len = active->dst_len ? active->dst_len + 1 : 0;
+  lead = held ? PIO_I2C_REPSTART_LEN : PIO_I2C_START_LEN;
+  held = false;
+  pos = 0;
+  total = lead + write_len + (write_len && read_len ? PIO_I2C_REPSTART_LEN : 0) +
+          read_len + PIO_I2C_STOP_LEN;
+
+  /* Every address and data record pushes one byte. Everything before the
+   * read data goes to the sink, then the sink channel chains to dst. */
+  rx_enable(true);
+  while (!pio_sm_is_rx_fifo_empty(pio, sm)) (void)pio_sm_get(pio, sm);
+
+  dma_channel_config c = dma_channel_get_default_config(sink_chan);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+  if (read_len) channel_config_set_chain_to(&c, rx_chan);
+  size_t skip = write_len + (read_len ? 1 : 0);
+  dma_channel_configure(sink_chan, &c, &sink, &pio->rxf[sm], skip, true);
+
+  if (read_len) {
+    c = dma_channel_get_default_config(rx_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+    dma_channel_configure(rx_chan, &c, active->dst, &pio->rxf[sm], active->dst_len,
+                          false);
+  }
+
+  pio_interrupt_clear(pio, sm);
+  pio_set_irq0_source_enabled(pio, (pio_interrupt_source)(pis_interrupt0 + sm), true);
+  async_stage();
+}
+
+void PIOI2C::async_finish(bool failed) {
+  I2CTransfer *xfer = active;
+
+  /* the last byte is in, the STOP may still be going out */
+  if (!failed && wait_idle() != PICO_OK) failed = true;
+  if (failed) {
+    recover();
+    stop();
+    wait_idle();
+  }
+
+  xfer->result = failed ? PICO_ERROR_GENERIC : (int)(xfer->src_len + xfer->dst_len);
+  xfer->done = true;
+  active = nullptr;
+  if (xfer->callback) xfer->callback(xfer, xfer->ctx);
+
+  /* a transfer submitted by the callback is already running */
+  if (active != nullptr) return;
+  if (count > 0 && !blocking) {
+    async_start();
+  } else {
+    /* blocking calls poll the error flag themselves */
+    pio_set_irq0_source_enabled(pio, (pio_interrupt_source)(pis_interrupt0 + sm), false);
+  }
+}
+
+void PIOI2C::dma_irq() {
+  for (uint i = 0; i < PIO_I2C_MAX_BUSES; ++i) {
+    PIOI2C *bus = buses[i];
+    if (bus == nullptr || bus->tx_chan < 0) continue;
+
+    if (dma_channel_get_irq0_status(bus->tx_chan)) {
+      dma_channel_acknowledge_irq0(bus->tx_chan);
+      if (bus->active && bus->pos < bus->total) bus->async_stage();
+    }
+    if (dma_channel_get_irq0_status(bus->sink_chan)) {
+      dma_channel_acknowledge_irq0(bus->sink_chan);
+      if (bus->active && bus->active->dst_len == 0) bus->async_finish(false);
+    }
+    if (dma_channel_get_irq0_status(bus->rx_chan)) {
+      dma_channel_acknowledge_irq0(bus->rx_chan);
+      if (bus->active) bus->async_finish(false);
+    }
+  }
+}
+
+void PIOI2C::pio_irq() {
+  for (uint i = 0; i < PIO_I2C_MAX_BUSES; ++i) {
+    PIOI2C *bus = buses[i];
+    if (bus == nullptr || bus->active == nullptr || !bus->error()) continue;
+
+    /* NAK: stop the DMA without letting the aborts look like completions */
+    int chans[] = {bus->tx_chan, bus->sink_chan, bus->rx_chan};
+    for (int chan : chans) {
+      dma_channel_set_irq0_enabled(chan, false);
+      dma_channel_abort(chan);
+      dma_channel_acknowledge_irq0(chan);
+      dma_channel_set_irq0_enabled(chan, true);
+    }
+    bus->async_finish(true);
+  }
+}
+
+bool PIOI2C::submit(I2CTransfer *xfer) {
+  if (tx_chan < 0) {
+    static bool dma_irq_installed = false;
+    static bool pio_irq_installed[NUM_PIOS] = {false};
+    uint index = pio_get_index(pio);
+
+    tx_chan = dma_claim_unused_channel(true);
+    sink_chan = dma_claim_unused_channel(true);
+    rx_chan = dma_claim_unused_channel(true);
+    dma_channel_set_irq0_enabled(tx_chan, true);
+    dma_channel_set_irq0_enabled(sink_chan, true);
+    dma_channel_set_irq0_enabled(rx_chan, true);
+    if (!dma_irq_installed) {
+      irq_add_shared_handler(DMA_IRQ_0, dma_irq,
+                             PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+      irq_set_enabled(DMA_IRQ_0, true);
+      dma_irq_installed = true;
+    }
+    if (!pio_irq_installed[index]) {
+      uint irq = PIO_IRQ_NUM(pio, 0);
+      irq_add_shared_handler(irq, pio_irq,
+                             PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+      irq_set_enabled(irq, true);
+      pio_irq_installed[index] = true;
+    }
+  }
+
+  xfer->done = false;
+  xfer->result = 0;
+  if (xfer->src_len + xfer->dst_len == 0) {
+    xfer->done = true;
+    if (xfer->callback) xfer->callback(xfer, xfer->ctx);
+    return true;
+  }
+
+  uint32_t save = save_and_disable_interrupts();
+  if (count == I2C_ASYNC_QUEUE_LEN) {
+    restore_interrupts(save);
+    return false;
+  }
+  queue[(head + count) % I2C_ASYNC_QUEUE_LEN] = xfer;
+  ++count;
+  if (active == nullptr && !blocking) async_start();
+  restore_interrupts(save);
+  return true;
+}
+
+void PIOI2C::lock() {
+  uint32_t save = save_and_disable_interrupts();
+  ++blocking;
+  restore_interrupts(save);
+  while (active != nullptr) tight_loop_contents();
+}
+
+void PIOI2C::unlock() {
+  uint32_t save = save_and_disable_interrupts();
+  if (--blocking == 0 && active == nullptr && count > 0) async_start();
+  restore_interrupts(save);
+}
+
+/* END OF FILE */
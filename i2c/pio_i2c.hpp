@@ -0,0 +1,126 @@
+/** @file pio_i2c.hpp
+ *
+ * @brief I2C master on a PIO state machine.
+ *
+ * @par
+ * The RP2040 has two I2C blocks, and they are limited to Fast-mode Plus.
+ * PIOI2C runs the bus on a PIO state machine instead, so any GPIO pair can
+ * be a bus. The only requirement is that SCL = SDA + 1. Up to eight buses
+ * can run at once, one per state machine. The bus clock is configurable,
+ * and targets may stretch the clock.
+ *
+ * Blocking calls mirror the SDK's i2c_write_blocking / i2c_read_blocking.
+ * Async transfers reuse I2CTransfer: DMA streams the command records into
+ * the TX FIFO and the received bytes out of the RX FIFO.
+ *
+ * Wrap a PIOI2C in an I2C (I2C(&bus)) to use it with any driver here.
+ *
+ * @author Nathan Winslow
+ *
+ * @cite https://github.com/raspberrypi/pico-examples/tree/master/pio/i2c
+ */
+
+#ifndef _PIO_I2C_H
+#define _PIO_I2C_H
+
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "i2c.hpp"
+
+static constexpr uint8_t PIO_I2C_MAX_BUSES =
+    NUM_PIOS * NUM_PIO_STATE_MACHINES;  // one per state machine
+static constexpr uint8_t PIO_I2C_CHUNK_LEN = 32;     // records staged per DMA run
+static constexpr uint32_t PIO_I2C_TIMEOUT_US = 10000;  // bus stuck low
+
+class PIOI2C {
+ public:
+  /**
+   * @param pio any PIO block (pio0 - pio2 on RP2350)
+   * @param sda SDA pin, SCL must be sda + 1
+   * @param baudrate bus clock in Hz
+   */
+  PIOI2C(PIO pio, uint sda, uint32_t baudrate = I2C_DEFAULT_BAUDRATE);
+  ~PIOI2C();
+
+  PIOI2C(PIOI2C const &) = delete;
+  PIOI2C &operator=(PIOI2C const &) = delete;
+
+  /**
+   * @brief Same contract as i2c_write_blocking. Call it through I2C, which
+   * holds lock() around it.
+   * @return bytes written or PICO_ERROR_GENERIC
+   */
+  int write_blocking(uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+
+  /**
+   * @brief Same contract as i2c_read_blocking.
+   * @return bytes read or PICO_ERROR_GENERIC
+   */
+  int read_blocking(uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+
+  /**
+   * @brief Queues a transfer, see I2C::submit.
+   */
+  bool submit(I2CTransfer *xfer);
+
+  /**
+   * @brief See I2C::lock.
+   */
+  void lock();
+  void unlock();
+
+  bool is_busy() const { return active != nullptr || count > 0; }
+  void set_baudrate(uint32_t baudrate);
+
+  uint get_sda() const { return sda; }
+  uint get_scl() const { return sda + 1; }
+
+  /**
+   * @return bus number, 0 - PIO_I2C_MAX_BUSES - 1
+   */
+  uint8_t get_id() const { return id; }
+
+ private:
+  PIO pio;
+  uint sm;
+  uint offset;  // program offset in the PIO's instruction memory
+  uint sda;
+  uint8_t id;
+  bool held;  // last blocking call ended without a STOP
+
+  /* async engine */
+  int tx_chan;
+  int sink_chan;  // RX bytes before the read data
+  int rx_chan;
+  I2CTransfer *queue[I2C_ASYNC_QUEUE_LEN];
+  volatile uint8_t head;
+  volatile uint8_t count;
+  I2CTransfer *volatile active;
+  volatile uint8_t blocking = 0;  // blocking calls holding the bus
+  size_t pos;    // next record of the active transfer
+  size_t total;  // records in the active transfer
+  uint8_t lead;  // START or repeated START records at the head
+  uint8_t sink;  // RX bytes nobody asked for
+  uint16_t cmd_buf[PIO_I2C_CHUNK_LEN];
+
+  static PIOI2C *buses[PIO_I2C_MAX_BUSES];
+  static void dma_irq();
+  static void pio_irq();
+
+  void put(uint16_t record);
+  void start();
+  void repstart();
+  void stop();
+  bool error() const;
+  void recover();
+  int wait_idle();
+  void rx_enable(bool enabled);
+
+  uint16_t record(const I2CTransfer *xfer, size_t index) const;
+  void async_start();
+  void async_stage();
+  void async_finish(bool failed);
+};
+
+#endif  // end _PIO_I2C_H
+/* END OF FILE */
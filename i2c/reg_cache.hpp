@@ -0,0 +1,257 @@
+/** @file reg_cache.hpp
+ *
+ * @brief A write-through RAM shadow of a device's register map.
+ *
+ * @par
+ * The cache is templated on a device descriptor that lists each register's
+ * address, width and whether the device can change it on its own. Reads of
+ * non-volatile registers hit the bus once and are served from RAM after
+ * that. Writes go to the bus only when they change the shadowed value.
+ * Volatile registers (status, telemetry, command registers) always go to the
+ * bus. A descriptor looks like:
+ *
+ * @code
+ * struct MY_DEVICE_REGS {
+ *   static constexpr uint8_t ADDRESS = 0x28;
+ *   static constexpr bool BYTE_COUNT = false;
+ *   static constexpr RegDesc REGS[] = {
+ *       {0x0b, 1, true},   // alert status
+ *       {0x70, 1, false},  // configuration
+ *   };
+ * };
+ * @endcode
+ *
+ * BYTE_COUNT selects the TI host interface framing, where every transfer
+ * carries a length byte after the register address.
+ */
+
+#ifndef _REG_CACHE_H
+#define _REG_CACHE_H
+
+#include <string.h>
+
+#include "i2c.hpp"
+
+struct RegDesc {
+  uint8_t reg;
+  uint8_t width;     // bytes
+  bool is_volatile;  // the device may change it without a write from us
+};
+
+template <size_t N>
+constexpr int reg_map_find(const RegDesc (&regs)[N], uint8_t reg) {
+  for (size_t i = 0; i < N; ++i) {
+    if (regs[i].reg == reg) return i;
+  }
+  return -1;
+}
+
+template <size_t N>
+constexpr size_t reg_map_offset(const RegDesc (&regs)[N], size_t index) {
+  size_t offset = 0;
+  for (size_t i = 0; i < index; ++i) offset += regs[i].width;
+  return offset;
+}
+
+template <size_t N>
+constexpr uint8_t reg_map_max_width(const RegDesc (&regs)[N]) {
+  uint8_t width = 0;
+  for (size_t i = 0; i < N; ++i) {
+    if (regs[i].width > width) width = regs[i].width;
+  }
+  return width;
+}
+
+template <size_t N>
+constexpr bool reg_map_valid(const RegDesc (&regs)[N]) {
+  for (size_t i = 0; i < N; ++i) {
+    if (regs[i].width == 0) return false;
+    for (size_t j = i + 1; j < N; ++j) {
+      if (regs[i].reg == regs[j].reg) return false;
+    }
+  }
+  return true;
+}
+
+template <typename DEVICE>
+class RegCache {
+ public:
+  static constexpr size_t NUM_REGS = sizeof(DEVICE::REGS) / sizeof(RegDesc);
+  static constexpr size_t SIZE = reg_map_offset(DEVICE::REGS, NUM_REGS);
+  static constexpr uint8_t MAX_WIDTH = reg_map_max_width(DEVICE::REGS);
+
+  static_assert(reg_map_valid(DEVICE::REGS),
+                "register map has a zero width or duplicate register");
+
+  explicit RegCache(I2C *i2c) : i2c(i2c) {}
+
+  /**
+   * @brief Reads a whole register into dst, from RAM when it is non-volatile
+   * and already shadowed.
+   *
+   * @return width of the register, or PICO_ERROR_GENERIC if the register is
+   * not in the map or the device did not answer
+   */
+  int read(uint8_t reg, uint8_t *dst) {
+    int index = reg_map_find(DEVICE::REGS, reg);
+    if (index < 0) return PICO_ERROR_GENERIC;
+    const RegDesc &desc = DEVICE::REGS[index];
+    uint8_t *shadow = &data[reg_map_offset(DEVICE::REGS, index)];
+
+    if (!desc.is_volatile && valid[index]) {
+      memcpy(dst, shadow, desc.width);
+      ++saved;
+      return desc.width;
+    }
+    if (bus_read(desc, dst) < 0) return PICO_ERROR_GENERIC;
+    if (!desc.is_volatile) {
+      memcpy(shadow, dst, desc.width);
+      valid[index] = true;
+    }
+    return desc.width;
+  }
+
+  /**
+   * @brief Writes a whole register. Skips the bus when the shadow already
+   * holds the same value.
+   *
+   * @return width of the register, or PICO_ERROR_GENERIC
+   */
+  int write(uint8_t reg, const uint8_t *src) {
+    int index = reg_map_find(DEVICE::REGS, reg);
+    if (index < 0) return PICO_ERROR_GENERIC;
+    const RegDesc &desc = DEVICE::REGS[index];
+    uint8_t *shadow = &data[reg_map_offset(DEVICE::REGS, index)];
+
+    if (!desc.is_volatile && valid[index] && !memcmp(shadow, src, desc.width)) {
+      ++saved;
+      return desc.width;
+    }
+    if (bus_write(desc, src) < 0) {
+      valid[index] = false;  // the device may hold either value now
+      return PICO_ERROR_GENERIC;
+    }
+    if (!desc.is_volatile) {
+      memcpy(shadow, src, desc.width);
+      valid[index] = true;
+    }
+    return desc.width;
+  }
+
+  /* single byte helpers, reg must be one byte wide */
+  uint8_t read_uint8(uint8_t reg) {
+    uint8_t value = 0;
+    if (width_of(reg) == 1) read(reg, &value);
+    return value;
+  }
+
+  int write_uint8(uint8_t reg, uint8_t value) {
+    if (width_of(reg) != 1) return PICO_ERROR_GENERIC;
+    return write(reg, &value);
+  }
+
+  /**
+   * @brief Replaces the bits under mask. Once the register is shadowed this
+   * costs at most one bus write, and none if the bits already match.
+   */
+  int update_bits(uint8_t reg, uint8_t mask, uint8_t value) {
+    if (width_of(reg) != 1) return PICO_ERROR_GENERIC;
+    uint8_t current;
+    if (read(reg, &current) < 0) return PICO_ERROR_GENERIC;
+    current = (current & ~mask) | (value & mask);
+    return write(reg, &current);
+  }
+
+  /* same arguments as I2C::set_bits() and I2C::clear_bits() */
+  int set_bits(uint8_t reg, uint8_t shift, uint8_t mask = 0b1) {
+    return update_bits(reg, mask << shift, 0xff);
+  }
+
+  int clear_bits(uint8_t reg, uint8_t shift, uint8_t mask = 0b1) {
+    return update_bits(reg, mask << shift, 0x00);
+  }
+
+  /**
+   * @brief Drops every shadowed value, the next access goes to the bus.
+   * Call after the device resets or reloads its registers from NVM.
+   */
+  void invalidate() { memset(valid, 0, sizeof(valid)); }
+
+  void invalidate(uint8_t reg) {
+    int index = reg_map_find(DEVICE::REGS, reg);
+    if (index >= 0) valid[index] = false;
+  }
+
+  /**
+   * @brief Re-reads every non-volatile register from the device.
+   *
+   * @return number of registers read, or PICO_ERROR_GENERIC
+   */
+  int sync() {
+    int count = 0;
+    for (size_t i = 0; i < NUM_REGS; ++i) {
+      const RegDesc &desc = DEVICE::REGS[i];
+      if (desc.is_volatile) continue;
+      valid[i] = false;
+      if (bus_read(desc, &data[reg_map_offset(DEVICE::REGS, i)]) < 0) {
+        return PICO_ERROR_GENERIC;
+      }
+      valid[i] = true;
+      ++count;
+    }
+    return count;
+  }
+
+  /* bus transactions served from or skipped by the cache */
+  uint32_t get_saved() const { return saved; }
+
+  /* bus transactions actually issued */
+  uint32_t get_bus_ops() const { return bus_ops; }
+
+  void reset_stats() { saved = bus_ops = 0; }
+
+ private:
+  I2C *i2c;
+  uint8_t data[SIZE];
+  bool valid[NUM_REGS] = {false};
+  uint32_t saved = 0;
+  uint32_t bus_ops = 0;
+
+  static uint8_t width_of(uint8_t reg) {
+    int index = reg_map_find(DEVICE::REGS, reg);
+    return index < 0 ? 0 : DEVICE::REGS[index].width;
+  }
+
+  int bus_read(const RegDesc &desc, uint8_t *dst) {
+    uint8_t len = desc.width + (DEVICE::BYTE_COUNT ? 1 : 0);
+    uint8_t buff[MAX_WIDTH + 1];
+    ++bus_ops;
+    I2C::BusLock lock(i2c);  // no async transfer between the pointer and the read
+    if (i2c->write_blocking(DEVICE::ADDRESS, &desc.reg, 1, true) != 1) {
+      return PICO_ERROR_GENERIC;
+    }
+    if (i2c->read_blocking(DEVICE::ADDRESS, buff, len, false) != len) {
+      return PICO_ERROR_GENERIC;
+    }
+    memcpy(dst, &buff[len - desc.width], desc.width);
+    return desc.width;
+  }
+
+  int bus_write(const RegDesc &desc, const uint8_t *src) {
+    uint8_t header = DEVICE::BYTE_COUNT ? 2 : 1;
+    uint8_t buff[MAX_WIDTH + 2];
+    buff[0] = desc.reg;
+    buff[1] = desc.width;  // overwritten below without BYTE_COUNT
+    memcpy(&buff[header], src, desc.width);
+    ++bus_ops;
+    int len = header + desc.width;
+    if (i2c->write_blocking(DEVICE::ADDRESS, buff, len, false) != len) {
+      return PICO_ERROR_GENERIC;
+    }
+    return desc.width;
+  }
+};
+
+#endif  // END _REG_CACHE_H
+
+/* END OF FILE */
@@ -0,0 +1,178 @@
+/** @file reg_field.hpp
+ *
+ * @brief Compile-time register and bitfield descriptors.
+ *
+ * @par
+ * A Register names an address and a width in bytes. A BitField names a bit
+ * offset, a width in bits and an integer scaling (value = raw * LSB + BIAS),
+ * and a RegField binds one to a Register. Every accessor is constexpr and
+ * reduces to one shift and mask. RegUpdate folds writes to several fields of
+ * the same register into a single mask/value pair, so they cost one
+ * read-modify-write on the bus. Setting a field of another register, or a
+ * compile-time value out of range, fails to compile.
+ *
+ * Register addresses are either bus addresses (used with RegCache) or byte
+ * offsets into a RAM image such as the STUSB4500 NVM sectors. Multi-byte
+ * registers are little-endian, so a field may straddle a byte boundary.
+ */
+
+#ifndef _REG_FIELD_H
+#define _REG_FIELD_H
+
+#include <type_traits>
+
+#include "reg_cache.hpp"
+
+template <uint8_t ADDR, uint8_t SIZE>
+struct Register {
+  static_assert(SIZE > 0, "register has no bytes");
+
+  static constexpr uint8_t ADDRESS = ADDR;
+  static constexpr uint8_t WIDTH = SIZE;
+  static constexpr uint32_t FULL_MASK = SIZE >= 4 ? 0xffffffff : (1u << (8 * SIZE)) - 1;
+
+  static constexpr RegDesc desc(bool is_volatile) { return {ADDR, SIZE, is_volatile}; }
+
+  static constexpr uint32_t load(const uint8_t *buf) {
+    static_assert(SIZE <= 4, "only registers up to 32 bits hold fields");
+    uint32_t word = 0;
+    for (uint8_t i = 0; i < SIZE; ++i) word |= (uint32_t)buf[i] << (8 * i);
+    return word;
+  }
+
+  static constexpr void store(uint8_t *buf, uint32_t word) {
+    static_assert(SIZE <= 4, "only registers up to 32 bits hold fields");
+    for (uint8_t i = 0; i < SIZE; ++i) buf[i] = word >> (8 * i);
+  }
+};
+
+template <uint8_t OFFSET, uint8_t BITS, uint32_t LSB = 1, int32_t BIAS = 0>
+struct BitField {
+  static_assert(BITS > 0 && OFFSET + BITS <= 32, "field does not fit in 32 bits");
+  static_assert(LSB > 0, "field scale must be positive");
+
+  static constexpr uint8_t SHIFT = OFFSET;
+  static constexpr uint8_t NUM_BITS = BITS;
+  static constexpr uint32_t MAX_RAW = BITS == 32 ? 0xffffffff : (1u << BITS) - 1;
+  static constexpr uint32_t MASK = MAX_RAW << OFFSET;
+  static constexpr int32_t MIN = BIAS;
+  static constexpr int32_t MAX = BIAS + (int32_t)(MAX_RAW * LSB);
+
+  static constexpr bool in_range(int32_t value) { return value >= MIN && value <= MAX; }
+
+  /* raw access */
+  static constexpr uint32_t get(uint32_t word) { return (word & MASK) >> OFFSET; }
+  static constexpr uint32_t set(uint32_t word, uint32_t raw) {
+    return (word & ~MASK) | ((raw << OFFSET) & MASK);
+  }
+
+  /* scaled access, values outside [MIN, MAX] are clamped */
+  static constexpr int32_t decode(uint32_t raw) { return (int32_t)(raw * LSB) + BIAS; }
+  static constexpr uint32_t encode(int32_t value) {
+    if (value < MIN) value = MIN;
+    if (value > MAX) value = MAX;
+    return (uint32_t)(value - BIAS) / LSB;
+  }
+
+  static constexpr int32_t read(uint32_t word) { return decode(get(word)); }
+  static constexpr uint32_t write(uint32_t word, int32_t value) {
+    return set(word, encode(value));
+  }
+};
+
+template <typename REGISTER, typename BITFIELD>
+struct RegField : BITFIELD {
+  static_assert(BITFIELD::SHIFT + BITFIELD::NUM_BITS <= 8 * REGISTER::WIDTH,
+                "field runs past the end of its register");
+
+  using reg = REGISTER;
+
+  /* access through a RAM image indexed by register address */
+  static constexpr int32_t read_image(const uint8_t *image) {
+    return BITFIELD::read(REGISTER::load(&image[REGISTER::ADDRESS]));
+  }
+
+  static constexpr void write_image(uint8_t *image, int32_t value) {
+    uint8_t *buf = &image[REGISTER::ADDRESS];
+    REGISTER::store(buf, BITFIELD::write(REGISTER::load(buf), value));
+  }
+};
+
+/**
+ * @brief Accumulates field writes to one register.
+ *
+ * @code
+ * constexpr auto update = RegUpdate<CTRL>().set<CTRL_MODE, 2>().set<CTRL_EN, 1>();
+ * reg_apply(cache, update);  // one read (cached) and one write
+ * @endcode
+ */
+template <typename REGISTER>
+class RegUpdate {
+ public:
+  constexpr RegUpdate() = default;
+
+  template <typename FIELD>
+  constexpr RegUpdate &set(int32_t value) {
+    static_assert(std::is_same<typename FIELD::reg, REGISTER>::value,
+                  "field belongs to another register");
+    mask |= FIELD::MASK;
+    bits = FIELD::write(bits, value);
+    return *this;
+  }
+
+  template <typename FIELD, int32_t VALUE>
+  constexpr RegUpdate &set() {
+    static_assert(FIELD::in_range(VALUE), "value out of range for field");
+    return set<FIELD>(VALUE);
+  }
+
+  constexpr uint32_t apply(uint32_t word) const { return (word & ~mask) | bits; }
+
+  constexpr void apply_image(uint8_t *image) const {
+    uint8_t *buf = &image[REGISTER::ADDRESS];
+    REGISTER::store(buf, apply(REGISTER::load(buf)));
+  }
+
+  /* every bit is written, so the old contents are not needed */
+  constexpr bool covers_register() const { return mask == REGISTER::FULL_MASK; }
+
+  constexpr uint32_t get_mask() const { return mask; }
+  constexpr uint32_t get_bits() const { return bits; }
+
+ private:
+  uint32_t mask = 0;
+  uint32_t bits = 0;
+};
+
+/**
+ * @brief Reads one field through a register cache.
+ *
+ * @return PICO_ERROR_GENERIC if the bus read failed, 0 otherwise
+ */
+template <typename FIELD, typename CACHE>
+int reg_read(CACHE &cache, int32_t *value) {
+  uint8_t buf[FIELD::reg::WIDTH];
+  if (cache.read(FIELD::reg::ADDRESS, buf) < 0) return PICO_ERROR_GENERIC;
+  *value = FIELD::read(FIELD::reg::load(buf));
+  return 0;
+}
+
+/**
+ * @brief Writes every field in update with one bus write. The register is
+ * read first (from the cache when shadowed) unless update covers it.
+ *
+ * @return register width, or PICO_ERROR_GENERIC
+ */
+template <typename REGISTER, typename CACHE>
+int reg_apply(CACHE &cache, const RegUpdate<REGISTER> &update) {
+  uint8_t buf[REGISTER::WIDTH] = {0};
+  if (!update.covers_register() && cache.read(REGISTER::ADDRESS, buf) < 0) {
+    return PICO_ERROR_GENERIC;
+  }
+  REGISTER::store(buf, update.apply(REGISTER::load(buf)));
+  return cache.write(REGISTER::ADDRESS, buf);
+}
+
+#endif  // END _REG_FIELD_H
+
+/* END OF FILE */
@@ -4,8 +4,12 @@
 
 /*#define LCD_PRINT_DEBUG*/
 
-I2CLCD::I2CLCD(uint8_t num_rows, uint8_t num_cols) : LCD(num_rows, num_cols), i2c(I2C()), is_backlight(true) {
-  i2c.write_blocking(LCD_I2C_ADDRESS, 0x00, 1, false);
+I2CLCD::I2CLCD(uint8_t num_rows, uint8_t num_cols) : LCD(num_rows, num_cols), i2c(I2C()), is_backlight(true), next_xfer(0) {
+  for (uint8_t i = 0; i < LCD_XFER_RING; ++i) {
+    xfers[i].done = true;
+  }
+  uint8_t off = 0x00;
+  i2c.write_blocking(LCD_I2C_ADDRESS, &off, 1, false);
   write_nibble(LCD_FUNCTION_RESET);
   write_nibble(LCD_FUNCTION);
   display_off();
@@ -28,6 +32,7 @@ void I2CLCD::write_nibble(uint8_t nibble) {
 #if defined (LCD_PRINT_DEBUG)
   printf("writing nibble: 0x%X to 0x%X\n", byte, b_mask);
 #endif
+  drain();
   delay_ms(SLEEP_TIME_MS);
   i2c.write_blocking(LCD_I2C_ADDRESS, &b_mask, 1, false);
   delay_ms(SLEEP_TIME_MS);
@@ -44,6 +49,7 @@ void I2CLCD::write_command(uint8_t cmd) {
   printf("writing command: 0x%X to 0x%X\n", b, b_mask);
 #endif
 
+  drain();
   delay_ms(SLEEP_TIME_MS);
   i2c.write_blocking(LCD_I2C_ADDRESS, &b_mask, 1, false);
   delay_ms(SLEEP_TIME_MS);
@@ -70,38 +76,50 @@ void I2CLCD::write_command(uint8_t cmd) {
 
 void I2CLCD::write_data(uint8_t data) {
   uint8_t b = (MASK_RS | (is_backlight << SHIFT_BACKLIGHT) | (((data >> 4) & 0x0f) << SHIFT_DATA));
-  uint8_t b_mask = b | MASK_E;
+  uint8_t b_low = (MASK_RS | (is_backlight << SHIFT_BACKLIGHT) | ((data & 0x0f) << SHIFT_DATA));
 
 #if defined (LCD_PRINT_DEBUG)
-  printf("writing data: 0x%X to 0x%X\n", b, b_mask);
+  printf("writing data: 0x%X 0x%X\n", b, b_low);
 #endif
 
-  i2c.write_blocking(LCD_I2C_ADDRESS, &b_mask, 1, false);
-  delay_ms(SLEEP_TIME_MS);
-  i2c.write_blocking(LCD_I2C_ADDRESS, &b, 1, false);
-  delay_ms(SLEEP_TIME_MS);
-
-  b = (MASK_RS | (is_backlight << SHIFT_BACKLIGHT) | ((data & 0x0f) << SHIFT_DATA));
-  b_mask = b | MASK_E;
-
-#if defined (LCD_PRINT_DEBUG)
-  printf("writing data: 0x%X to 0x%X\n", b, b_mask);
-#endif
+  /* Both nibbles go out as one transfer. At 400 kHz each byte holds E for
+   * 22.5 us, and the next nibble latches at least three bytes later, after
+   * the 37 us the LCD needs to store this one. */
+  I2CTransfer *xfer = &xfers[next_xfer];
+  uint8_t *buf = xfer_bufs[next_xfer];
+  next_xfer = (next_xfer + 1) % LCD_XFER_RING;
+  while (!xfer->done) {
+    tight_loop_contents();
+  }
 
-  i2c.write_blocking(LCD_I2C_ADDRESS, &b_mask, 1, false);
-  delay_ms(SLEEP_TIME_MS);
-  i2c.write_blocking(LCD_I2C_ADDRESS, &b, 1, false);
+  buf[0] = b | MASK_E;
+  buf[1] = b;
+  buf[2] = b_low | MASK_E;
+  buf[3] = b_low;
+  while (!i2c.write_async(xfer, LCD_I2C_ADDRESS, buf, LCD_XFER_LEN)) {
+    tight_loop_contents();  // queue full
+  }
   return;
 }
 
+void I2CLCD::drain() {
+  for (uint8_t i = 0; i < LCD_XFER_RING; ++i) {
+    while (!xfers[i].done) {
+      tight_loop_contents();
+    }
+  }
+}
+
 void I2CLCD::backlight(bool on) {
+  drain();
   if (on) {
     uint8_t b = 1 << SHIFT_BACKLIGHT;
     i2c.write_blocking(LCD_I2C_ADDRESS, &b, 1, false);
     is_backlight = true;
     return;
   }
-  i2c.write_blocking(LCD_I2C_ADDRESS, 0x00, 1, false);
+  uint8_t off = 0x00;
+  i2c.write_blocking(LCD_I2C_ADDRESS, &off, 1, false);
   is_backlight = false;
   return;
 }
@@ -19,11 +19,15 @@
 
 #define LCD_I2C_ADDRESS (0x27)
 
+// write_data() transfers: E high and low for each nibble, kept in a ring
+#define LCD_XFER_LEN   (4)
+#define LCD_XFER_RING  (4)
+
 class I2CLCD : public LCD {
 
 public:
   I2CLCD(uint8_t num_rows, uint8_t num_cols);
-  ~I2CLCD() {}
+  ~I2CLCD() { drain(); }
 
   /* Derived methods */
   void write_command(uint8_t cmd);
@@ -32,8 +36,15 @@ public:
   void backlight(bool on);
 
 private:
+  /* Waits for every queued write_data() transfer. Blocking writes call it
+   * first, since they would otherwise go out ahead of the queued ones. */
+  void drain();
+
   I2C i2c;
   bool is_backlight;
+  I2CTransfer xfers[LCD_XFER_RING];
+  uint8_t xfer_bufs[LCD_XFER_RING][LCD_XFER_LEN];
+  uint8_t next_xfer;
 
 };
 
@@ -0,0 +1,64 @@
+/** @file glyph_cache.cpp
+ *
+ * @brief this module implements the shared glyph cache used by OLED::print_char.
+ *
+ * @author Nathan Winslow
+ */
+
+#include "glyph_cache.hpp"
+
+#include <cstring>
+
+GlyphCache *GlyphCache::inst = nullptr;
+
+GlyphCache::GlyphCache() : tick(0), stats{0} { flush(); }
+
+void GlyphCache::flush() {
+  for (uint16_t i = 0; i < GLYPH_CACHE_SLOTS; ++i) {
+    slots[i].font = nullptr;
+    slots[i].last_used = 0;
+  }
+}
+
+const uint8_t *GlyphCache::get(const GFXfont *font, uint8_t ch) {
+  const GFXglyph *glyph = font->glyph + (ch - font->first_char);
+  uint16_t size = glyph->width * ((glyph->height + 7) >> 3);
+  if (size > GLYPH_CACHE_SLOT_BYTES) return nullptr;
+
+  ++tick;
+  Slot *victim = &slots[0];
+  for (uint16_t i = 0; i < GLYPH_CACHE_SLOTS; ++i) {
+    Slot *slot = &slots[i];
+    if (slot->font == font && slot->ch == ch) {
+      slot->last_used = tick;
+      ++stats.hits;
+      return slot->data;
+    }
+    if (slot->last_used < victim->last_used) victim = slot;
+  }
+
+  ++stats.misses;
+  if (victim->font != nullptr) ++stats.evictions;
+  victim->font = font;
+  victim->ch = ch;
+  victim->last_used = tick;
+  render(font, glyph, victim->data);
+  return victim->data;
+}
+
+void GlyphCache::render(const GFXfont *font, const GFXglyph *glyph, uint8_t *dst) {
+  uint8_t width = glyph->width;
+  uint8_t height = glyph->height;
+  memset(dst, 0, width * ((height + 7) >> 3));
+
+  const uint8_t *bitmap = font->bitmap + glyph->bitmap_offset;
+  uint16_t bit = 0;
+  for (uint8_t i = 0; i < height; ++i) {
+    uint8_t *row = dst + (i >> 3) * width;
+    uint8_t mask = 1 << (i & 7);
+    for (uint8_t j = 0; j < width; ++j, ++bit) {
+      if (bitmap[bit >> 3] & (0x80 >> (bit & 7))) row[j] |= mask;
+    }
+  }
+}
+/* END OF FILE */
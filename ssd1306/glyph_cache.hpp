@@ -0,0 +1,89 @@
+/** @file glyph_cache.hpp
+ *
+ * @brief LRU cache of GFXfont glyphs pre-rendered into SSD1306 page bytes.
+ *
+ * @par
+ * GFXfont bitmaps are row-major bitstreams, so drawing one means decoding
+ * it bit by bit. The cache keeps recently used glyphs already transposed into
+ * ceil(height / 8) pages of width bytes so a hit is a plain raster_blit.
+ * One cache is shared by every OLED since entries are keyed by font.
+ *
+ * The budget is fixed at compile time, override GLYPH_CACHE_SLOTS and
+ * GLYPH_CACHE_SLOT_BYTES to resize it. Glyphs that do not fit in a slot are
+ * not cached.
+ *
+ * @author Nathan Winslow
+ */
+
+#ifndef _GLYPH_CACHE_H
+#define _GLYPH_CACHE_H
+
+#include "ssd1306.hpp"
+
+#ifndef GLYPH_CACHE_SLOTS
+#define GLYPH_CACHE_SLOTS 32
+#endif
+
+#ifndef GLYPH_CACHE_SLOT_BYTES
+#define GLYPH_CACHE_SLOT_BYTES 64
+#endif
+
+struct GlyphCacheStats {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t evictions;
+};
+
+class GlyphCache {
+ public:
+  static GlyphCache *inst;
+
+  static GlyphCache *get_instance() {
+    if (inst == nullptr) inst = new GlyphCache();
+    return inst;
+  }
+
+  GlyphCache(GlyphCache const &) = delete;
+  GlyphCache &operator=(GlyphCache const &) = delete;
+
+  /**
+   * @brief Looks up a glyph, rendering it into the least recently used slot
+   * on a miss.
+   *
+   * @param font font the glyph belongs to
+   * @param ch character code, must be within the font's range
+   * @return page-ordered image, or nullptr if the glyph is too large to cache
+   */
+  const uint8_t *get(const GFXfont *font, uint8_t ch);
+
+  /**
+   * @brief Drops every entry, e.g. after a font has been modified.
+   */
+  void flush();
+
+  const GlyphCacheStats &get_stats() const { return stats; }
+
+  /**
+   * @brief Renders a GFX glyph into page-ordered bytes.
+   *
+   * @param dst at least width * ceil(height / 8) bytes
+   */
+  static void render(const GFXfont *font, const GFXglyph *glyph, uint8_t *dst);
+
+ private:
+  GlyphCache();
+
+  struct Slot {
+    const GFXfont *font;  // nullptr when empty
+    uint8_t ch;
+    uint32_t last_used;
+    uint8_t data[GLYPH_CACHE_SLOT_BYTES];
+  };
+
+  Slot slots[GLYPH_CACHE_SLOTS];
+  uint32_t tick;
+  GlyphCacheStats stats;
+};
+
+#endif  // end _GLYPH_CACHE_H
+/* END OF FILE */
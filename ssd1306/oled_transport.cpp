@@ -0,0 +1,52 @@
+/** @file oled_transport.cpp
+ *
+ * @brief this module implements the I2C transport for the SSD1306.
+ *
+ * @author Nathan Winslow
+ */
+
+#include "oled_transport.hpp"
+
+I2C *oled_default_i2c() {
+  static I2C bus;
+  return &bus;
+}
+
+I2COLEDTransport::I2COLEDTransport(I2C *i2c, uint8_t address)
+    : i2c(i2c), address(address), done(nullptr), ctx(nullptr) {}
+
+void I2COLEDTransport::write_cmds(const uint8_t *cmds, uint16_t len) {
+  /* blocking calls must not interleave with a frame on the wire */
+  while (i2c->is_busy()) tight_loop_contents();
+  i2c->write_bytes(address, OLED_CTRL_CMD, cmds, len);
+}
+
+void I2COLEDTransport::write_data(const uint8_t *data, uint16_t len) {
+  while (i2c->is_busy()) tight_loop_contents();
+  i2c->write_bytes(address, OLED_CTRL_DATA, data, len);
+}
+
+bool I2COLEDTransport::write_frame_async(const uint8_t *cmds, uint8_t cmd_len,
+                                         uint8_t *data, uint16_t len,
+                                         oled_flush_cb_t done, void *ctx) {
+  if (cmd_len > OLED_FRAME_CMDS_MAX) return false;
+
+  cmd_buf[0] = OLED_CTRL_CMD;
+  for (uint8_t i = 0; i < cmd_len; ++i) {
+    cmd_buf[i + 1] = cmds[i];
+  }
+  this->done = done;
+  this->ctx = ctx;
+
+  /* The control byte goes in the header so the frame is one transfer */
+  data[-1] = OLED_CTRL_DATA;
+  if (!i2c->write_async(&cmd_xfer, address, cmd_buf, cmd_len + 1)) return false;
+  return i2c->write_async(&data_xfer, address, data - 1, len + 1, data_done, this);
+}
+
+void I2COLEDTransport::data_done(I2CTransfer *xfer, void *ctx) {
+  I2COLEDTransport *transport = static_cast<I2COLEDTransport *>(ctx);
+  if (transport->done) transport->done(transport->ctx);
+}
+
+/* END OF FILE */
@@ -0,0 +1,117 @@
+/** @file oled_transport.hpp
+ *
+ * @brief Byte transports between the OLED rendering core and an SSD1306.
+ *
+ * @par
+ * The controller only sees two streams, commands and GDDRAM data. Over I2C
+ * each stream is prefixed with a control byte, over 4-wire SPI it is selected
+ * with the D/C pin. OLED renders into its framebuffer and hands these
+ * streams to a transport, so the same driver runs on either bus.
+ *
+ * @author Nathan Winslow
+ */
+
+#ifndef _OLED_TRANSPORT_H
+#define _OLED_TRANSPORT_H
+
+#include "../i2c/i2c.hpp"
+#include "../i2c/pio_i2c.hpp"
+#include "pico/stdlib.h"
+
+static constexpr uint8_t OLED_ADDRESS = 0x3C;
+
+static constexpr uint8_t OLED_CTRL_CMD = 0x00;   // control byte: command stream
+static constexpr uint8_t OLED_CTRL_DATA = 0x40;  // control byte: GDDRAM data stream
+
+static constexpr uint8_t OLED_FRAME_HEADER = 4;  // scratch bytes in front of a frame
+
+/**
+ * @return bytes from one frame to the next for a buff_size byte framebuffer,
+ * rounded up so the second frame's buffer is word aligned as well
+ */
+static constexpr uint16_t oled_frame_stride(uint16_t buff_size) {
+  return (OLED_FRAME_HEADER + buff_size + 3) & ~3u;
+}
+static constexpr uint8_t OLED_FRAME_CMDS_MAX = 8;
+static constexpr uint8_t OLED_MAX_BUSES = NUM_I2CS + NUM_SPIS + PIO_I2C_MAX_BUSES;
+
+/* Called from IRQ context once a frame has been sent */
+typedef void (*oled_flush_cb_t)(void *ctx);
+
+class OLEDTransport {
+ public:
+  virtual ~OLEDTransport() {}
+
+  /**
+   * @brief Sends a run of controller commands, blocking.
+   */
+  virtual void write_cmds(const uint8_t *cmds, uint16_t len) = 0;
+
+  /**
+   * @brief Sends a run of GDDRAM bytes, blocking.
+   */
+  virtual void write_data(const uint8_t *data, uint16_t len) = 0;
+
+  /**
+   * @brief Sends cmds, then data, in the background.
+   *
+   * @param cmds at most OLED_FRAME_CMDS_MAX commands, copied before returning
+   * @param data frame to send, preceded by OLED_FRAME_HEADER bytes the
+   * transport may overwrite. Must stay untouched until done is called.
+   * @param len bytes of data
+   * @param done completion callback, may be nullptr
+   * @param ctx passed to done
+   * @return false if the frame could not be queued
+   */
+  virtual bool write_frame_async(const uint8_t *cmds, uint8_t cmd_len, uint8_t *data,
+                                 uint16_t len, oled_flush_cb_t done, void *ctx) = 0;
+
+  /**
+   * @return true while a background frame is still being sent.
+   */
+  virtual bool is_busy() = 0;
+
+  /**
+   * @return 0 - NUM_I2CS - 1 for I2C blocks, NUM_I2CS + n for SPI block n,
+   * NUM_I2CS + NUM_SPIS + n for PIO I2C bus n.
+   */
+  virtual uint8_t get_bus() = 0;
+};
+
+/**
+ * @brief The bus on the default pins used by OLED(height, width, reversed).
+ * It is created on first use and never released, so deleting an OLED cannot
+ * take it away from other panels on the same block.
+ */
+I2C *oled_default_i2c();
+
+class I2COLEDTransport : public OLEDTransport {
+ public:
+  /**
+   * @param i2c must outlive the transport, panels on one block share it
+   */
+  explicit I2COLEDTransport(I2C *i2c, uint8_t address = OLED_ADDRESS);
+
+  void write_cmds(const uint8_t *cmds, uint16_t len) override;
+  void write_data(const uint8_t *data, uint16_t len) override;
+  bool write_frame_async(const uint8_t *cmds, uint8_t cmd_len, uint8_t *data,
+                         uint16_t len, oled_flush_cb_t done, void *ctx) override;
+  bool is_busy() override { return i2c->is_busy(); }
+  uint8_t get_bus() override {
+    return i2c->is_pio() ? NUM_I2CS + NUM_SPIS + i2c->get_index() : i2c->get_index();
+  }
+
+ private:
+  I2C *i2c;
+  uint8_t address;
+  uint8_t cmd_buf[1 + OLED_FRAME_CMDS_MAX];  // control byte + commands
+  I2CTransfer cmd_xfer;
+  I2CTransfer data_xfer;
+  oled_flush_cb_t done;
+  void *ctx;
+
+  static void data_done(I2CTransfer *xfer, void *ctx);
+};
+
+#endif  // end _OLED_TRANSPORT_H
+/* END OF FILE */
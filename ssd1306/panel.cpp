@@ -0,0 +1,57 @@
+/** @file panel.cpp
+ *
+ * @brief this module implements the multi-panel flush scheduler.
+ *
+ * @author Nathan Winslow
+ */
+
+#include "panel.hpp"
+
+PanelSet::PanelSet() : count(0), stats{0} {
+  for (uint8_t bus = 0; bus < OLED_MAX_BUSES; ++bus) {
+    next[bus] = 0;
+  }
+}
+
+bool PanelSet::add(OLED *panel) {
+  if (count >= PANEL_SET_MAX) return false;
+  panels[count++] = panel;
+  return true;
+}
+
+uint8_t PanelSet::tick() {
+  uint8_t started = 0;
+  ++stats.ticks;
+
+  for (uint8_t bus = 0; bus < OLED_MAX_BUSES; ++bus) {
+    /* one frame in flight per bus keeps every panel's latency bounded */
+    for (uint8_t n = 0; n < count; ++n) {
+      uint8_t i = (next[bus] + n) % count;
+      OLED *panel = panels[i];
+      if (panel->get_bus() != bus) continue;
+      if (panel->is_bus_busy()) break;
+      if (!panel->has_changes() || panel->is_flushing()) continue;
+
+      if (panel->present()) {
+        ++started;
+        ++stats.frames;
+      }
+      next[bus] = (i + 1) % count;
+      break;
+    }
+  }
+  return started;
+}
+
+void PanelSet::flush() {
+  bool pending = true;
+  while (pending) {
+    tick();
+    pending = false;
+    for (uint8_t i = 0; i < count; ++i) {
+      if (panels[i]->has_changes() || panels[i]->is_flushing()) pending = true;
+    }
+  }
+}
+
+/* END OF FILE */
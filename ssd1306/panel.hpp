@@ -0,0 +1,111 @@
+/** @file panel.hpp
+ *
+ * @brief Compile-time sized SSD1306 panels and a flush scheduler for sets of
+ * panels spread over both I2C blocks.
+ *
+ * @par
+ * Panel<WIDTH, HEIGHT, ADDRESS> is an OLED whose double buffer is a member
+ * sized exactly for its geometry, so a 128x32 panel uses 2 * 512 bytes. It
+ * can be used anywhere an OLED can.
+ *
+ * PanelSet keeps every bus busy. Whenever a bus goes idle it presents the
+ * next changed panel on that bus, round robin, so panels on i2c0, i2c1 and
+ * the SPI blocks flush in parallel. Panels that share a bus take turns.
+ * tools/panel_sim.py models the same policy on the host and reports
+ * aggregate frame rates for a given panel layout.
+ *
+ * @author Nathan Winslow
+ */
+
+#ifndef _PANEL_H
+#define _PANEL_H
+
+#include "ssd1306.hpp"
+
+#ifndef PANEL_SET_MAX
+#define PANEL_SET_MAX 8
+#endif
+
+/* Frame storage and the I2C transport live in a base class so they exist
+ * before OLED's constructor clears and shows the panel. The transport only
+ * borrows the bus, a panel never releases it. */
+template <uint16_t FRAME_SIZE, uint8_t ADDRESS>
+struct PanelFrames {
+  explicit PanelFrames(I2C *i2c) : panel_transport(i2c, ADDRESS) {}
+
+  alignas(4) uint8_t panel_frames[2][FRAME_SIZE];
+  I2COLEDTransport panel_transport;  // unused on other transports
+};
+
+template <uint8_t WIDTH, uint8_t HEIGHT, uint8_t ADDRESS = OLED_ADDRESS>
+class Panel : private PanelFrames<oled_frame_stride(WIDTH * (HEIGHT / 8)), ADDRESS>,
+              public OLED {
+  typedef PanelFrames<oled_frame_stride(WIDTH * (HEIGHT / 8)), ADDRESS> Frames;
+
+  static_assert(HEIGHT % 8 == 0, "panel height must be a whole number of pages");
+  static_assert(HEIGHT / 8 <= OLED_MAX_PAGES, "panel is taller than the SSD1306");
+  static_assert(WIDTH <= 128, "panel is wider than the SSD1306");
+  static_assert(sizeof(Frames::panel_frames[0]) % 4 == 0,
+                "both frame buffers must be word aligned");
+
+ public:
+  static constexpr uint16_t BUFF_SIZE = WIDTH * (HEIGHT / 8);
+
+  /**
+   * @param i2c must outlive the panel, panels on one block share it
+   */
+  Panel(I2C *i2c, bool reversed = false)
+      : Frames(i2c),
+        OLED(&this->panel_transport, false, HEIGHT, WIDTH, reversed,
+             this->panel_frames[0], this->panel_frames[1]) {}
+
+  /**
+   * @param transport e.g. an SPIOLEDTransport, ADDRESS is not used
+   */
+  Panel(OLEDTransport *transport, bool reversed = false)
+      : Frames(nullptr),
+        OLED(transport, false, HEIGHT, WIDTH, reversed, this->panel_frames[0],
+             this->panel_frames[1]) {}
+};
+
+using Panel128x64 = Panel<128, 64>;
+using Panel128x32 = Panel<128, 32>;
+
+struct PanelSetStats {
+  uint32_t frames;  // frames presented across all panels
+  uint32_t ticks;   // calls to tick()
+};
+
+class PanelSet {
+ public:
+  PanelSet();
+
+  /**
+   * @return false if the set is full
+   */
+  bool add(OLED *panel);
+
+  /**
+   * @brief Presents the next changed panel on every idle bus. Call it
+   * from the main loop after drawing.
+   *
+   * @return number of frames started
+   */
+  uint8_t tick();
+
+  /**
+   * @brief Blocks until every changed panel has been flushed.
+   */
+  void flush();
+
+  const PanelSetStats &get_stats() const { return stats; }
+
+ private:
+  OLED *panels[PANEL_SET_MAX];
+  uint8_t count;
+  uint8_t next[OLED_MAX_BUSES];  // round robin position per bus
+  PanelSetStats stats;
+};
+
+#endif  // end _PANEL_H
+/* END OF FILE */
@@ -0,0 +1,265 @@
+/** @file raster.cpp
+ *
+ * @brief span and blit kernels shared by the OLED drawing primitives.
+ *
+ * @author Nathan Winslow
+ */
+
+#include "raster.hpp"
+
+#include <stddef.h>
+
+/* word view of the byte framebuffer */
+typedef uint32_t __attribute__((__may_alias__)) raster_word_t;
+
+/* mask covering rows first .. last (0 - 7) of a page byte */
+static inline uint8_t page_mask(uint8_t first, uint8_t last) {
+  return (uint8_t)((0xFF << first) & (0xFF >> (7 - last)));
+}
+
+void raster_or_run(uint8_t *dst, uint8_t mask, uint16_t len) {
+  while (len && ((uintptr_t)dst & 3)) {
+    *dst++ |= mask;
+    --len;
+  }
+
+  uint32_t word_mask = mask * 0x01010101u;
+  raster_word_t *word = (raster_word_t *)dst;
+  for (; len >= 4; len -= 4) {
+    *word++ |= word_mask;
+  }
+
+  dst = (uint8_t *)word;
+  while (len--) {
+    *dst++ |= mask;
+  }
+}
+
+void raster_hspan(uint8_t *buf, uint8_t width, uint8_t x, uint8_t y, uint8_t w) {
+  raster_or_run(buf + (y >> 3) * width + x, 1 << (y & 7), w);
+}
+
+void raster_vspan(uint8_t *buf, uint8_t width, uint8_t x, uint8_t y, uint8_t h) {
+  if (h == 0) return;
+  uint8_t y_end = y + h - 1;
+  uint8_t first_page = y >> 3;
+  uint8_t last_page = y_end >> 3;
+  uint8_t *dst = buf + first_page * width + x;
+
+  if (first_page == last_page) {
+    *dst |= page_mask(y & 7, y_end & 7);
+    return;
+  }
+
+  *dst |= page_mask(y & 7, 7);
+  for (uint8_t page = first_page + 1; page < last_page; ++page) {
+    dst += width;
+    *dst = 0xFF;
+  }
+  dst += width;
+  *dst |= page_mask(0, y_end & 7);
+}
+
+void raster_fill_rect(uint8_t *buf, uint8_t width, uint8_t x, uint8_t y, uint8_t w,
+                      uint8_t h) {
+  if (w == 0 || h == 0) return;
+  uint8_t y_end = y + h - 1;
+  uint8_t first_page = y >> 3;
+  uint8_t last_page = y_end >> 3;
+
+  for (uint8_t page = first_page; page <= last_page; ++page) {
+    uint8_t first = (page == first_page) ? (y & 7) : 0;
+    uint8_t last = (page == last_page) ? (y_end & 7) : 7;
+    raster_or_run(buf + page * width + x, page_mask(first, last), w);
+  }
+}
+
+/* single clipped pixel */
+static inline void raster_pixel(uint8_t *buf, uint8_t width, uint8_t height, int16_t x,
+                                int16_t y) {
+  if (x < 0 || y < 0 || x >= width || y >= height) return;
+  buf[(y >> 3) * width + x] |= 1 << (y & 7);
+}
+
+void raster_hspan_clip(uint8_t *buf, uint8_t width, uint8_t height, int16_t x0,
+                       int16_t x1, int16_t y) {
+  if (y < 0 || y >= height) return;
+  if (x0 > x1) {
+    int16_t tmp = x0;
+    x0 = x1;
+    x1 = tmp;
+  }
+  if (x0 < 0) x0 = 0;
+  if (x1 >= width) x1 = width - 1;
+  if (x0 > x1) return;
+  raster_hspan(buf, width, x0, y, x1 - x0 + 1);
+}
+
+void raster_vspan_clip(uint8_t *buf, uint8_t width, uint8_t height, int16_t x,
+                       int16_t y0, int16_t y1) {
+  if (x < 0 || x >= width) return;
+  if (y0 > y1) {
+    int16_t tmp = y0;
+    y0 = y1;
+    y1 = tmp;
+  }
+  if (y0 < 0) y0 = 0;
+  if (y1 >= height) y1 = height - 1;
+  if (y0 > y1) return;
+  raster_vspan(buf, width, x, y0, y1 - y0 + 1);
+}
+
+void raster_line(uint8_t *buf, uint8_t width, uint8_t height, int16_t x0, int16_t y0,
+                 int16_t x1, int16_t y1) {
+  /* axis aligned lines go through the span kernels */
+  if (y0 == y1) {
+    raster_hspan_clip(buf, width, height, x0, x1, y0);
+    return;
+  }
+  if (x0 == x1) {
+    raster_vspan_clip(buf, width, height, x0, y0, y1);
+    return;
+  }
+
+  int16_t dx = (x1 > x0) ? x1 - x0 : x0 - x1;
+  int16_t dy = (y1 > y0) ? y0 - y1 : y1 - y0;  // kept negative
+  int8_t sx = (x0 < x1) ? 1 : -1;
+  int8_t sy = (y0 < y1) ? 1 : -1;
+  int16_t err = dx + dy;
+
+  while (true) {
+    raster_pixel(buf, width, height, x0, y0);
+    if (x0 == x1 && y0 == y1) break;
+    int16_t e2 = 2 * err;
+    if (e2 >= dy) {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      y0 += sy;
+    }
+  }
+}
+
+void raster_circle(uint8_t *buf, uint8_t width, uint8_t height, int16_t xc, int16_t yc,
+                   uint16_t radius) {
+  int16_t x = radius;
+  int16_t y = 0;
+  int16_t err = 1 - x;
+
+  while (x >= y) {
+    raster_pixel(buf, width, height, xc + x, yc + y);
+    raster_pixel(buf, width, height, xc - x, yc + y);
+    raster_pixel(buf, width, height, xc + x, yc - y);
+    raster_pixel(buf, width, height, xc - x, yc - y);
+    raster_pixel(buf, width, height, xc + y, yc + x);
+    raster_pixel(buf, width, height, xc - y, yc + x);
+    raster_pixel(buf, width, height, xc + y, yc - x);
+    raster_pixel(buf, width, height, xc - y, yc - x);
+    ++y;
+    if (err < 0) {
+      err += 2 * y + 1;
+    } else {
+      --x;
+      err += 2 * (y - x) + 1;
+    }
+  }
+}
+
+void raster_filled_circle(uint8_t *buf, uint8_t width, uint8_t height, int16_t xc,
+                          int16_t yc, uint16_t radius) {
+  int16_t x = radius;
+  int16_t y = 0;
+  int16_t err = 1 - x;
+
+  while (x >= y) {
+    raster_hspan_clip(buf, width, height, xc - x, xc + x, yc + y);
+    raster_hspan_clip(buf, width, height, xc - x, xc + x, yc - y);
+    raster_hspan_clip(buf, width, height, xc - y, xc + y, yc + x);
+    raster_hspan_clip(buf, width, height, xc - y, xc + y, yc - x);
+    ++y;
+    if (err < 0) {
+      err += 2 * y + 1;
+    } else {
+      --x;
+      err += 2 * (y - x) + 1;
+    }
+  }
+}
+
+void raster_clear(uint8_t *buf, uint16_t len) {
+  raster_word_t *word = (raster_word_t *)buf;
+  for (uint16_t i = 0; i < len / 4; ++i) {
+    word[i] = 0;
+  }
+  for (uint16_t i = len & ~3u; i < len; ++i) {
+    buf[i] = 0;
+  }
+}
+
+void raster_clear_rect(uint8_t *buf, uint8_t width, uint8_t x, uint8_t y, uint8_t w,
+                       uint8_t h) {
+  if (w == 0 || h == 0) return;
+  uint8_t y_end = y + h - 1;
+  uint8_t first_page = y >> 3;
+  uint8_t last_page = y_end >> 3;
+
+  for (uint8_t page = first_page; page <= last_page; ++page) {
+    uint8_t first = (page == first_page) ? (y & 7) : 0;
+    uint8_t last = (page == last_page) ? (y_end & 7) : 7;
+    uint8_t keep = ~page_mask(first, last);
+    uint8_t *dst = buf + page * width + x;
+    for (uint8_t c = 0; c < w; ++c) {
+      dst[c] &= keep;
+    }
+  }
+}
+
+/* rows of page that fall inside [clip_y0, clip_y1) */
+static inline uint8_t clip_mask(int16_t page, int16_t clip_y0, int16_t clip_y1) {
+  int16_t first = clip_y0 - page * 8;
+  int16_t last = clip_y1 - page * 8 - 1;
+  if (first > 7 || last < 0) return 0;
+  return page_mask(first < 0 ? 0 : first, last > 7 ? 7 : last);
+}
+
+void raster_blit(uint8_t *buf, uint8_t width, uint8_t height, int16_t x, int16_t y,
+                 uint8_t w, uint8_t h, const uint8_t *img) {
+  raster_blit_clip(buf, width, 0, 0, width, height, x, y, w, h, img);
+}
+
+void raster_blit_clip(uint8_t *buf, uint8_t width, int16_t clip_x0, int16_t clip_y0,
+                      int16_t clip_x1, int16_t clip_y1, int16_t x, int16_t y, uint8_t w,
+                      uint8_t h, const uint8_t *img) {
+  /* visible image columns */
+  int16_t col_start = (x < clip_x0) ? clip_x0 - x : 0;
+  int16_t col_end = (x + w > clip_x1) ? clip_x1 - x : w;
+  if (col_start >= col_end) return;
+
+  int16_t img_pages = (h + 7) >> 3;
+  /* floor division so negative y lands on the page above */
+  int16_t page = (y >= 0) ? (y >> 3) : -((7 - y) >> 3);
+  uint8_t shift = y - page * 8;
+
+  for (int16_t p = 0; p < img_pages; ++p, ++page) {
+    const uint8_t *src = img + p * w;
+
+    uint8_t mask = clip_mask(page, clip_y0, clip_y1);
+    if (mask) {
+      uint8_t *dst = buf + page * width + x;
+      for (int16_t c = col_start; c < col_end; ++c) {
+        dst[c] |= (src[c] << shift) & mask;
+      }
+    }
+
+    mask = shift ? clip_mask(page + 1, clip_y0, clip_y1) : 0;
+    if (mask) {
+      uint8_t *dst = buf + (page + 1) * width + x;
+      for (int16_t c = col_start; c < col_end; ++c) {
+        dst[c] |= (src[c] >> (8 - shift)) & mask;
+      }
+    }
+  }
+}
+/* END OF FILE */
@@ -0,0 +1,95 @@
+/** @file raster.hpp
+ *
+ * @brief Span and blit kernels for SSD1306 page-ordered framebuffers.
+ *
+ * @par
+ * A framebuffer is (height / 8) pages of `width` bytes. Bit n of a byte is
+ * pixel row (page * 8 + n). The span kernels expect already clipped
+ * coordinates, raster_blit clips on its own.
+ *
+ * @author Nathan Winslow
+ */
+
+#ifndef _RASTER_H
+#define _RASTER_H
+
+#include <stdint.h>
+
+/**
+ * @brief ORs mask into len consecutive bytes, using word stores for the
+ * aligned middle of the run.
+ */
+void raster_or_run(uint8_t *dst, uint8_t mask, uint16_t len);
+
+/**
+ * @brief Sets pixels (x .. x + w - 1, y), one mask over a byte run.
+ */
+void raster_hspan(uint8_t *buf, uint8_t width, uint8_t x, uint8_t y, uint8_t w);
+
+/**
+ * @brief Sets pixels (x, y .. y + h - 1). Interior pages are whole 0xFF bytes.
+ */
+void raster_vspan(uint8_t *buf, uint8_t width, uint8_t x, uint8_t y, uint8_t h);
+
+/**
+ * @brief Fills a w * h rectangle, one masked byte run per page.
+ */
+void raster_fill_rect(uint8_t *buf, uint8_t width, uint8_t x, uint8_t y, uint8_t w,
+                      uint8_t h);
+
+/**
+ * @brief Clipped spans for callers working in signed screen coordinates.
+ * Endpoints are inclusive and may come in either order.
+ */
+void raster_hspan_clip(uint8_t *buf, uint8_t width, uint8_t height, int16_t x0,
+                       int16_t x1, int16_t y);
+void raster_vspan_clip(uint8_t *buf, uint8_t width, uint8_t height, int16_t x,
+                       int16_t y0, int16_t y1);
+
+/**
+ * @brief Integer Bresenham line, all octants, clipped per pixel.
+ */
+void raster_line(uint8_t *buf, uint8_t width, uint8_t height, int16_t x0, int16_t y0,
+                 int16_t x1, int16_t y1);
+
+/**
+ * @brief Midpoint circle outline centred on (xc, yc).
+ */
+void raster_circle(uint8_t *buf, uint8_t width, uint8_t height, int16_t xc, int16_t yc,
+                   uint16_t radius);
+
+/**
+ * @brief Midpoint circle filled with one horizontal span per row pair.
+ */
+void raster_filled_circle(uint8_t *buf, uint8_t width, uint8_t height, int16_t xc,
+                          int16_t yc, uint16_t radius);
+
+/**
+ * @brief Zeroes len bytes with word stores and the last len % 4 with byte
+ * stores. buf must be word aligned.
+ */
+void raster_clear(uint8_t *buf, uint16_t len);
+
+/**
+ * @brief ORs a page-ordered image into the framebuffer at any pixel offset.
+ * img holds ceil(h / 8) pages of w bytes, the bits past h must be zero.
+ */
+void raster_blit(uint8_t *buf, uint8_t width, uint8_t height, int16_t x, int16_t y,
+                 uint8_t w, uint8_t h, const uint8_t *img);
+
+/**
+ * @brief raster_blit limited to the clip rectangle [clip_x0, clip_x1) x
+ * [clip_y0, clip_y1), which must lie inside the framebuffer.
+ */
+void raster_blit_clip(uint8_t *buf, uint8_t width, int16_t clip_x0, int16_t clip_y0,
+                      int16_t clip_x1, int16_t clip_y1, int16_t x, int16_t y, uint8_t w,
+                      uint8_t h, const uint8_t *img);
+
+/**
+ * @brief Clears a w * h rectangle, the counterpart of raster_fill_rect.
+ */
+void raster_clear_rect(uint8_t *buf, uint8_t width, uint8_t x, uint8_t y, uint8_t w,
+                       uint8_t h);
+
+#endif  // end _RASTER_H
+/* END OF FILE */
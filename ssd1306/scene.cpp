@@ -0,0 +1,198 @@
+/** @file scene.cpp
+ *
+ * @brief this module implements the retained-mode widgets and their scene.
+ *
+ * @author Nathan Winslow
+ */
+
+#include "scene.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+/* Label */
+Label::Label(OLED *oled, uint8_t x, uint8_t y, uint8_t width, uint8_t height,
+             const char *text, TextAlign align)
+    : Widget(x, y, width, height), layout(oled, x, y, width, height, align) {
+  layout.set_text(text);
+}
+
+void Label::set_text(const char *text) {
+  if (layout.set_text(text)) dirty = true;
+}
+
+void Label::draw(OLED *oled) { layout.draw(false); }
+
+/* NumericReadout */
+NumericReadout::NumericReadout(OLED *oled, uint8_t x, uint8_t y, uint8_t width,
+                               uint8_t height, uint8_t decimals, const char *unit,
+                               TextAlign align)
+    : Widget(x, y, width, height),
+      layout(oled, x, y, width, height, align),
+      value(0),
+      decimals(decimals) {
+  strncpy(this->unit, (unit != nullptr) ? unit : "", READOUT_MAX_UNIT);
+  this->unit[READOUT_MAX_UNIT] = '\0';
+  format();
+}
+
+void NumericReadout::set_value(int32_t value) {
+  if (value == this->value) return;
+  this->value = value;
+  format();
+}
+
+void NumericReadout::format() {
+  char text[TEXT_LAYOUT_MAX_LEN + 1];
+  uint32_t magnitude = (value < 0) ? -(uint32_t)value : value;
+  const char *sign = (value < 0) ? "-" : "";
+
+  if (decimals == 0) {
+    snprintf(text, sizeof(text), "%s%lu%s", sign, (unsigned long)magnitude, unit);
+  } else {
+    uint32_t divisor = 1;
+    for (uint8_t i = 0; i < decimals; ++i) divisor *= 10;
+    snprintf(text, sizeof(text), "%s%lu.%0*lu%s", sign,
+             (unsigned long)(magnitude / divisor), decimals,
+             (unsigned long)(magnitude % divisor), unit);
+  }
+  if (layout.set_text(text)) dirty = true;
+}
+
+void NumericReadout::draw(OLED *oled) { layout.draw(false); }
+
+/* BarGraph */
+BarGraph::BarGraph(uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint16_t max)
+    : Widget(x, y, width, height), max(max ? max : 1), fill(0) {}
+
+void BarGraph::set_value(uint16_t value) {
+  if (value > max) value = max;
+  uint8_t inner = (box.width > 2) ? box.width - 2 : 0;  // no room inside the border
+  uint8_t fill = (uint32_t)inner * value / max;
+  if (fill == this->fill) return;
+  this->fill = fill;
+  dirty = true;
+}
+
+void BarGraph::draw(OLED *oled) {
+  oled->draw_rectangle(box.x, box.y, box.width, box.height);
+  if (fill && box.height > 2) {
+    oled->draw_filled_rectangle(box.x + 1, box.y + 1, fill, box.height - 2);
+  }
+}
+
+/* Sparkline */
+Sparkline::Sparkline(uint8_t x, uint8_t y, uint8_t width, uint8_t height, int16_t low,
+                     int16_t high)
+    : Widget(x, y, width, height),
+      low(low),
+      high((high > low) ? high : low + 1),
+      capacity((width < SPARKLINE_MAX_POINTS) ? width : SPARKLINE_MAX_POINTS),
+      head(0),
+      count(0) {}
+
+void Sparkline::push(int16_t sample) {
+  if (capacity == 0) return;  // zero width, nowhere to plot
+  samples[head] = sample;
+  head = (head + 1 == capacity) ? 0 : head + 1;
+  if (count < capacity) ++count;
+  dirty = true;
+}
+
+uint8_t Sparkline::scale(int16_t sample) const {
+  if (sample < low) sample = low;
+  if (sample > high) sample = high;
+  int32_t rows = box.height - 1;
+  return box.y + rows - (int32_t)(sample - low) * rows / (high - low);
+}
+
+void Sparkline::draw(OLED *oled) {
+  if (count == 0 || box.height == 0) return;
+  /* oldest sample on the left edge */
+  uint8_t index = (count == capacity) ? head : 0;
+  uint8_t prev = scale(samples[index]);
+  for (uint8_t i = 1; i < count; ++i) {
+    if (++index == capacity) index = 0;
+    uint8_t cur = scale(samples[index]);
+    oled->draw_line(box.x + i - 1, prev, box.x + i, cur);
+    prev = cur;
+  }
+  if (count == 1) oled->draw_fast_hline(box.x, prev, 1);
+}
+
+/* Icon */
+Icon::Icon(uint8_t x, uint8_t y, uint8_t width, uint8_t height, const uint8_t *img)
+    : Widget(x, y, width, height), img(img), visible(true) {}
+
+void Icon::set_bitmap(const uint8_t *img) {
+  if (img == this->img) return;
+  this->img = img;
+  dirty = true;
+}
+
+void Icon::set_visible(bool visible) {
+  if (visible == this->visible) return;
+  this->visible = visible;
+  dirty = true;
+}
+
+void Icon::draw(OLED *oled) {
+  if (visible && img != nullptr) {
+    oled->draw_bitmap(box.x, box.y, box.width, box.height, img);
+  }
+}
+
+/* Scene */
+Scene::Scene(OLED *oled) : oled(oled), used(0), count(0) {}
+
+Scene::~Scene() { reset(); }
+
+uint8_t Scene::render() {
+  Widget *damaged[SCENE_MAX_WIDGETS];
+  uint8_t n_damaged = 0;
+
+  for (uint8_t i = 0; i < count; ++i) {
+    if (!widgets[i]->is_dirty()) continue;
+    const WidgetBox &box = widgets[i]->get_box();
+    oled->clear_rect(box.x, box.y, box.width, box.height);
+    damaged[n_damaged++] = widgets[i];
+  }
+  if (n_damaged == 0) return 0;
+
+  /* Redraw in z order everything that overlaps a cleared box */
+  uint8_t redrawn = 0;
+  for (uint8_t i = 0; i < count; ++i) {
+    Widget *widget = widgets[i];
+    bool hit = widget->is_dirty();
+    for (uint8_t d = 0; d < n_damaged && !hit; ++d) {
+      hit = widget->get_box().intersects(damaged[d]->get_box());
+    }
+    if (!hit) continue;
+
+    const WidgetBox &box = widget->get_box();
+    oled->set_clip(box.x, box.y, box.width, box.height);
+    widget->draw(oled);
+    widget->clean();
+    ++redrawn;
+  }
+  oled->clear_clip();
+
+  oled->show();
+  return redrawn;
+}
+
+void Scene::invalidate() {
+  for (uint8_t i = 0; i < count; ++i) {
+    widgets[i]->invalidate();
+  }
+}
+
+void Scene::reset() {
+  for (uint8_t i = 0; i < count; ++i) {
+    widgets[i]->~Widget();
+  }
+  count = 0;
+  used = 0;
+}
+
+/* END OF FILE */
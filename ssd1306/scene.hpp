@@ -0,0 +1,222 @@
+/** @file scene.hpp
+ *
+ * @brief Retained-mode widgets for the SSD1306 with damage-based redraw.
+ *
+ * @par
+ * Widgets keep their own state and bounding box and flag themselves dirty
+ * only when a setter changes what they would draw. Scene::render() clears
+ * the boxes of the dirty widgets, redraws every widget that touches one of
+ * those boxes and finishes with a partial show(), so a mostly static
+ * dashboard costs next to nothing per tick. Drawing is OR-only, so redrawing
+ * an overlapping widget in full never disturbs pixels outside the damage.
+ *
+ * Widgets are placement-constructed in a fixed arena inside the Scene and
+ * are never freed individually. Resize the arena with SCENE_ARENA_BYTES and
+ * SCENE_MAX_WIDGETS.
+ *
+ * @author Nathan Winslow
+ */
+
+#ifndef _SCENE_H
+#define _SCENE_H
+
+#include <new>
+
+#include "ssd1306.hpp"
+#include "text_layout.hpp"
+
+#ifndef SCENE_ARENA_BYTES
+#define SCENE_ARENA_BYTES 2048
+#endif
+
+#ifndef SCENE_MAX_WIDGETS
+#define SCENE_MAX_WIDGETS 16
+#endif
+
+static constexpr uint8_t SPARKLINE_MAX_POINTS = 128;
+static constexpr uint8_t READOUT_MAX_UNIT = 4;
+
+struct WidgetBox {
+  uint8_t x;
+  uint8_t y;
+  uint8_t width;
+  uint8_t height;
+
+  bool intersects(const WidgetBox &other) const {
+    return x < other.x + other.width && other.x < x + width &&
+           y < other.y + other.height && other.y < y + height;
+  }
+};
+
+class Widget {
+ public:
+  virtual ~Widget() {}
+
+  /**
+   * @brief Draws the widget into the OLED buffer. The box has already been
+   * cleared by the scene.
+   */
+  virtual void draw(OLED *oled) = 0;
+
+  const WidgetBox &get_box() const { return box; }
+  bool is_dirty() const { return dirty; }
+
+  /**
+   * @brief Forces a redraw on the next render().
+   */
+  void invalidate() { dirty = true; }
+  void clean() { dirty = false; }
+
+ protected:
+  Widget(uint8_t x, uint8_t y, uint8_t width, uint8_t height)
+      : box{x, y, width, height}, dirty(true) {}
+
+  WidgetBox box;
+  bool dirty;
+};
+
+/**
+ * @brief Static or rarely changing text.
+ */
+class Label : public Widget {
+ public:
+  Label(OLED *oled, uint8_t x, uint8_t y, uint8_t width, uint8_t height,
+        const char *text, TextAlign align = ALIGN_LEFT);
+
+  void set_text(const char *text);
+  void draw(OLED *oled) override;
+
+ private:
+  TextLayout layout;
+};
+
+/**
+ * @brief Fixed-point number with an optional unit, e.g. 1204 with two
+ * decimals and unit "V" reads "12.04V". Right aligned by default.
+ */
+class NumericReadout : public Widget {
+ public:
+  NumericReadout(OLED *oled, uint8_t x, uint8_t y, uint8_t width, uint8_t height,
+                 uint8_t decimals, const char *unit, TextAlign align = ALIGN_RIGHT);
+
+  void set_value(int32_t value);
+  int32_t get_value() const { return value; }
+  void draw(OLED *oled) override;
+
+ private:
+  TextLayout layout;
+  int32_t value;
+  uint8_t decimals;
+  char unit[READOUT_MAX_UNIT + 1];
+
+  void format();
+};
+
+/**
+ * @brief Horizontal bar filled in proportion to value / max. Only dirties
+ * itself when the filled width in pixels actually changes.
+ */
+class BarGraph : public Widget {
+ public:
+  BarGraph(uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint16_t max);
+
+  void set_value(uint16_t value);
+  void draw(OLED *oled) override;
+
+ private:
+  uint16_t max;
+  uint8_t fill;  // filled width in pixels
+};
+
+/**
+ * @brief Rolling line plot of the last width samples between low and high.
+ */
+class Sparkline : public Widget {
+ public:
+  Sparkline(uint8_t x, uint8_t y, uint8_t width, uint8_t height, int16_t low,
+            int16_t high);
+
+  void push(int16_t sample);
+  void draw(OLED *oled) override;
+
+ private:
+  int16_t low;
+  int16_t high;
+  int16_t samples[SPARKLINE_MAX_POINTS];
+  uint8_t capacity;
+  uint8_t head;   // next slot to write
+  uint8_t count;
+
+  uint8_t scale(int16_t sample) const;
+};
+
+/**
+ * @brief A row-major bitmap, such as those in bitmap.hpp, that can be shown
+ * or hidden.
+ */
+class Icon : public Widget {
+ public:
+  Icon(uint8_t x, uint8_t y, uint8_t width, uint8_t height, const uint8_t *img);
+
+  void set_bitmap(const uint8_t *img);
+  void set_visible(bool visible);
+  void draw(OLED *oled) override;
+
+ private:
+  const uint8_t *img;
+  bool visible;
+};
+
+class Scene {
+ public:
+  Scene(OLED *oled);
+  ~Scene();
+
+  /**
+   * @brief Constructs a widget in the scene's arena. Widgets added later are
+   * drawn on top.
+   *
+   * @return the widget, or nullptr if the arena or widget table is full
+   */
+  template <typename T, typename... Args>
+  T *add(Args... args) {
+    size_t offset = (used + alignof(T) - 1) & ~(alignof(T) - 1);
+    if (count >= SCENE_MAX_WIDGETS || offset + sizeof(T) > SCENE_ARENA_BYTES) {
+      return nullptr;
+    }
+    T *widget = new (arena + offset) T(args...);
+    used = offset + sizeof(T);
+    widgets[count++] = widget;
+    return widget;
+  }
+
+  /**
+   * @brief Redraws the damaged part of the scene and sends it to the panel.
+   *
+   * @return number of widgets redrawn
+   */
+  uint8_t render();
+
+  /**
+   * @brief Marks every widget dirty, e.g. after something else drew over
+   * the screen.
+   */
+  void invalidate();
+
+  /**
+   * @brief Destroys every widget and empties the arena.
+   */
+  void reset();
+
+  size_t arena_used() const { return used; }
+
+ private:
+  OLED *oled;
+  alignas(8) uint8_t arena[SCENE_ARENA_BYTES];
+  size_t used;
+  Widget *widgets[SCENE_MAX_WIDGETS];
+  uint8_t count;
+};
+
+#endif  // end _SCENE_H
+/* END OF FILE */
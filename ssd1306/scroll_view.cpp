@@ -0,0 +1,125 @@
+/** @file scroll_view.cpp
+ *
+ * @brief this module implements the hardware-assisted scrolling views.
+ *
+ * @author Nathan Winslow
+ */
+
+#include "scroll_view.hpp"
+
+#include <cstring>
+
+#include "text_layout.hpp"
+
+/* LogView */
+LogView::LogView(OLED *oled, uint8_t line_height)
+    : oled(oled), count(0), start(0), stats{0} {
+  line_height &= ~7;
+  if (line_height == 0) line_height = 8;
+  if (line_height > oled->get_height()) line_height = oled->get_height();
+  this->line_height = line_height;
+  rows = oled->get_height() / line_height;
+  hardware = oled->get_height() == OLED_GDDRAM_ROWS &&
+             (OLED_GDDRAM_ROWS % line_height) == 0;
+  clear();
+}
+
+void LogView::clear() {
+  oled->is_scroll(false);
+  oled->clear_buffer();
+  start = 0;
+  count = 0;
+  oled->set_start_line(0);
+  oled->show();
+}
+
+void LogView::append(const char *text) {
+  uint8_t row;
+  bool step = false;
+
+  if (count < rows) {
+    row = count++ * line_height;
+  } else if (hardware) {
+    /* The old top line becomes the new bottom line */
+    row = start;
+    start = (start + line_height) % OLED_GDDRAM_ROWS;
+    step = true;
+    ++stats.hardware_steps;
+  } else {
+    uint8_t width = oled->get_width();
+    uint8_t line_pages = line_height >> 3;
+    uint8_t *buffer = oled->get_buffer();
+    row = (rows - 1) * line_height;
+    memmove(buffer, buffer + line_pages * width, (row >> 3) * width);
+    oled->mark_dirty_rect(0, 0, width, row);
+    ++stats.full_redraws;
+  }
+
+  TextLayout line(oled, 0, row, oled->get_width(), line_height);
+  line.set_text(text);
+  line.draw();
+  oled->show();
+  /* Only move once the recycled row holds the new line, or the old top flashes */
+  if (step) oled->set_start_line(start);
+}
+
+/* GraphView */
+GraphView::GraphView(OLED *oled, uint8_t x, uint8_t page, uint8_t width, uint8_t pages,
+                     int16_t low, int16_t high, bool hardware)
+    : oled(oled),
+      x(x),
+      page(page),
+      width(width),
+      pages(pages),
+      low(low),
+      high((high > low) ? high : low + 1),
+      hardware(hardware),
+      has_prev(false),
+      prev_y(0),
+      last_step_us(0),
+      stats{0} {
+  if (hardware) oled->is_scroll(false);
+}
+
+uint8_t GraphView::scale(int16_t sample) const {
+  if (sample < low) sample = low;
+  if (sample > high) sample = high;
+  int32_t rows = pages * 8 - 1;
+  return page * 8 + rows - (int32_t)(sample - low) * rows / (high - low);
+}
+
+void GraphView::push(int16_t sample) {
+  /* GDDRAM has to match the buffer before the controller shifts it */
+  oled->show();
+
+  uint8_t *buffer = oled->get_buffer();
+  uint8_t stride = oled->get_width();
+  uint8_t col = x + width - 1;
+  for (uint8_t p = page; p < page + pages; ++p) {
+    uint8_t *row = buffer + p * stride + x;
+    memmove(row, row + 1, width - 1);
+    row[width - 1] = 0;
+  }
+
+  uint8_t y = scale(sample);
+  uint8_t y0 = (has_prev && prev_y < y) ? prev_y : y;
+  uint8_t y1 = (has_prev && prev_y > y) ? prev_y : y;
+  oled->draw_fast_vline(col, y0, y1 - y0 + 1);
+  prev_y = y;
+  has_prev = true;
+
+  uint32_t now = time_us_32();
+  if (hardware && now - last_step_us >= SCROLL_CONTENT_GAP_US) {
+    oled->scroll_content(true, page, page + pages - 1, x, col);
+    /* the column that wrapped round still has to be overwritten */
+    oled->mark_dirty_rect(col, page * 8, 1, pages * 8);
+    last_step_us = now;
+    ++stats.hardware_steps;
+  } else {
+    oled->mark_dirty_rect(x, page * 8, width, pages * 8);
+    ++stats.full_redraws;
+  }
+  oled->show();
+}
+
+/* END OF FILE */
@@ -0,0 +1,109 @@
+/** @file scroll_view.hpp
+ *
+ * @brief Scrolling log and graph views that let the SSD1306 do the scrolling.
+ *
+ * @par
+ * Redrawing a scrolled log or plot changes every pixel, so the whole region
+ * has to go over the bus again. Both views keep the framebuffer as an exact
+ * mirror of GDDRAM instead, move the existing contents with a controller
+ * command, and send only the newly exposed pixels.
+ *
+ * LogView moves the display start line, so a new line of text costs one
+ * command plus line_height / 8 pages. It needs a 64 row panel and a line
+ * height that divides 64. Otherwise it shifts the buffer and resends the
+ * panel. LogView owns the whole panel, because the start line moves every
+ * row on it.
+ *
+ * GraphView uses the one-column content scroll (2Ch/2Dh), so each sample
+ * costs one command plus a single column. The controller needs about two
+ * frame periods between scroll steps. A sample that arrives sooner falls
+ * back to resending the graph region.
+ *
+ * @author Nathan Winslow
+ */
+
+#ifndef _SCROLL_VIEW_H
+#define _SCROLL_VIEW_H
+
+#include "ssd1306.hpp"
+
+static constexpr uint32_t SCROLL_CONTENT_GAP_US = 25000;  // ~2 frames, default clock
+
+struct ScrollStats {
+  uint32_t hardware_steps;  // scrolled by the controller
+  uint32_t full_redraws;    // region resent instead
+};
+
+class LogView {
+ public:
+  /**
+   * @param oled display to use, the view owns all of it
+   * @param line_height pixels per line, rounded down to a multiple of 8
+   */
+  LogView(OLED *oled, uint8_t line_height = 16);
+
+  /**
+   * @brief Writes a line at the bottom, scrolling older lines up once the
+   * view is full.
+   */
+  void append(const char *text);
+
+  /**
+   * @brief Blanks the view and resets the start line.
+   */
+  void clear();
+
+  const ScrollStats &get_stats() const { return stats; }
+
+ private:
+  OLED *oled;
+  uint8_t line_height;
+  uint8_t rows;   // lines that fit on the panel
+  uint8_t count;  // lines written, up to rows
+  uint8_t start;  // GDDRAM row shown at the top
+  bool hardware;
+  ScrollStats stats;
+};
+
+class GraphView {
+ public:
+  /**
+   * @param oled display to draw on
+   * @param x first column of the graph
+   * @param page first page of the graph
+   * @param width columns, one per sample
+   * @param pages height of the graph in pages
+   * @param low sample value drawn on the bottom row
+   * @param high sample value drawn on the top row
+   * @param hardware false to always resend the region
+   */
+  GraphView(OLED *oled, uint8_t x, uint8_t page, uint8_t width, uint8_t pages,
+            int16_t low, int16_t high, bool hardware = true);
+
+  /**
+   * @brief Scrolls the graph one column left and plots sample on the right
+   * edge. Any other pending drawing is sent first.
+   */
+  void push(int16_t sample);
+
+  const ScrollStats &get_stats() const { return stats; }
+
+ private:
+  OLED *oled;
+  uint8_t x;
+  uint8_t page;
+  uint8_t width;
+  uint8_t pages;
+  int16_t low;
+  int16_t high;
+  bool hardware;
+  bool has_prev;
+  uint8_t prev_y;
+  uint32_t last_step_us;
+  ScrollStats stats;
+
+  uint8_t scale(int16_t sample) const;
+};
+
+#endif  // end _SCROLL_VIEW_H
+/* END OF FILE */
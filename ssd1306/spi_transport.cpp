@@ -0,0 +1,135 @@
+/** @file spi_transport.cpp
+ *
+ * @brief this module implements the 4-wire SPI transport for the SSD1306.
+ *
+ * @author Nathan Winslow
+ */
+
+#include "spi_transport.hpp"
+
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+SPIOLEDTransport *SPIOLEDTransport::owners[NUM_DMA_CHANNELS] = {nullptr};
+SPIOLEDTransport *volatile SPIOLEDTransport::block_owner[NUM_SPIS] = {nullptr};
+bool SPIOLEDTransport::block_ready[NUM_SPIS] = {false};
+
+SPIOLEDTransport::SPIOLEDTransport(uint dc, uint rst, uint cs, uint mosi, uint sclk,
+                                   uint32_t baudrate)
+    : spi(((mosi >> 3) & 0x01) ? spi1 : spi0),
+      dc(dc),
+      cs(cs),
+      mosi(mosi),
+      sclk(sclk),
+      done(nullptr),
+      ctx(nullptr) {
+  /* spi_init() resets the block, so only the first panel on it runs it */
+  uint index = spi_get_index(spi);
+  if (!block_ready[index]) {
+    spi_init(spi, baudrate);
+    spi_set_format(spi, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    block_ready[index] = true;
+  }
+  gpio_set_function(mosi, GPIO_FUNC_SPI);
+  gpio_set_function(sclk, GPIO_FUNC_SPI);
+
+  gpio_init(cs);
+  gpio_set_dir(cs, GPIO_OUT);
+  gpio_put(cs, 1);
+  gpio_init(dc);
+  gpio_set_dir(dc, GPIO_OUT);
+
+  if (rst != PIN_UNUSED) {
+    gpio_init(rst);
+    gpio_set_dir(rst, GPIO_OUT);
+    gpio_put(rst, 0);
+    sleep_ms(1);
+    gpio_put(rst, 1);
+    sleep_ms(1);
+  }
+
+  static bool dma_irq_installed = false;
+  dma_chan = dma_claim_unused_channel(true);
+  owners[dma_chan] = this;
+  dma_channel_set_irq1_enabled(dma_chan, true);
+  if (!dma_irq_installed) {
+    irq_add_shared_handler(DMA_IRQ_1, dma_irq,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_1, true);
+    dma_irq_installed = true;
+  }
+}
+
+SPIOLEDTransport::~SPIOLEDTransport() {
+  while (block_owner[spi_get_index(spi)] == this) tight_loop_contents();
+  dma_channel_set_irq1_enabled(dma_chan, false);
+  owners[dma_chan] = nullptr;
+  dma_channel_unclaim(dma_chan);
+}
+
+/* Takes the SPI block if no transport is using it. A frame callback may
+ * start the next frame from the DMA IRQ, hence the critical section. */
+bool SPIOLEDTransport::claim() {
+  uint index = spi_get_index(spi);
+  uint32_t save = save_and_disable_interrupts();
+  bool free = block_owner[index] == nullptr;
+  if (free) block_owner[index] = this;
+  restore_interrupts(save);
+  return free;
+}
+
+void SPIOLEDTransport::write(bool data, const uint8_t *src, uint16_t len) {
+  while (!claim()) tight_loop_contents();
+  gpio_put(dc, data);
+  gpio_put(cs, 0);
+  spi_write_blocking(spi, src, len);
+  gpio_put(cs, 1);
+  block_owner[spi_get_index(spi)] = nullptr;
+}
+
+void SPIOLEDTransport::write_cmds(const uint8_t *cmds, uint16_t len) {
+  write(false, cmds, len);
+}
+
+void SPIOLEDTransport::write_data(const uint8_t *data, uint16_t len) {
+  write(true, data, len);
+}
+
+bool SPIOLEDTransport::write_frame_async(const uint8_t *cmds, uint8_t cmd_len,
+                                         uint8_t *data, uint16_t len,
+                                         oled_flush_cb_t done, void *ctx) {
+  if (cmd_len > OLED_FRAME_CMDS_MAX || !claim()) return false;
+  this->done = done;
+  this->ctx = ctx;
+
+  /* The window commands are a few bytes, only the frame goes by DMA */
+  gpio_put(cs, 0);
+  gpio_put(dc, 0);
+  spi_write_blocking(spi, cmds, cmd_len);
+  gpio_put(dc, 1);
+
+  dma_channel_config c = dma_channel_get_default_config(dma_chan);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, spi_get_dreq(spi, true));
+  dma_channel_configure(dma_chan, &c, &spi_get_hw(spi)->dr, data, len, true);
+  return true;
+}
+
+void SPIOLEDTransport::dma_irq() {
+  for (uint chan = 0; chan < NUM_DMA_CHANNELS; ++chan) {
+    SPIOLEDTransport *t = owners[chan];
+    if (t == nullptr || !dma_channel_get_irq1_status(chan)) continue;
+    dma_channel_acknowledge_irq1(chan);
+
+    /* DMA is done once the FIFO is fed, wait for the last byte to shift out */
+    while (spi_is_busy(t->spi)) tight_loop_contents();
+    gpio_put(t->cs, 1);
+    block_owner[spi_get_index(t->spi)] = nullptr;
+    if (t->done) t->done(t->ctx);
+  }
+}
+
+/* END OF FILE */
@@ -1,9 +1,44 @@
 set(LIB_NAME ssd1306)
 add_library(${LIB_NAME} INTERFACE)
 
-target_sources(${LIB_NAME} INTERFACE ${CMAKE_CURRENT_LIST_DIR}/${LIB_NAME}.cpp)
+target_sources(${LIB_NAME} INTERFACE ${CMAKE_CURRENT_LIST_DIR}/${LIB_NAME}.cpp
+                                     ${CMAKE_CURRENT_LIST_DIR}/raster.cpp
+                                     ${CMAKE_CURRENT_LIST_DIR}/glyph_cache.cpp
+                                     ${CMAKE_CURRENT_LIST_DIR}/text_layout.cpp
+                                     ${CMAKE_CURRENT_LIST_DIR}/scene.cpp
+                                     ${CMAKE_CURRENT_LIST_DIR}/scroll_view.cpp
+                                     ${CMAKE_CURRENT_LIST_DIR}/panel.cpp
+                                     ${CMAKE_CURRENT_LIST_DIR}/oled_transport.cpp
+                                     ${CMAKE_CURRENT_LIST_DIR}/spi_transport.cpp)
 
 target_include_directories(${LIB_NAME} INTERFACE ${CMAKE_CURRENT_LIST_DIR})
 
 # Pull in pico libraries that are needed
-target_link_libraries(${LIB_NAME} INTERFACE pico_stdlib i2c)
+target_link_libraries(${LIB_NAME} INTERFACE pico_stdlib i2c hardware_spi hardware_dma hardware_irq)
+
+# Page-native font generation (see tools/fontconv.py)
+set(SSD1306_FONTCONV ${CMAKE_CURRENT_LIST_DIR}/../tools/fontconv.py CACHE INTERNAL "")
+
+# Converts a GFX font header or BDF font into a PageFont header at build time.
+# The result is written to <build>/fonts/<name>_page.hpp and that directory is
+# added to TARGET's include path. Extra args are passed to fontconv.py, e.g.
+#   ssd1306_add_page_font(my_project ssd1306/font/dialog_bold_16.hpp Dialog_bold_16)
+#   ssd1306_add_page_font(my_project fonts/tiny.bdf Tiny --first 0x30 --last 0x39)
+function(ssd1306_add_page_font TARGET INPUT NAME)
+  find_package(Python3 REQUIRED COMPONENTS Interpreter)
+  get_filename_component(INPUT ${INPUT} ABSOLUTE)
+  string(TOLOWER ${NAME} OUT_NAME)
+  set(OUT_DIR ${CMAKE_CURRENT_BINARY_DIR}/fonts)
+  set(OUTPUT ${OUT_DIR}/${OUT_NAME}_page.hpp)
+
+  add_custom_command(
+    OUTPUT ${OUTPUT}
+    COMMAND ${CMAKE_COMMAND} -E make_directory ${OUT_DIR}
+    COMMAND ${Python3_EXECUTABLE} ${SSD1306_FONTCONV} ${INPUT} ${OUTPUT} ${NAME} ${ARGN}
+    DEPENDS ${INPUT} ${SSD1306_FONTCONV}
+    COMMENT "Converting ${NAME} to a page-native font"
+  )
+  add_custom_target(${TARGET}_${OUT_NAME}_page DEPENDS ${OUTPUT})
+  add_dependencies(${TARGET} ${TARGET}_${OUT_NAME}_page)
+  target_include_directories(${TARGET} PRIVATE ${OUT_DIR})
+endfunction()
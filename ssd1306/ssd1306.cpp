@@ -12,108 +12,119 @@
 
 #include "ssd1306.hpp"
 
+#include <cstring>
+
+#include "glyph_cache.hpp"
+#include "raster.hpp"
 #include "font/dialog_bold_16.hpp"
 #include "font/ssd1306_font.hpp"
 
 /* Constructors */
 OLED::OLED(uint8_t height, uint8_t width, bool reversed)
-    : i2c(I2C()),
+    : OLED(new I2COLEDTransport(oled_default_i2c()), true, height, width, reversed,
+           nullptr, nullptr) {}
+
+OLED::OLED(I2C *i2c, uint8_t height, uint8_t width, bool reversed)
+    : OLED(new I2COLEDTransport(i2c), true, height, width, reversed, nullptr, nullptr) {}
+
+OLED::OLED(OLEDTransport *transport, uint8_t height, uint8_t width, bool reversed)
+    : OLED(transport, false, height, width, reversed, nullptr, nullptr) {}
+
+OLED::OLED(OLEDTransport *transport, bool owns_transport, uint8_t height, uint8_t width,
+           bool reversed, uint8_t *frame0, uint8_t *frame1)
+    : transport(transport),
+      owns_transport(owns_transport),
       height(height),
       width(width),
       reversed(reversed),
       pages(height / 8),
       buff_size(width * pages),
-      my_font(&Dialog_bold_16) {
-  init();
-  clear_buffer();
-  show();
+      owns_frames(frame0 == nullptr),
+      front(1),
+      flushing(false),
+      stats{0},
+      my_font(&Dialog_bold_16),
+      page_font(nullptr),
+      clip_x0(0),
+      clip_y0(0),
+      clip_x1(width),
+      clip_y1(height) {
+  if (owns_frames) {
+    /* new[] is at least word aligned, so buffer stays word aligned too */
+    frame0 = new uint8_t[2 * oled_frame_stride(buff_size)]();
+    frame1 = frame0 + oled_frame_stride(buff_size);
+  }
+  setup(frame0, frame1);
 }
 
-OLED::OLED(I2C i2c, uint8_t height, uint8_t width, bool reversed)
-    : i2c(i2c),
-      height(height),
-      width(width),
-      reversed(reversed),
-      pages(height / 8),
-      buff_size(width * pages),
-      my_font(&Dialog_bold_16) {
+OLED::~OLED() {
+  wait_flush();
+  if (owns_frames) delete[] frames[0];
+  if (owns_transport) delete transport;
+}
+
+void OLED::setup(uint8_t *frame0, uint8_t *frame1) {
+  frames[0] = frame0;
+  frames[1] = frame1;
+  buffer = frames[0] + OLED_FRAME_HEADER;
+  /* the raster kernels clear and fill both buffers with word stores */
+  hard_assert((((uintptr_t)frame0 | (uintptr_t)frame1) & 3) == 0);
   init();
   clear_buffer();
   show();
 }
 
-OLED::~OLED() {}
-
 /* Private Methods */
 void OLED::init() {
-  write_cmd(SET_DISP | 0x00);
-
-  /* Set horizontal address mode */
-  write_cmd(SET_MEM_ADDR);
-  write_cmd(0x00);
+  /* The whole sequence goes out as a single command stream */
+  uint8_t cmds[] = {
+      SET_DISP | 0x00,
 
-  /* Set the seg-map */
-  if (reversed)
-    write_cmd(SET_SEG_REMAP);
-  else
-    write_cmd(SET_SEG_REMAP | 0x01);
+      /* Set horizontal address mode */
+      SET_MEM_ADDR, 0x00,
 
-  /* set the display offset */
-  write_cmd(SET_DISP_OFFSET);
-  write_cmd(0x00);
+      /* Set the seg-map */
+      (uint8_t)(reversed ? SET_SEG_REMAP : SET_SEG_REMAP | 0x01),
 
-  /* Set COM pins hardware configuration, 0x12 for 128x64 and 0x02 for 128x32 */
-  write_cmd(SET_COM_PIN_CFG);
+      /* set the display offset */
+      SET_DISP_OFFSET, 0x00,
 
-  if (height == 64)
-    write_cmd(0x12);  // TODO: may want to change to switch case
-  else if (height == 32)
-    write_cmd(0x02);
+      /* Set COM pins hardware configuration, 0x12 for 128x64 and 0x02 for 128x32 */
+      SET_COM_PIN_CFG, (uint8_t)(height == 64 ? 0x12 : 0x02),
 
-  write_cmd(SET_DISP_CLK_DIV);
-  write_cmd(0x80);
+      SET_DISP_CLK_DIV, 0x80,
 
-  write_cmd(SET_PRECHARGE);
-  write_cmd(0xf1);
+      SET_PRECHARGE, 0xf1,
 
-  write_cmd(SET_VCOM_DESEL);
-  write_cmd(0x30);
+      SET_VCOM_DESEL, 0x30,
 
-  write_cmd(SET_CONTRAST);
-  write_cmd(0xff);
+      SET_CONTRAST, 0xff,
 
-  /* Set OLED on following from RAM */
-  write_cmd(SET_ENTIRE_ON);
+      /* Set OLED on following from RAM */
+      SET_ENTIRE_ON,
 
-  // NO inverse, '0' for pixel off, '1' for pixel on
-  write_cmd(SET_NORM_INV);
+      // NO inverse, '0' for pixel off, '1' for pixel on
+      SET_NORM_INV,
 
-  write_cmd(SET_CHARGE_PUMP);
-  write_cmd(0x14);
+      SET_CHARGE_PUMP, 0x14,
 
-  /* Set scroll to off */
-  write_cmd(SET_SCROLL | 0x00);
+      /* Set scroll to off */
+      SET_SCROLL | 0x00,
 
-  /* Turn the OLED on */
-  write_cmd(SET_DISP | 0x01);
+      /* Turn the OLED on */
+      SET_DISP | 0x01,
+  };
+  write_cmds(cmds, sizeof(cmds));
 }
 
-void OLED::write_cmd(uint8_t cmd) {
-  /* 0x00 writes a command */
-  uint8_t buff[] = {0x00, cmd};
-  i2c.write_blocking(OLED_ADDRESS, buff, 2, false);
-}
+void OLED::write_cmd(uint8_t cmd) { transport->write_cmds(&cmd, 1); }
 
-void OLED::write_data(uint8_t data) {
-  // 0x40 writes data
-  uint8_t buff[] = {0x40, data};
-  i2c.write_blocking(OLED_ADDRESS, buff, 2, false);
+void OLED::write_cmds(const uint8_t *cmds, uint8_t len) {
+  transport->write_cmds(cmds, len);
 }
 
-void OLED::swap(uint8_t *x1, uint8_t *x2) {
-  uint8_t tmp = *x1;
-  *x1 = *x2;
-  *x2 = tmp;
+void OLED::write_data(const uint8_t *data, uint8_t len) {
+  transport->write_data(data, len);
 }
 
 bool OLED::bit_read(uint8_t character, uint8_t index) {
@@ -123,98 +134,167 @@ bool OLED::bit_read(uint8_t character, uint8_t index) {
 void OLED::is_display(bool display) { write_cmd(SET_DISP | display); }
 
 void OLED::set_contrast(uint8_t contrast) {
-  write_cmd(SET_CONTRAST);
-  write_cmd(contrast);
+  uint8_t cmds[] = {SET_CONTRAST, contrast};
+  write_cmds(cmds, sizeof(cmds));
 }
 
 void OLED::is_inverse(bool inverse) { write_cmd(SET_NORM_INV | inverse); }
 
 void OLED::clear_buffer() {
-  for (uint16_t i = 0; i < buff_size; ++i) {
-    buffer[i] = 0x0000;
+  raster_clear(buffer, buff_size);
+  invalidate();
+}
+
+void OLED::invalidate() {
+  for (uint8_t page = 0; page < pages; ++page) {
+    dirty_start[page] = 0;
+    dirty_end[page] = width - 1;
+  }
+}
+
+void OLED::mark_dirty(uint8_t page, uint8_t x_start, uint8_t x_end) {
+  if (dirty_start[page] == OLED_PAGE_CLEAN) {
+    dirty_start[page] = x_start;
+    dirty_end[page] = x_end;
+    return;
   }
+  if (x_start < dirty_start[page]) dirty_start[page] = x_start;
+  if (x_end > dirty_end[page]) dirty_end[page] = x_end;
+}
+
+void OLED::mark_dirty_rect(int16_t x, int16_t y, int16_t width, int16_t height) {
+  int16_t x_end = x + width - 1;
+  int16_t y_end = y + height - 1;
+  if (width <= 0 || height <= 0 || x_end < 0 || y_end < 0) return;
+  if (x >= this->width || y >= this->height) return;
+  if (x < 0) x = 0;
+  if (y < 0) y = 0;
+  if (x_end >= this->width) x_end = this->width - 1;
+  if (y_end >= this->height) y_end = this->height - 1;
+
+  for (uint8_t page = y >> 3; page <= (y_end >> 3); ++page) {
+    mark_dirty(page, x, x_end);
+  }
+}
+
+void OLED::mark_dirty_clipped(int16_t x, int16_t y, int16_t width, int16_t height) {
+  int16_t x_end = x + width;
+  int16_t y_end = y + height;
+  if (x < clip_x0) x = clip_x0;
+  if (y < clip_y0) y = clip_y0;
+  if (x_end > clip_x1) x_end = clip_x1;
+  if (y_end > clip_y1) y_end = clip_y1;
+  mark_dirty_rect(x, y, x_end - x, y_end - y);
 }
 
 void OLED::show() {
-  /* Set col, row, and page address for sending buffer */
-  write_cmd(SET_COL_ADDR);
-  write_cmd(0);
-  write_cmd(width - 1);
-  write_cmd(SET_PAGE_ADDR);
-  write_cmd(0);
-  write_cmd(pages - 1);
-
-  for (uint16_t i = 0; i < buff_size; ++i) {
-    write_data(buffer[i]);
+  wait_flush();
+  for (uint8_t page = 0; page < pages; ++page) {
+    if (dirty_start[page] == OLED_PAGE_CLEAN) continue;
+
+    /* Set col and page address around the changed window only */
+    uint8_t x_start = dirty_start[page];
+    uint8_t x_end = dirty_end[page];
+    uint8_t cmds[] = {SET_COL_ADDR, x_start, x_end, SET_PAGE_ADDR, page, page};
+    write_cmds(cmds, sizeof(cmds));
+
+    /* Stream the window as one data burst */
+    write_data(buffer + page * width + x_start, x_end - x_start + 1);
+    dirty_start[page] = OLED_PAGE_CLEAN;
+  }
+}
+
+bool OLED::present() {
+  if (flushing) {
+    ++stats.dropped;
+    return false;
+  }
+
+  /* Swap: the drawn buffer becomes the front buffer, drawing moves on to a
+   * copy of it so incremental drawing keeps working. */
+  uint8_t back = front;
+  front = (buffer == frames[0] + OLED_FRAME_HEADER) ? 0 : 1;
+  memcpy(frames[back] + OLED_FRAME_HEADER, buffer, buff_size);
+  buffer = frames[back] + OLED_FRAME_HEADER;
+
+  /* the whole frame goes out below, nothing is left to show() */
+  for (uint8_t page = 0; page < pages; ++page) {
+    dirty_start[page] = OLED_PAGE_CLEAN;
   }
+
+  uint8_t cmds[] = {SET_COL_ADDR, 0, (uint8_t)(width - 1), SET_PAGE_ADDR, 0,
+                    (uint8_t)(pages - 1)};
+
+  flushing = true;
+  present_us = time_us_32();
+  ++stats.presented;
+  uint8_t *frame = frames[front] + OLED_FRAME_HEADER;
+  if (!transport->write_frame_async(cmds, sizeof(cmds), frame, buff_size, flush_done,
+                                    this)) {
+    /* transport queue full, resend the frame on the next show() */
+    flushing = false;
+    invalidate();
+    return false;
+  }
+  return true;
+}
+
+bool OLED::has_changes() const {
+  for (uint8_t page = 0; page < pages; ++page) {
+    if (dirty_start[page] != OLED_PAGE_CLEAN) return true;
+  }
+  return false;
+}
+
+void OLED::flush_done(void *ctx) {
+  OLED *oled = static_cast<OLED *>(ctx);
+  uint32_t latency = time_us_32() - oled->present_us;
+  oled->stats.last_latency_us = latency;
+  if (latency > oled->stats.max_latency_us) oled->stats.max_latency_us = latency;
+  oled->flushing = false;
+}
+
+void OLED::wait_flush() {
+  while (flushing) tight_loop_contents();
 }
 
 void OLED::draw_pixel(uint8_t x, uint8_t y) {
   if (x < width && y < height) {
     buffer[x + width * (y / 8)] |= 0x01 << (y % 8);
+    mark_dirty(y / 8, x, x);
   }
 }
 
 void OLED::draw_fast_hline(uint8_t x, uint8_t y, uint8_t width) {
-  for (uint8_t i = 0; i < width; ++i) {
-    draw_pixel(x + i, y);
-  }
+  if (x >= this->width || y >= this->height || width == 0) return;
+  if (width > this->width - x) width = this->width - x;
+  raster_hspan(buffer, this->width, x, y, width);
+  mark_dirty(y >> 3, x, x + width - 1);
 }
 
 void OLED::draw_fast_vline(uint8_t x, uint8_t y, uint8_t height) {
-  for (uint8_t i = 0; i < height; ++i) {
-    draw_pixel(x, y + i);
-  }
+  if (x >= this->width || y >= this->height || height == 0) return;
+  if (height > this->height - y) height = this->height - y;
+  raster_vspan(buffer, this->width, x, y, height);
+  mark_dirty_rect(x, y, 1, height);
 }
 
 void OLED::draw_line(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) {
-  if (x1 > x2) {
-    swap(&x1, &x2);
-    swap(&y1, &y2);
-  }
-  float slope = (float)(y2 - y1) / (float)(x2 - x1);
-  for (uint8_t x = x1; x <= x2; ++x) {
-    float y = slope * (float)(x - x1) + (float)y1;
-    draw_pixel(x, y);
-  }
+  raster_line(buffer, width, height, x1, y1, x2, y2);
+  int16_t x = (x1 < x2) ? x1 : x2;
+  int16_t y = (y1 < y2) ? y1 : y2;
+  mark_dirty_rect(x, y, ((x1 < x2) ? x2 - x1 : x1 - x2) + 1,
+                  ((y1 < y2) ? y2 - y1 : y1 - y2) + 1);
 }
 
 void OLED::draw_circle(int16_t xc, int16_t yc, uint16_t radius) {
-  int16_t x = -radius;
-  int16_t y = 0;
-  int16_t e = 2 - (2 * radius);
-  do {
-    draw_pixel(xc + x, yc - y);
-    draw_pixel(xc - x, yc + y);
-    draw_pixel(xc + y, yc + x);
-    draw_pixel(xc - y, yc - x);
-    int16_t tmp = e;
-    if (tmp <= y) {
-      e += (++y * 2) + 1;
-    }
-    if ((tmp > x) || (e > y)) {
-      e += (++y * 2) + 1;
-    }
-  } while (x < 0);
+  raster_circle(buffer, width, height, xc, yc, radius);
+  mark_dirty_rect(xc - radius, yc - radius, 2 * radius + 1, 2 * radius + 1);
 }
 
 void OLED::draw_filled_circle(int16_t xc, int16_t yc, uint16_t radius) {
-  int16_t x = radius;
-  int16_t y = 0;
-  int16_t e = 1 - x;
-  while (x >= y) {
-    draw_line(xc + x, yc + y, xc - x, yc + y);
-    draw_line(xc + y, yc + x, xc - y, yc + x);
-    draw_line(xc - x, yc - y, xc + x, yc - y);
-    draw_line(xc - y, yc - x, xc + y, yc - x);
-    ++y;
-    if (e >= 0) {
-      --x;
-      e += 2 * ((y - x) + 1);
-    } else {
-      e += (2 * y) + 1;
-    }
-  }
+  raster_filled_circle(buffer, width, height, xc, yc, radius);
+  mark_dirty_rect(xc - radius, yc - radius, 2 * radius + 1, 2 * radius + 1);
 }
 
 void OLED::draw_rectangle(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
@@ -225,37 +305,124 @@ void OLED::draw_rectangle(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
 }
 
 void OLED::draw_filled_rectangle(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
-  for (uint8_t i = 0; i < height; ++i) {
-    draw_fast_hline(x, y + i, width);
-  }
+  if (x >= this->width || y >= this->height) return;
+  if (width > this->width - x) width = this->width - x;
+  if (height > this->height - y) height = this->height - y;
+  raster_fill_rect(buffer, this->width, x, y, width, height);
+  mark_dirty_rect(x, y, width, height);
+}
+
+void OLED::clear_rect(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
+  if (x >= this->width || y >= this->height) return;
+  if (width > this->width - x) width = this->width - x;
+  if (height > this->height - y) height = this->height - y;
+  raster_clear_rect(buffer, this->width, x, y, width, height);
+  mark_dirty_rect(x, y, width, height);
+}
+
+void OLED::set_clip(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
+  clip_x0 = (x < this->width) ? x : this->width;
+  clip_y0 = (y < this->height) ? y : this->height;
+  clip_x1 = (clip_x0 + width < this->width) ? clip_x0 + width : this->width;
+  clip_y1 = (clip_y0 + height < this->height) ? clip_y0 + height : this->height;
+}
+
+void OLED::clear_clip() {
+  clip_x0 = 0;
+  clip_y0 = 0;
+  clip_x1 = width;
+  clip_y1 = height;
 }
 
 void OLED::set_scroll_direction(bool direction) {
-  write_cmd(SET_HOR_SCROLL | direction);
-  write_cmd(0x00);
-  write_cmd(0);
-  write_cmd(0x06);
-  write_cmd(pages - 1);
-  write_cmd(0x00);
-  write_cmd(0xff);
+  uint8_t cmds[] = {(uint8_t)(SET_HOR_SCROLL | direction),
+                    0x00,
+                    0,
+                    0x06,
+                    (uint8_t)(pages - 1),
+                    0x00,
+                    0xff};
+  write_cmds(cmds, sizeof(cmds));
 }
 
 void OLED::is_scroll(bool is_enable) { write_cmd(SET_SCROLL | is_enable); }
 
-void OLED::set_font(const GFXfont *font) { my_font = font; }
+void OLED::set_start_line(uint8_t line) {
+  wait_flush();
+  write_cmd(SET_DISP_START_LINE | (line & (OLED_GDDRAM_ROWS - 1)));
+}
 
-void OLED::print_char(uint8_t x, uint8_t y, uint8_t character) {
-  if (character < my_font->first_char || character > my_font->last_char) return;
+void OLED::scroll_content(bool left, uint8_t start_page, uint8_t end_page,
+                          uint8_t start_col, uint8_t end_col) {
+  wait_flush();
+  uint8_t cmds[] = {left ? SET_CONTENT_SCROLL_LEFT : SET_CONTENT_SCROLL_RIGHT,
+                    0x00,
+                    start_page,
+                    0x01,
+                    end_page,
+                    0x00,
+                    start_col,
+                    end_col};
+  write_cmds(cmds, sizeof(cmds));
+}
 
-  character -= my_font->first_char;
-  GFXglyph *glyph = my_font->glyph + character;
-  uint8_t *bitmap = my_font->bitmap;
+void OLED::set_font(const GFXfont *font) {
+  my_font = font;
+  page_font = nullptr;
+}
+
+void OLED::set_font(const PageFont *font) { page_font = font; }
+
+const GFXglyph *OLED::find_glyph(uint8_t ch) const {
+  if (page_font != nullptr) {
+    if (ch < page_font->first_char || ch > page_font->last_char) return nullptr;
+    return page_font->glyph + (ch - page_font->first_char);
+  }
+  if (ch < my_font->first_char || ch > my_font->last_char) return nullptr;
+  return my_font->glyph + (ch - my_font->first_char);
+}
+
+uint8_t OLED::line_height() const {
+  return (page_font != nullptr) ? page_font->y_advance : my_font->y_advance;
+}
+
+const void *OLED::font_id() const {
+  return (page_font != nullptr) ? (const void *)page_font : (const void *)my_font;
+}
+
+void OLED::print_char(int16_t x, int16_t y, uint8_t character) {
+  const GFXglyph *glyph = find_glyph(character);
+  if (glyph == nullptr) return;
 
   uint16_t bitmap_offset = glyph->bitmap_offset;
   uint8_t width = glyph->width;
   uint8_t height = glyph->height;
   int8_t x_offset = glyph->x_offset;
-  uint8_t y_offset = my_font->y_advance + glyph->y_offset;
+  int16_t y_offset = line_height() + glyph->y_offset;
+
+  /* Nothing to decode if the glyph box misses the clip */
+  int16_t gx = x + x_offset;
+  int16_t gy = y + y_offset;
+  if (gx >= clip_x1 || gy >= clip_y1 || gx + width <= clip_x0 || gy + height <= clip_y0) {
+    return;
+  }
+
+  /* Fastest path: the font is already page-ordered */
+  if (page_font != nullptr) {
+    draw_page_bitmap(x + x_offset, y + y_offset, width, height,
+                     page_font->bitmap + bitmap_offset);
+    return;
+  }
+
+  /* Fast path: blit the pre-rendered glyph */
+  const uint8_t *img = GlyphCache::get_instance()->get(my_font, character);
+  if (img != nullptr) {
+    draw_page_bitmap(x + x_offset, y + y_offset, width, height, img);
+    return;
+  }
+
+  uint8_t *bitmap = my_font->bitmap;
+
   uint8_t bits = 0;
   uint8_t a_bit = 0;
 
@@ -264,8 +431,11 @@ void OLED::print_char(uint8_t x, uint8_t y, uint8_t character) {
       if (!(a_bit++ & 7)) {
         bits = bitmap[bitmap_offset++];
       }
-      if (bits & 0x80) {
-        draw_pixel(x + x_offset + j, y + y_offset + i);
+      int16_t px = gx + j;
+      int16_t py = gy + i;
+      if ((bits & 0x80) && px >= clip_x0 && px < clip_x1 && py >= clip_y0 &&
+          py < clip_y1) {
+        draw_pixel(px, py);
       }
       bits <<= 1;
     }
@@ -278,10 +448,14 @@ void OLED::print(uint8_t x, uint8_t y, uint8_t *str) {
   uint8_t i = 0;
   while (str[i] != '\0') {
     uint8_t character = str[i];
-    GFXglyph *glyph = my_font->glyph + character - my_font->first_char;
+    const GFXglyph *glyph = find_glyph(character);
+    if (glyph == nullptr) {
+      ++i;
+      continue;
+    }
     if (x + glyph->width + glyph->x_offset > width) {
       x = 0;
-      y += my_font->y_advance;
+      y += line_height();
     }
     print_char(x, y, character);
     x += glyph->x_advance;
@@ -291,10 +465,31 @@ void OLED::print(uint8_t x, uint8_t y, uint8_t *str) {
 
 void OLED::draw_bitmap(uint8_t x, uint8_t y, uint8_t width, uint8_t height,
                        const uint8_t *img) {
-  for (uint8_t i = 0; i < height; ++i) {
+  /* Transpose each band of 8 rows into one page row, then blit it */
+  uint8_t row_bytes = (width + 7) / 8;
+  uint8_t column[128];
+  if (width > sizeof(column)) width = sizeof(column);
+
+  for (uint16_t band = 0; band < height; band += 8) {
+    uint8_t rows = (height - band < 8) ? height - band : 8;
     for (uint8_t j = 0; j < width; ++j) {
-      bool value = bit_read(img[i * ((width - 1) / 8 + 1) + j / 8], 7 - j % 8);
-      if (value) draw_pixel(x + j, y + i);
+      column[j] = 0;
+    }
+    for (uint8_t r = 0; r < rows; ++r) {
+      const uint8_t *src = img + (band + r) * row_bytes;
+      for (uint8_t j = 0; j < width; ++j) {
+        column[j] |= ((src[j >> 3] >> (7 - (j & 7))) & 0x01) << r;
+      }
     }
+    raster_blit_clip(buffer, this->width, clip_x0, clip_y0, clip_x1, clip_y1, x, y + band,
+                     width, rows, column);
   }
+  mark_dirty_clipped(x, y, width, height);
+}
+
+void OLED::draw_page_bitmap(int16_t x, int16_t y, uint8_t width, uint8_t height,
+                            const uint8_t *img) {
+  raster_blit_clip(buffer, this->width, clip_x0, clip_y0, clip_x1, clip_y1, x, y, width,
+                   height, img);
+  mark_dirty_clipped(x, y, width, height);
 }
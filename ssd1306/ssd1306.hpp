@@ -19,10 +19,9 @@
 
 #include "../i2c/i2c.hpp"
 #include "bitmap.hpp"
+#include "oled_transport.hpp"
 #include "pico/stdlib.h"
 
-static constexpr uint8_t OLED_ADDRESS = 0x3C;
-
 static constexpr uint8_t SET_CONTRAST = 0x81;
 static constexpr uint8_t SET_ENTIRE_ON = 0xA4;
 static constexpr uint8_t SET_NORM_INV = 0xA6;
@@ -43,6 +42,13 @@ static constexpr uint8_t SET_CHARGE_PUMP = 0x8D;
 static constexpr uint8_t SET_SCROLL = 0x2E;
 static constexpr uint8_t SET_HOR_SCROLL = 0x26;
 static constexpr uint8_t SET_COM_OUT_DIR_REVERSE = 0xC0;
+static constexpr uint8_t SET_CONTENT_SCROLL_RIGHT = 0x2C;  // one column per command
+static constexpr uint8_t SET_CONTENT_SCROLL_LEFT = 0x2D;
+
+static constexpr uint8_t OLED_MAX_PAGES = 8;
+static constexpr uint8_t OLED_GDDRAM_ROWS = 64;  // start line wraps at this
+static constexpr uint16_t OLED_BUFF_SIZE = 1024;  // largest panel, 128x64
+static constexpr uint8_t OLED_PAGE_CLEAN = 0xFF;  // dirty_start of an untouched page
 
 struct GFXglyph {
   uint16_t bitmap_offset;  // Ptr into GFXfont->bitmap
@@ -61,19 +67,98 @@ struct GFXfont {
   uint8_t y_advance;   // distance to Newline
 };
 
+/* Page-native font built by tools/fontconv.py. Glyph metrics match GFXfont,
+ * but each glyph's bitmap is ceil(height / 8) pages of width bytes (LSB at
+ * the top) so it can be ORed into the framebuffer without transposing. */
+struct PageFont {
+  const uint8_t *bitmap;   // page-ordered glyph images, concatenated
+  const GFXglyph *glyph;   // bitmap_offset is a byte offset into bitmap
+  uint8_t first_char;      // ASCII extents
+  uint8_t last_char;       // ASCII extents
+  uint8_t y_advance;       // distance to Newline
+};
+
+struct OLEDFrameStats {
+  uint32_t presented;        // frames handed to the flush engine
+  uint32_t dropped;          // present() calls refused while a flush was in flight
+  uint32_t last_latency_us;  // present() to flush complete, last frame
+  uint32_t max_latency_us;
+};
+
 class OLED {
  public:
   OLED(uint8_t height, uint8_t width, bool reversed);
-  OLED(I2C i2c, uint8_t height, uint8_t width, bool reversed);
+
+  /**
+   * @param i2c must outlive the OLED, panels on one block share it
+   */
+  OLED(I2C *i2c, uint8_t height, uint8_t width, bool reversed);
+
+  /**
+   * @brief Drives the panel through any transport, e.g. SPIOLEDTransport.
+   *
+   * @param transport must outlive the OLED
+   */
+  OLED(OLEDTransport *transport, uint8_t height, uint8_t width, bool reversed);
   ~OLED();
 
+  OLED(OLED const &) = delete;
+  OLED &operator=(OLED const &) = delete;
+
+  /**
+   * @brief Sends the changed part of the buffer to the display. Each page
+   * only streams the column window touched since the last show().
+   */
   void show();
+
+  /**
+   * @brief Marks the whole buffer dirty so the next show() resends it all.
+   */
+  void invalidate();
+
+  /**
+   * @brief Double-buffered flush. Hands the current buffer to the transport's
+   * DMA engine as the front buffer and returns right away. Drawing continues on
+   * the other buffer, which starts as a copy of the presented frame.
+   *
+   * @return false (and counts a dropped frame) if the previous frame is
+   * still on the wire.
+   */
+  bool present();
+
+  /**
+   * @return true while a presented frame is still being sent.
+   */
+  bool is_flushing() const { return flushing; }
+
+  /**
+   * @return true if anything has been drawn since the last show()/present().
+   */
+  bool has_changes() const;
+
+  /**
+   * @return bus the panel is on, see OLEDTransport::get_bus().
+   */
+  uint8_t get_bus() { return transport->get_bus(); }
+
+  /**
+   * @return true while the panel's bus has transfers queued.
+   */
+  bool is_bus_busy() { return transport->is_busy(); }
+
+  const OLEDFrameStats &get_frame_stats() const { return stats; }
+
   void clear_buffer();
   void is_display(bool inverse);
   void is_inverse(bool inverse);
   void set_contrast(uint8_t contrast);
   void set_font(const GFXfont *font);
 
+  /**
+   * @brief Selects a page-native font, the fast path for text.
+   */
+  void set_font(const PageFont *font);
+
   /* Methods for drawing to display */
 
   /**
@@ -125,6 +210,32 @@ class OLED {
    */
   void draw_filled_rectangle(uint8_t x, uint8_t y, uint8_t width, uint8_t height);
 
+  /**
+   * @brief Turns off every pixel in a rectangle.
+   *
+   * @param x starting x position
+   * @param y starting y position
+   * @param width pixels in the x direction
+   * @param height pixels in the y direction
+   */
+  void clear_rect(uint8_t x, uint8_t y, uint8_t width, uint8_t height);
+
+  /**
+   * @brief Limits text and bitmap drawing to a rectangle. Shapes are not
+   * clipped. The rectangle is clamped to the screen.
+   *
+   * @param x starting x position
+   * @param y starting y position
+   * @param width pixels in the x direction
+   * @param height pixels in the y direction
+   */
+  void set_clip(uint8_t x, uint8_t y, uint8_t width, uint8_t height);
+
+  /**
+   * @brief Resets the clip rectangle to the whole screen.
+   */
+  void clear_clip();
+
   /**
    * @brief Draws a circle from xc,yc as its centerpoint.
    *
@@ -152,6 +263,28 @@ class OLED {
 
   void is_scroll(bool enabled);
 
+  /**
+   * @brief Sets which GDDRAM row is shown on the top line of the panel.
+   *
+   * @param line GDDRAM row, 0 - 63
+   */
+  void set_start_line(uint8_t line);
+
+  /**
+   * @brief Shifts a window of GDDRAM by one column without resending it. The
+   * column shifted out wraps round to the other edge. Hardware scrolling
+   * must be off, and the controller needs about two frame periods before the
+   * next scroll step.
+   *
+   * @param left true to move the contents left
+   * @param start_page first page of the window
+   * @param end_page last page of the window
+   * @param start_col first column of the window
+   * @param end_col last column of the window
+   */
+  void scroll_content(bool left, uint8_t start_page, uint8_t end_page, uint8_t start_col,
+                      uint8_t end_col);
+
   /**
    * @brief Displays a single character.
    *
@@ -159,7 +292,7 @@ class OLED {
    * @param y starting y position
    * @param ch hex value of character to print (0 - 255)
    */
-  void print_char(uint8_t x, uint8_t y, uint8_t ch);
+  void print_char(int16_t x, int16_t y, uint8_t ch);
 
   /**
    * @brief Displays a string of characters.
@@ -182,22 +315,97 @@ class OLED {
   void draw_bitmap(uint8_t x, uint8_t y, uint8_t width, uint8_t height,
                    const uint8_t *img);
 
+  /**
+   * @brief Draws a pre-transposed, page-ordered image: ceil(height / 8)
+   * pages of width bytes, LSB at the top. Much faster than draw_bitmap.
+   *
+   * @param x starting x position
+   * @param y starting y position
+   * @param width width of img
+   * @param height height of img
+   * @param img reference to the page-ordered image
+   */
+  void draw_page_bitmap(int16_t x, int16_t y, uint8_t width, uint8_t height,
+                        const uint8_t *img);
+
+  uint8_t get_width() const { return width; }
+  uint8_t get_height() const { return height; }
+
+  /**
+   * @return the page-ordered buffer being drawn to. Changes made directly
+   * must be reported with mark_dirty_rect().
+   */
+  uint8_t *get_buffer() { return buffer; }
+
+  /**
+   * @brief Marks a rectangle as changed so the next show() sends it.
+   */
+  void mark_dirty_rect(int16_t x, int16_t y, int16_t width, int16_t height);
+
+  /**
+   * @return the active font's glyph for ch, or nullptr if it has none.
+   */
+  const GFXglyph *find_glyph(uint8_t ch) const;
+
+  /**
+   * @return the active font's line height in pixels.
+   */
+  uint8_t line_height() const;
+
+  /**
+   * @return an id that changes whenever the active font changes.
+   */
+  const void *font_id() const;
+
+ protected:
+  /**
+   * @brief Used by Panel, which supplies exactly sized frame storage.
+   *
+   * @param owns_transport delete transport with the OLED
+   * @param frame0 OLED_FRAME_HEADER + width * height / 8 bytes, word aligned
+   * @param frame1 same size as frame0, word aligned
+   */
+  OLED(OLEDTransport *transport, bool owns_transport, uint8_t height, uint8_t width,
+       bool reversed, uint8_t *frame0, uint8_t *frame1);
+
  private:
-  I2C i2c;
+  OLEDTransport *transport;
+  bool owns_transport;
   uint8_t width;
   uint8_t height;
   uint8_t pages;
   uint16_t buff_size;
   bool reversed;
-  uint8_t buffer[1024] = {0};  // Ensure the buffer is clear.
+  /* Each frame starts with OLED_FRAME_HEADER bytes for the transport, e.g.
+   * the I2C control byte, so a frame is one contiguous transfer and buffer
+   * itself stays word aligned. */
+  uint8_t *frames[2];
+  bool owns_frames;  // frames were allocated by the constructor
+  uint8_t *buffer;
+  uint8_t front;
+  volatile bool flushing;
+  uint32_t present_us;
+  OLEDFrameStats stats;
+  uint8_t dirty_start[OLED_MAX_PAGES];  // first changed column per page
+  uint8_t dirty_end[OLED_MAX_PAGES];    // last changed column per page
   const GFXfont *my_font;
+  const PageFont *page_font;  // takes precedence over my_font when set
+  int16_t clip_x0;            // clip rectangle, end exclusive
+  int16_t clip_y0;
+  int16_t clip_x1;
+  int16_t clip_y1;
 
   void init(void);
+  void setup(uint8_t *frame0, uint8_t *frame1);
   void write_cmd(uint8_t cmd);
-  void write_data(uint8_t data);
-  void swap(uint8_t *x1, uint8_t *x2);
+  void write_cmds(const uint8_t *cmds, uint8_t len);
+  void write_data(const uint8_t *data, uint8_t len);
   bool bit_read(uint8_t character, uint8_t index);
   void draw_pixel(uint8_t x, uint8_t y);
+  void mark_dirty(uint8_t page, uint8_t x_start, uint8_t x_end);
+  void mark_dirty_clipped(int16_t x, int16_t y, int16_t width, int16_t height);
+  void wait_flush();
+  static void flush_done(void *ctx);
 };
 
 #endif  // end _SSD1306_H
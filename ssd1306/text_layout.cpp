@@ -0,0 +1,111 @@
+/** @file text_layout.cpp
+ *
+ * @brief this module implements the TextLayout text box.
+ *
+ * @author Nathan Winslow
+ */
+
+#include "text_layout.hpp"
+
+TextLayout::TextLayout(OLED *oled, uint8_t x, uint8_t y, uint8_t width, uint8_t height,
+                       TextAlign align)
+    : oled(oled),
+      x(x),
+      y(y),
+      width(width),
+      height(height),
+      align(align),
+      len(0),
+      metrics{0},
+      measured_font(nullptr) {
+  text[0] = '\0';
+}
+
+void TextLayout::set_box(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
+  this->x = x;
+  this->y = y;
+  this->width = width;
+  this->height = height;
+}
+
+bool TextLayout::set_text(const char *str) {
+  if (str == nullptr) str = "";
+
+  uint8_t i = 0;
+  bool changed = false;
+  for (; i < TEXT_LAYOUT_MAX_LEN && str[i] != '\0'; ++i) {
+    if (text[i] != str[i]) {
+      text[i] = str[i];
+      changed = true;
+    }
+  }
+  if (i != len) changed = true;
+  text[i] = '\0';
+  len = i;
+
+  if (changed) measured_font = nullptr;
+  return changed;
+}
+
+const TextMetrics &TextLayout::get_metrics() {
+  if (measured_font != oled->font_id()) {
+    metrics = measure(oled, text, len);
+    measured_font = oled->font_id();
+  }
+  return metrics;
+}
+
+TextMetrics TextLayout::measure(const OLED *oled, const char *str, uint8_t len) {
+  TextMetrics m = {0, 0, 0, oled->line_height()};
+  bool inked = false;
+
+  for (uint8_t i = 0; i < len; ++i) {
+    const GFXglyph *glyph = oled->find_glyph(str[i]);
+    if (glyph == nullptr) continue;
+
+    if (glyph->width != 0) {
+      int16_t left = m.advance + glyph->x_offset;
+      int16_t right = left + glyph->width;
+      if (!inked || left < m.ink_left) m.ink_left = left;
+      if (!inked || right > m.ink_right) m.ink_right = right;
+      inked = true;
+    }
+    m.advance += glyph->x_advance;
+  }
+  return m;
+}
+
+void TextLayout::draw(bool clear) {
+  const TextMetrics &m = get_metrics();
+
+  if (clear) oled->clear_rect(x, y, width, height);
+
+  /* Align by ink so right and centred text sits flush with the box */
+  int16_t pen = x;
+  if (align == ALIGN_RIGHT) {
+    pen = x + width - m.ink_right;
+  } else if (align == ALIGN_CENTER) {
+    pen = x + (width - (m.ink_right - m.ink_left)) / 2 - m.ink_left;
+  }
+
+  oled->set_clip(x, y, width, height);
+  int16_t clip_end = x + width;
+  for (uint8_t i = 0; i < len; ++i) {
+    const GFXglyph *glyph = oled->find_glyph(text[i]);
+    if (glyph == nullptr) continue;
+
+    int16_t left = pen + glyph->x_offset;
+    if (left >= clip_end) break;  // the rest of the line is past the box
+    if (left + glyph->width > x) oled->print_char(pen, y, text[i]);
+    pen += glyph->x_advance;
+  }
+  oled->clear_clip();
+}
+
+bool TextLayout::update(const char *str) {
+  if (!set_text(str)) return false;
+  draw();
+  return true;
+}
+
+/* END OF FILE */
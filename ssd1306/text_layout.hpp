@@ -0,0 +1,104 @@
+/** @file text_layout.hpp
+ *
+ * @brief Single-line text box with cached measurement, alignment and clipping.
+ *
+ * @par
+ * OLED::print lays text out as it draws, so it cannot align a string or keep
+ * it inside a box. TextLayout measures its string once, in one pass over the
+ * glyph table, and only measures again when the text or the active font
+ * changes. draw() clears just its own box and renders through the OLED clip
+ * rectangle, so a right-aligned value can be redrawn in place without
+ * touching the rest of the screen.
+ *
+ * @author Nathan Winslow
+ */
+
+#ifndef _TEXT_LAYOUT_H
+#define _TEXT_LAYOUT_H
+
+#include "ssd1306.hpp"
+
+static constexpr uint8_t TEXT_LAYOUT_MAX_LEN = 32;  // longer strings are truncated
+
+enum TextAlign : uint8_t {
+  ALIGN_LEFT,
+  ALIGN_CENTER,
+  ALIGN_RIGHT,
+};
+
+struct TextMetrics {
+  int16_t advance;    // pen travel over the whole string
+  int16_t ink_left;   // first lit column, relative to the pen start
+  int16_t ink_right;  // one past the last lit column, relative to the pen start
+  uint8_t height;     // line height of the font
+};
+
+class TextLayout {
+ public:
+  /**
+   * @param oled display to draw on
+   * @param x left edge of the box
+   * @param y top edge of the box
+   * @param width box width in pixels
+   * @param height box height in pixels
+   * @param align horizontal alignment inside the box
+   */
+  TextLayout(OLED *oled, uint8_t x, uint8_t y, uint8_t width, uint8_t height,
+             TextAlign align = ALIGN_LEFT);
+
+  void set_box(uint8_t x, uint8_t y, uint8_t width, uint8_t height);
+  void set_align(TextAlign align) { this->align = align; }
+
+  /**
+   * @brief Copies str into the layout.
+   *
+   * @return true if the text differs from what was there before
+   */
+  bool set_text(const char *str);
+
+  const char *get_text() const { return text; }
+
+  /**
+   * @return the cached measurement, refreshed if the font has changed
+   */
+  const TextMetrics &get_metrics();
+
+  /**
+   * @brief Clears the box and renders the text into it. Glyphs entirely
+   * outside the box are skipped. Resets the OLED clip when done.
+   *
+   * @param clear false if the caller has already cleared the box
+   */
+  void draw(bool clear = true);
+
+  /**
+   * @brief set_text followed by draw, only if the text changed.
+   *
+   * @return true if the box was redrawn
+   */
+  bool update(const char *str);
+
+  /**
+   * @brief Measures a string in the OLED's active font.
+   *
+   * @param oled display whose font is used
+   * @param str string to measure
+   * @param len number of characters to measure
+   */
+  static TextMetrics measure(const OLED *oled, const char *str, uint8_t len);
+
+ private:
+  OLED *oled;
+  uint8_t x;
+  uint8_t y;
+  uint8_t width;
+  uint8_t height;
+  TextAlign align;
+  char text[TEXT_LAYOUT_MAX_LEN + 1];
+  uint8_t len;
+  TextMetrics metrics;
+  const void *measured_font;  // font metrics was taken with, nullptr if stale
+};
+
+#endif  // end _TEXT_LAYOUT_H
+/* END OF FILE */
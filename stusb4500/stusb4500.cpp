@@ -1,8 +1,15 @@
 #include "stusb4500.hpp"
 
-STUSB4500::STUSB4500() : i2c(I2C()) { init_pins(); }
+#include "../i2c/i2c_batch.hpp"
+#include "stusb4500_profile.hpp"
+
+STUSB4500::STUSB4500() : i2c(I2C()), regs(&i2c) {
+  init_pins();
+  init_alerts();
+}
 
 STUSB4500 *STUSB4500::inst = nullptr;
+STUSB4500 *STUSB4500::alert_owner = nullptr;
 
 STUSB4500::~STUSB4500() {
   gpio_deinit(STUSB4500_INTERRUPT_PIN);
@@ -15,15 +22,92 @@ void STUSB4500::init_pins() {
   gpio_set_dir(STUSB4500_RESET_PIN, GPIO_OUT);
   gpio_put(STUSB4500_RESET_PIN, 0);
 
+  /* ALERT is open drain, active low */
   gpio_init(STUSB4500_INTERRUPT_PIN);
-  gpio_set_dir(STUSB4500_INTERRUPT_PIN, GPIO_OUT);
-  gpio_put(STUSB4500_INTERRUPT_PIN, 1);
-  gpio_set_irq_enabled(STUSB4500_INTERRUPT_PIN, GPIO_IRQ_EDGE_FALL, true);
+  gpio_set_dir(STUSB4500_INTERRUPT_PIN, GPIO_IN);
+  gpio_pull_up(STUSB4500_INTERRUPT_PIN);
+}
+
+/*
+ * ALERT stays low until the latched status registers are read. The pin IRQ
+ * is level triggered and masks itself, then a DMA burst read of
+ * ALERT_STATUS_1 .. PRT_STATUS clears the alert and the completion callback
+ * decodes it and unmasks the pin. No alert is lost while the pin is masked.
+ */
+void STUSB4500::init_alerts() {
+  if (STUSB4500_INTERRUPT_PIN == PIN_UNUSED) return;
+  uint8_t unmasked = ALERT_PRT_STATUS::MASK | ALERT_CC_HW_FAULT::MASK |
+                     ALERT_TYPEC_MONITORING::MASK | ALERT_CC_DETECTION::MASK;
+  uint8_t mask = ~unmasked;
+  write_byte_to_reg(ALERT_STATUS_1_MASK, mask);
+
+  /* clear anything latched before we were listening */
+  i2c.read_bytes(STUSB4500_ADDRESS, ALERT_STATUS_1, alert_burst,
+                 STUSB4500_ALERT_BURST_LEN);
+  decode_alert(alert_burst, true);
+
+  alert_owner = this;
+  gpio_add_raw_irq_handler(STUSB4500_INTERRUPT_PIN, alert_isr);
+  gpio_set_irq_enabled(STUSB4500_INTERRUPT_PIN, GPIO_IRQ_LEVEL_LOW, true);
+  irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+void STUSB4500::alert_isr() {
+  if (!(gpio_get_irq_event_mask(STUSB4500_INTERRUPT_PIN) & GPIO_IRQ_LEVEL_LOW)) return;
+  gpio_set_irq_enabled(STUSB4500_INTERRUPT_PIN, GPIO_IRQ_LEVEL_LOW, false);
+  alert_owner->start_alert_read();
+}
+
+/* While a blocking call holds the bus the read waits in the I2C queue */
+void STUSB4500::start_alert_read() {
+  if (!i2c.read_async(&alert_xfer, STUSB4500_ADDRESS, &alert_reg, alert_burst,
+                      STUSB4500_ALERT_BURST_LEN, alert_done, this)) {
+    /* queue full, the still-low pin retries */
+    gpio_set_irq_enabled(STUSB4500_INTERRUPT_PIN, GPIO_IRQ_LEVEL_LOW, true);
+  }
+}
+
+void STUSB4500::alert_done(I2CTransfer *xfer, void *ctx) {
+  STUSB4500 *self = static_cast<STUSB4500 *>(ctx);
+  if (xfer->result >= 0) self->decode_alert(self->alert_burst, false);
+  gpio_set_irq_enabled(STUSB4500_INTERRUPT_PIN, GPIO_IRQ_LEVEL_LOW, true);
+}
+
+/* status holds ALERT_STATUS_1 .. PRT_STATUS */
+void STUSB4500::decode_alert(const uint8_t *status, bool initial) {
+  STUSB4500_EVENT event;
+  event.time_ms = to_ms_since_boot(get_absolute_time());
+  event.port_status = status[PORT_STATUS_1 - ALERT_STATUS_1];
+  event.monitoring = status[TYPEC_MONITORING_STATUS_0 - ALERT_STATUS_1];
+  event.fault = status[CC_HW_FAULT_STATUS_1 - ALERT_STATUS_1];
+  event.prt_status = status[PRT_STATUS - ALERT_STATUS_1];
+  uint8_t port_trans = status[PORT_STATUS_0 - ALERT_STATUS_1];
+  bool attached = PORT_CC_ATTACH_STATE::get(event.port_status);
+
+  if (PORT_CC_DETECTION_TRANS::get(port_trans) || (initial && attached)) {
+    event.type = attached ? STUSB4500_ATTACH : STUSB4500_DETACH;
+    events.push(event);
+  }
+  if (!attached) return;
+
+  if (MONITORING_VBUS_LOW::get(event.monitoring) ||
+      MONITORING_VBUS_HIGH::get(event.monitoring) ||
+      CC_HW_VPU_OVP_FAULT::get(event.fault) ||
+      PRT_HW_RESET_RECEIVED::get(event.prt_status)) {
+    event.type = STUSB4500_FAULT;
+    events.push(event);
+  }
+  if (PRT_MSG_RECEIVED::get(event.prt_status)) {
+    event.type = STUSB4500_CONTRACT;
+    events.push(event);
+  }
 }
 
 void STUSB4500::soft_reset() {
-  write_byte_to_reg(TX_HEADER_LOW, SOFT_RESET);
-  write_byte_to_reg(PD_COMMAND_CTRL, SEND_CMD);
+  I2CBatch batch(&i2c, STUSB4500_ADDRESS);
+  batch.write(TX_HEADER_LOW, SOFT_RESET);
+  batch.write(PD_COMMAND_CTRL, SEND_CMD);
+  batch.run();
 }
 
 void STUSB4500::write_byte_to_reg(uint8_t addr, uint8_t value) {
@@ -31,368 +115,374 @@ void STUSB4500::write_byte_to_reg(uint8_t addr, uint8_t value) {
   i2c.write_blocking(STUSB4500_ADDRESS, &buffer[0], sizeof(buffer), false);
 }
 
-void STUSB4500::write_to_reg(uint8_t addr, uint8_t *data) {
-  // TODO: likely a better way of doing this
-  uint8_t buff[sizeof(data) + 1];
-  buff[0] = addr;
-  for (int i = 0; i < sizeof(data); ++i) {
-    buff[i + 1] = data[i];
+/* the register pointer auto-increments, each chunk starts where the last ended */
+bool STUSB4500::read_from_reg(uint8_t addr, uint8_t num_of_bytes, uint8_t *rbuf) {
+  I2C::BusLock lock(&i2c);
+  while (num_of_bytes > 0) {
+    uint8_t len = num_of_bytes;
+    if (len > STUSB4500_READ_CHUNK) len = STUSB4500_READ_CHUNK;
+    if (i2c.write_blocking(STUSB4500_ADDRESS, &addr, 1, true) != 1 ||
+        i2c.read_blocking(STUSB4500_ADDRESS, rbuf, len, false) != len) {
+      puts("Error Reading from i2c");
+      return false;
+    }
+    addr += len;
+    rbuf += len;
+    num_of_bytes -= len;
   }
-  i2c.write_blocking(STUSB4500_ADDRESS, buff, sizeof(buff), false);
-}
-
-void STUSB4500::read_from_reg(uint8_t addr, uint8_t num_of_bytes, uint8_t *rbuf) {
-  if (num_of_bytes > 8) num_of_bytes = 8;
-  i2c.write_blocking(STUSB4500_ADDRESS, &addr, 1, false);
-  int bytes_read = i2c.read_blocking(STUSB4500_ADDRESS, rbuf, num_of_bytes, false);
-  if (bytes_read != num_of_bytes) puts("Error Reading from i2c");
+  return true;
 }
 
-void STUSB4500::exit_test_mode() {
-  write_byte_to_reg(FTP_CTRL_0, FTP_CUST_RST_N);
-  write_byte_to_reg(FTP_CUST_PASSWORD_REG, 0);
-}
-
-void STUSB4500::wait_exec() {
-  bool done = false;
-  while (!done) {
-    uint8_t *data = new uint8_t[1]();
-    read_from_reg(FTP_CUST_REQ, 1, data);
-    if (data[0] & FTP_CUST_REQ)
-      continue;
-    else
-      done = true;
+const STUSB4500_SNAPSHOT &STUSB4500::snapshot() {
+  uint8_t status[STUSB4500_STATUS_LEN];
+  uint8_t rx[STUSB4500_RX_LEN];
+  I2CBatch batch(&i2c, STUSB4500_ADDRESS);
+  batch.read(ALERT_STATUS_1, status, STUSB4500_STATUS_LEN);
+  batch.read(RX_HEADER_LOW, rx, STUSB4500_RX_LEN);
+  if (batch.run() < 0) return snap;
+
+  snap.time_ms = to_ms_since_boot(get_absolute_time());
+  memcpy(snap.status, status, STUSB4500_STATUS_LEN);
+  snap.attached = PORT_CC_ATTACH_STATE::get(snap.get(PORT_STATUS_1));
+  uint16_t header = rx[0] | (rx[1] << 8);
+  snap.rx_msg_type = RX_HEADER_MSG_TYPE::get(header);
+  snap.num_rx_obj = RX_HEADER_NUM_DATA_OBJ::get(header);
+  for (uint8_t i = 0; i < STUSB4500_RX_OBJ_MAX; ++i) {
+    const uint8_t *obj = &rx[2 + i * BYTES_PER_PDO];
+    snap.rx_obj[i] = obj[0] | (obj[1] << 8) | (obj[2] << 16) | ((uint32_t)obj[3] << 24);
   }
+
+  /* reading the block cleared its latched transitions, don't lose them. The
+   * alert IRQ is the other producer of the event ring. */
+  uint32_t save = save_and_disable_interrupts();
+  decode_alert(status, false);
+  restore_interrupts(save);
+  return snap;
 }
 
-void STUSB4500::enter_write_mode(uint8_t esector) {
-  write_byte_to_reg(FTP_CUST_PASSWORD_REG, FTP_CUST_PASSWORD);
-  write_byte_to_reg(RW_BUFFER, 0);
-  write_byte_to_reg(FTP_CTRL_0, 0);
-  write_byte_to_reg(FTP_CTRL_0, FTP_CUST_PWR | FTP_CUST_RST_N);
-  uint8_t val = ((esector << 3) & FTP_CUST_SER) | WRITE_SER & FTP_CUST_OPCODE;
-  write_byte_to_reg(FTP_CTRL_1, val);
-  write_byte_to_reg(FTP_CTRL_0, FTP_CUST_PWR | FTP_CUST_RST_N | FTP_CUST_REQ);
-  wait_exec();
+uint8_t STUSB4500::get_source_pdo_count() const {
+  if (!snap.attached || snap.rx_msg_type != PD_MSG_SOURCE_CAPABILITIES) return 0;
+  return snap.num_rx_obj;
+}
 
-  write_byte_to_reg(FTP_CTRL_1, SOFT_PROG_SECTOR & FTP_CUST_OPCODE);
-  write_byte_to_reg(FTP_CTRL_0, FTP_CUST_PWR | FTP_CUST_RST_N | FTP_CUST_REQ);
-  wait_exec();
+Millivolts STUSB4500::get_source_voltage(uint8_t index) const {
+  if (index >= get_source_pdo_count()) return 0_mV;
+  return Millivolts(SNK_PDO_VOLTAGE::read(snap.rx_obj[index]));
+}
 
-  write_byte_to_reg(FTP_CTRL_1, ERASE_SECTOR & FTP_CUST_OPCODE);
-  write_byte_to_reg(FTP_CTRL_0, FTP_CUST_PWR | FTP_CUST_RST_N | FTP_CUST_REQ);
-  wait_exec();
+Milliamps STUSB4500::get_source_current(uint8_t index) const {
+  if (index >= get_source_pdo_count()) return 0_mA;
+  return Milliamps(SNK_PDO_CURRENT::read(snap.rx_obj[index]));
 }
 
-void STUSB4500::write_sector(uint8_t sector_num, uint8_t *data) {
-  write_to_reg(RW_BUFFER, data);
-  write_byte_to_reg(FTP_CTRL_0, FTP_CUST_PWR | FTP_CUST_RST_N);
-  write_byte_to_reg(FTP_CTRL_1, WRITE_PL & FTP_CUST_OPCODE);
-  write_byte_to_reg(FTP_CTRL_0, FTP_CUST_PWR | FTP_CUST_RST_N | FTP_CUST_REQ);
-  wait_exec();
+void STUSB4500::exit_test_mode() {
+  I2CBatch batch(&i2c, STUSB4500_ADDRESS);
+  batch.write(FTP_CTRL_0, FTP_CUST_RST_N);
+  batch.write(FTP_CUST_PASSWORD_REG, 0);
+  batch.run();
+}
+
+/*
+ * Polls FTP_CTRL_0 until the controller clears the request bit. The gap
+ * between reads doubles up to STUSB4500_NVM_POLL_MAX_US, so a slow erase
+ * costs a handful of reads instead of thousands.
+ */
+bool STUSB4500::wait_exec() {
+  uint64_t deadline = time_us_64() + STUSB4500_NVM_TIMEOUT_US;
+  uint32_t backoff = STUSB4500_NVM_POLL_MIN_US;
+  uint8_t ctrl;
+  while (true) {
+    ++nvm_stats.polls;
+    if (read_from_reg(FTP_CTRL_0, 1, &ctrl) && !(ctrl & FTP_CUST_REQ)) return true;
+    if (time_us_64() > deadline) return false;
+    sleep_us(backoff);
+    backoff *= 2;
+    if (backoff > STUSB4500_NVM_POLL_MAX_US) backoff = STUSB4500_NVM_POLL_MAX_US;
+  }
+}
 
-  write_byte_to_reg(FTP_CTRL_1, PROG_SECTOR & FTP_CUST_OPCODE);
+/* esector is a mask of SECTOR_0 .. SECTOR_4, only those are erased */
+bool STUSB4500::enter_write_mode(uint8_t esector) {
+  I2CBatch batch(&i2c, STUSB4500_ADDRESS);
+  batch.write(FTP_CUST_PASSWORD_REG, FTP_CUST_PASSWORD);
+  batch.write(RW_BUFFER, 0);
+  batch.write(FTP_CTRL_0, 0);
+  batch.write(FTP_CTRL_0, FTP_CUST_PWR | FTP_CUST_RST_N);
+  uint8_t val = ((esector << 3) & FTP_CUST_SER) | (WRITE_SER & FTP_CUST_OPCODE);
+  batch.write(FTP_CTRL_1, val);
+  batch.write(FTP_CTRL_0, FTP_CUST_PWR | FTP_CUST_RST_N | FTP_CUST_REQ);
+  batch.run();
+  if (!wait_exec()) return false;
+
+  batch.write(FTP_CTRL_1, SOFT_PROG_SECTOR & FTP_CUST_OPCODE);
+  batch.write(FTP_CTRL_0, FTP_CUST_PWR | FTP_CUST_RST_N | FTP_CUST_REQ);
+  batch.run();
+  if (!wait_exec()) return false;
+
+  batch.write(FTP_CTRL_1, ERASE_SECTOR & FTP_CUST_OPCODE);
+  batch.write(FTP_CTRL_0, FTP_CUST_PWR | FTP_CUST_RST_N | FTP_CUST_REQ);
+  batch.run();
+  return wait_exec();
+}
+
+bool STUSB4500::write_sector(uint8_t sector_num, const uint8_t *data) {
+  I2CBatch batch(&i2c, STUSB4500_ADDRESS);
+  batch.write(RW_BUFFER, data, SIZE_OF_SECTOR);
+  batch.write(FTP_CTRL_0, FTP_CUST_PWR | FTP_CUST_RST_N);
+  batch.write(FTP_CTRL_1, WRITE_PL & FTP_CUST_OPCODE);
+  batch.write(FTP_CTRL_0, FTP_CUST_PWR | FTP_CUST_RST_N | FTP_CUST_REQ);
+  batch.run();
+  if (!wait_exec()) return false;
+
+  batch.write(FTP_CTRL_1, PROG_SECTOR & FTP_CUST_OPCODE);
   uint8_t value =
       ((sector_num & FTP_CUST_SECT) | FTP_CUST_PWR | FTP_CUST_RST_N | FTP_CUST_REQ);
-  write_byte_to_reg(FTP_CTRL_0, value);
-  wait_exec();
+  batch.write(FTP_CTRL_0, value);
+  batch.run();
+  return wait_exec();
+}
+
+/* enters test mode and reads every sector, the caller exits test mode */
+bool STUSB4500::read_sectors(uint8_t dst[NUM_OF_SECTORS][SIZE_OF_SECTOR]) {
+  I2CBatch batch(&i2c, STUSB4500_ADDRESS);
+  batch.write(FTP_CUST_PASSWORD_REG, FTP_CUST_PASSWORD);
+  batch.write(FTP_CTRL_0, 0x00);  // NVM reset
+  batch.write(FTP_CTRL_0, FTP_CUST_PWR | FTP_CUST_RST_N);
+  batch.run();
+  for (int i = 0; i < NUM_OF_SECTORS; ++i) {
+    batch.write(FTP_CTRL_0, FTP_CUST_PWR | FTP_CUST_RST_N);  // may not be needed
+    batch.write(FTP_CTRL_1, READ & FTP_CUST_OPCODE);
+    batch.write(FTP_CTRL_0,
+                (i & FTP_CUST_SECT) | FTP_CUST_PWR | FTP_CUST_RST_N | FTP_CUST_REQ);
+    batch.run();
+    if (!wait_exec()) return false;
+    if (!read_from_reg(RW_BUFFER, SIZE_OF_SECTOR, dst[i])) return false;
+  }
+  return true;
 }
 
-void STUSB4500::set_pdo_num(PDO_NUM pdo_num) { write_byte_to_reg(DPM_PDO_NUMB, pdo_num); }
+/*
+ * Reads the NVM back, erases and programs only the sectors that differ from
+ * image, then reads everything again to verify.
+ */
+bool STUSB4500::program(const uint8_t image[NUM_OF_SECTORS][SIZE_OF_SECTOR]) {
+  uint64_t start = time_us_64();
+  uint8_t current[NUM_OF_SECTORS][SIZE_OF_SECTOR];
+  nvm_stats = {};
+
+  /* if the read back fails, assume every sector is stale */
+  bool ok = read_sectors(current);
+  uint8_t changed = 0;
+  for (int i = 0; i < NUM_OF_SECTORS; ++i) {
+    if (!ok || memcmp(current[i], image[i], SIZE_OF_SECTOR)) changed |= 1 << i;
+  }
+
+  if (changed) {
+    nvm_stats.erased = changed;
+    ok = enter_write_mode(changed);
+    for (int i = 0; ok && i < NUM_OF_SECTORS; ++i) {
+      if (!(changed & (1 << i))) continue;
+      ok = write_sector(i, image[i]);
+      ++nvm_stats.programmed;
+    }
+    ok = ok && read_sectors(current);
+    for (int i = 0; ok && i < NUM_OF_SECTORS; ++i) {
+      ok = !memcmp(current[i], image[i], SIZE_OF_SECTOR);
+    }
+  }
+  exit_test_mode();
 
+  nvm_stats.verified = ok;
+  nvm_stats.time_us = time_us_64() - start;
+  return ok;
+}
+
+void STUSB4500::set_pdo_num(PDO_NUM pdo_num) {
+  reg_apply(regs, RegUpdate<DPM_PDO_NUMB_REG>().set<DPM_PDO_NUMB_FIELD>(pdo_num));
+}
+
+/* unchanged PDOs are not rewritten */
 void STUSB4500::write_pdo(PDO_NUM pdo_num, uint8_t *data) {
   if (pdo_num < PDO_1 || pdo_num > PDO_3) return;
-  uint8_t addr_mask = 0x85;
-  write_to_reg(addr_mask + ((pdo_num - 1) * 4), data);
+  regs.write(DPM_SNK_PDO1_0 + ((pdo_num - 1) * BYTES_PER_PDO), data);
 }
 
+/* served from RAM after the first read of each PDO */
 void STUSB4500::load_pdo(PDO_NUM pdo_num) {
-  uint8_t addr_mask = 0x85;
-  uint8_t address = addr_mask + ((pdo_num - 1) * BYTES_PER_PDO);
-  uint8_t *buff = new uint8_t[BYTES_PER_PDO]();
-  read_from_reg(address, BYTES_PER_PDO, buff);
-  for (int i = 0; i < BYTES_PER_PDO; ++i) {
-    pdo_data.arr[i] = buff[i];
-  }
+  uint8_t address = DPM_SNK_PDO1_0 + ((pdo_num - 1) * BYTES_PER_PDO);
+  if (regs.read(address, pdo_data.arr) < 0) pdo_data.value = 0;
 }
 
-bool STUSB4500::set_voltage(PDO_NUM pdo_num, float volts) {
-  if (5.0 < volts > 20.0) return false;
-  if (pdo_num == PDO_1) volts = 5;
-  volts *= 20;
-  uint16_t val = (uint16_t)volts;
+bool STUSB4500::set_voltage(PDO_NUM pdo_num, Millivolts volts) {
+  if (volts < 5000_mV || volts > 20000_mV) return false;
+  if (pdo_num == PDO_1) volts = 5000_mV;
   load_pdo(pdo_num);
-  pdo_data.value &= ~0xffc00;
-  pdo_data.value |= val << 10;
+  pdo_data.value = SNK_PDO_VOLTAGE::write(pdo_data.value, volts.value());
   write_pdo(pdo_num, pdo_data.arr);
   return true;
 }
 
-bool STUSB4500::set_current(PDO_NUM pdo_num, float i) {
-  if (0.01 < i > 5.0) return false;
-  uint16_t mask = 0x03ff;
-  i *= 100;
-  uint16_t value = (uint16_t)i & mask;
+bool STUSB4500::set_current(PDO_NUM pdo_num, Milliamps i) {
+  if (i < 10_mA || i > 5000_mA) return false;
   load_pdo(pdo_num);
-  pdo_data.value &= ~mask;
-  pdo_data.value |= value;
+  pdo_data.value = SNK_PDO_CURRENT::write(pdo_data.value, i.value());
   write_pdo(pdo_num, pdo_data.arr);
   return true;
 }
 
-bool STUSB4500::set_lower_volt_limit(PDO_NUM pdo_num, float value) {
-  if (5.0 < value > 20.0) return false;
-  value -= 5.0;
-  /* save the bits, not the type */
-  unsigned char *c = reinterpret_cast<unsigned char *>(&value);
-  if (pdo_num == PDO_2) {
-    sector[3][4] &= 0x0f;
-    sector[3][4] |= *c << 4;
-  } else if (pdo_num == PDO_3) {
-    sector[3][6] &= 0xf0;
-    sector[3][6] |= *c << 4;
-  }
+bool STUSB4500::set_lower_volt_limit(PDO_NUM pdo_num, uint8_t percent) {
+  if (!NVM_PDO2_LOWER_LIMIT::in_range(percent)) return false;
+  if (pdo_num == PDO_2)
+    NVM_PDO2_LOWER_LIMIT::write_image(nvm(), percent);
+  else if (pdo_num == PDO_3)
+    NVM_PDO3_LOWER_LIMIT::write_image(nvm(), percent);
   return true;
 }
 
-bool STUSB4500::set_upper_volt_limit(PDO_NUM pdo_num, float value) {
-  if (5.0 < value > 21.0) return false;
-
-  value -= 5.0;
-  /* save the bits, not the type */
-  unsigned char *c = reinterpret_cast<unsigned char *>(&value);
-  if (pdo_num == PDO_1) {
-    sector[3][3] &= 0x0f;
-    sector[3][3] |= *c << 4;
-  } else if (pdo_num == PDO_2) {
-    sector[3][5] &= 0xf0;
-    sector[3][5] |= *c << 4;
-  } else {
-    sector[3][6] &= 0x0f;
-    sector[3][6] |= *c << 4;
-  }
+bool STUSB4500::set_upper_volt_limit(PDO_NUM pdo_num, uint8_t percent) {
+  if (!NVM_PDO1_UPPER_LIMIT::in_range(percent)) return false;
+  if (pdo_num == PDO_1)
+    NVM_PDO1_UPPER_LIMIT::write_image(nvm(), percent);
+  else if (pdo_num == PDO_2)
+    NVM_PDO2_UPPER_LIMIT::write_image(nvm(), percent);
+  else
+    NVM_PDO3_UPPER_LIMIT::write_image(nvm(), percent);
   return true;
 }
 
-bool STUSB4500::set_flex_current(float value) {
-  if (0.0 < value > 5.0) return false;
-  value *= 100;
-  unsigned char *c = reinterpret_cast<unsigned char *>(&value);
-  sector[4][3] &= 0x03;
-  sector[4][3] |= (*c & 0x3f) << 2;
-  sector[4][4] &= 0xf0;
-  sector[4][4] |= (*c & 0x03c0) >> 6;
+bool STUSB4500::set_flex_current(Milliamps value) {
+  if (value < 0_mA || value > 5000_mA) return false;
+  NVM_FLEX_CURRENT::write_image(nvm(), value.value());
   return true;
 }
 
-void STUSB4500::set_ext_power(bool enable) {
-  sector[3][2] &= 0xf7;
-  sector[3][2] |= enable << 3;
-}
+void STUSB4500::set_ext_power(bool enable) { NVM_EXT_POWER::write_image(nvm(), enable); }
 
 void STUSB4500::set_usb_comms_capable(bool enable) {
-  sector[3][2] &= 0xfe;
-  sector[3][2] |= enable;
+  NVM_USB_COMM_CAPABLE::write_image(nvm(), enable);
 }
 
 bool STUSB4500::set_POWER_OK_config(uint8_t config_code) {
-  if (2 < config_code > 3) return false;
-  sector[4][4] &= 0x9f;
-  sector[4][4] |= config_code << 5;
+  if (config_code == 1 || config_code > 3) return false;
+  NVM_POWER_OK_CFG::write_image(nvm(), config_code);
   return true;
 }
 
 bool STUSB4500::set_gpio_ctrl(uint8_t ctrl_code) {
-  if (0 < ctrl_code > 3) return false;
-  sector[1][0] &= 0xcf;
-  sector[1][0] |= ctrl_code << 4;
+  if (ctrl_code > 3) return false;
+  NVM_GPIO_CTRL::write_image(nvm(), ctrl_code);
   return true;
 }
 
 void STUSB4500::set_power_over_5v_only(bool enable) {
-  sector[4][6] &= 0xf7;
-  sector[4][6] |= enable << 4;
+  NVM_POWER_ONLY_ABOVE_5V::write_image(nvm(), enable);
 }
 
 void STUSB4500::set_request_source_current(bool enable) {
-  sector[4][6] &= 0xef;
-  sector[4][6] |= enable >> 4;
+  NVM_REQ_SRC_CURRENT::write_image(nvm(), enable);
 }
 
-float STUSB4500::get_voltage(PDO_NUM pdo_num) {
-  uint16_t mask = 0x3ff;
+Millivolts STUSB4500::get_voltage(PDO_NUM pdo_num) {
   load_pdo(pdo_num);
-  float voltage = ((pdo_data.value >> 10) & mask) / 20.0;
-  return voltage;
+  return Millivolts(SNK_PDO_VOLTAGE::read(pdo_data.value));
 }
 
-float STUSB4500::get_current(PDO_NUM pdo_num) {
-  uint16_t mask = 0x3ff;
+Milliamps STUSB4500::get_current(PDO_NUM pdo_num) {
   load_pdo(pdo_num);
-  pdo_data.value &= mask;
-  return (float)pdo_data.value * 0.01;
+  return Milliamps(SNK_PDO_CURRENT::read(pdo_data.value));
 }
 
-float STUSB4500::get_low_volt_limit(PDO_NUM pdo_num) {
-  float result;
+uint8_t STUSB4500::get_low_volt_limit(PDO_NUM pdo_num) {
+  int32_t result;
   if (pdo_num == PDO_2)
-    result = (sector[3][4] >> 4) + 5.0;
+    result = NVM_PDO2_LOWER_LIMIT::read_image(nvm());
   else if (pdo_num == PDO_3)
-    result = (sector[3][6] & 0x0f) + 5.0;
+    result = NVM_PDO3_LOWER_LIMIT::read_image(nvm());
   else
-    result = 0.0;
+    result = 0;
   return result;
 }
 
-float STUSB4500::get_upper_volt_limit(PDO_NUM pdo_num) {
-  float result;
+uint8_t STUSB4500::get_upper_volt_limit(PDO_NUM pdo_num) {
+  int32_t result;
   if (pdo_num == PDO_1)
-    result = (sector[3][3] >> 4) + 5.0;
+    result = NVM_PDO1_UPPER_LIMIT::read_image(nvm());
   else if (pdo_num == PDO_2)
-    result = (sector[3][5] & 0x0f) + 5.0;
+    result = NVM_PDO2_UPPER_LIMIT::read_image(nvm());
   else
-    result = (sector[3][6] >> 4) + 5.0;
+    result = NVM_PDO3_UPPER_LIMIT::read_image(nvm());
   return result;
 }
 
-float STUSB4500::get_flex_current() {
-  return (((sector[4][4] & 0x0f) << 6) + (sector[4][3] & 0xfc) >> 2) / 100.0;
+Milliamps STUSB4500::get_flex_current() {
+  return Milliamps(NVM_FLEX_CURRENT::read_image(nvm()));
 }
 
 uint8_t STUSB4500::get_pdo_num() {
-  uint8_t *reg = new uint8_t[1]();
-  read_from_reg(DPM_PDO_NUMB, 1, reg);
-  return reg[0] & 0x07;
+  int32_t num = 0;
+  reg_read<DPM_PDO_NUMB_FIELD>(regs, &num);
+  return num;
 }
 
-uint8_t STUSB4500::get_POWER_OK_config() { return (sector[4][4] & 0x60) >> 5; }
+uint8_t STUSB4500::get_POWER_OK_config() { return NVM_POWER_OK_CFG::read_image(nvm()); }
 
-uint8_t STUSB4500::get_GPIO_ctrl() { return (sector[1][0] & 0x30) >> 4; }
+uint8_t STUSB4500::get_GPIO_ctrl() { return NVM_GPIO_CTRL::read_image(nvm()); }
 
-float STUSB4500::get_requested_source_current() {  // FIXME!
-  return (sector[4][6] & 0x10) >> 4;
+bool STUSB4500::get_requested_source_current() {
+  return NVM_REQ_SRC_CURRENT::read_image(nvm());
 }
 
-bool STUSB4500::is_ext_power() { return (sector[3][2] & 0x08) >> 3; }
-
-bool STUSB4500::is_usb_comm_capable() { return sector[3][2] & 0x01; }
+bool STUSB4500::is_ext_power() { return NVM_EXT_POWER::read_image(nvm()); }
 
-bool STUSB4500::is_power_over_5v_only() { return (sector[4][6] & 0x80) >> 3; }
+bool STUSB4500::is_usb_comm_capable() { return NVM_USB_COMM_CAPABLE::read_image(nvm()); }
 
-void STUSB4500::reset_sector() {
-  for (int i; i < NUM_OF_SECTORS; ++i) {
-    for (int j; j < SIZE_OF_SECTOR; ++j) {
-      sector[i][j] = 0x00;
-    }
-  }
+bool STUSB4500::is_power_over_5v_only() {
+  return NVM_POWER_ONLY_ABOVE_5V::read_image(nvm());
 }
 
+void STUSB4500::reset_sector() { memset(sector, 0, sizeof(sector)); }
+
 void STUSB4500::read() {
-  write_byte_to_reg(FTP_CUST_PASSWORD_REG, FTP_CUST_PASSWORD);
-  write_byte_to_reg(FTP_CTRL_0, 0x00);  // NVM reset
-  write_byte_to_reg(FTP_CTRL_0, FTP_CUST_PWR | FTP_CUST_RST_N);
   reset_sector();
-  for (int i = 0; i < NUM_OF_SECTORS; ++i) {
-    write_byte_to_reg(FTP_CTRL_0,
-                      FTP_CUST_PWR | FTP_CUST_RST_N);  // may not be needed
-    write_byte_to_reg(FTP_CTRL_1, READ & FTP_CUST_OPCODE);
-    write_byte_to_reg(FTP_CTRL_0,
-                      FTP_CUST_SECT | FTP_CUST_PWR | FTP_CUST_RST_N | FTP_CUST_REQ);
-    uint8_t *rbuf = new uint8_t[1]();
-    while (*rbuf & FTP_CUST_REQ != 0) {
-      read_from_reg(FTP_CTRL_0, 1, rbuf);
-      tight_loop_contents();
-    }
-    delete rbuf;
-    uint8_t *rwbuf = new uint8_t[SIZE_OF_SECTOR]();
-    read_from_reg(RW_BUFFER, SIZE_OF_SECTOR, rwbuf);
-
-    // TODO: Check this logic, we may want to change the first element
-    for (int i = 0; i < NUM_OF_SECTORS; ++i) {
-      if ((sector[i] == 0) && (i > 0)) {
-        for (int j = 0; j < 8; ++j) {
-          sector[i][j] = rwbuf[j];
-        }
-        break;
-      }
-    }
-  }
+  read_sectors(sector);
   exit_test_mode();
 }
 
-void STUSB4500::write(bool default_mode) {
-  if (default_mode) {
-    uint8_t def_sector_1[SIZE_OF_SECTOR] = {0x00, 0x00, 0xb0, 0xaa,
-                                            0x00, 0x45, 0x00, 0x00};
-    uint8_t def_sector_2[SIZE_OF_SECTOR] = {0x10, 0x40, 0x9C, 0x1C,
-                                            0xFF, 0x01, 0x3C, 0xDF};
-    uint8_t def_sector_3[SIZE_OF_SECTOR] = {0x02, 0x40, 0x0F, 0x00,
-                                            0x32, 0x00, 0xFC, 0xF1};
-    uint8_t def_sector_4[SIZE_OF_SECTOR] = {0x00, 0x19, 0x56, 0xAF,
-                                            0xF5, 0x35, 0x5F, 0x00};
-    uint8_t def_sector_5[SIZE_OF_SECTOR] = {0x00, 0x4B, 0x90, 0x21,
-                                            0x43, 0x00, 0x40, 0xFB};
-    uint8_t *def_sectors[NUM_OF_SECTORS] = {def_sector_1, def_sector_2, def_sector_3,
-                                            def_sector_4, def_sector_5};
-    enter_write_mode(SECTOR_0 | SECTOR_1 | SECTOR_2 | SECTOR_3 | SECTOR_4);
-    for (int i = 0; i < NUM_OF_SECTORS; ++i) {
-      write_sector(i, def_sectors[i]);
-    }
-  } else {
-    uint8_t nvmi[3] = {0, 0, 0};  // just to be explicit
-    float volts[3] = {0.0, 0.0, 0.0};
-
-    for (int i = 0; i < 3; ++i) {
-      load_pdo(PDO_NUM(i + 1));
-      float ival = (pdo_data.value & 0x3ff) * 0.01;
-      if (ival > 5.0) ival = 5.0;
-      if (ival < 0.5)
-        nvmi[i] = 0;
-      else if (ival <= 3.0)
-        nvmi[i] = (uint8_t)(ival * 4.0) - 1;
-      else {
-        nvmi[i] = (uint8_t)(ival * 2.0) + 5;
-        uint32_t digv = (pdo_data.value >> 10) & 0x3ff;
-        float voltage = digv / 20.0;
-        if (voltage < 5.0) {
-          voltage = 5.0;
-        } else if (voltage > 20.0) {
-          voltage = 20.0;
-        }
-        volts[i] = voltage;
-        sector[3][2] &= 0x0f;
-        sector[3][2] |= nvmi[0] << 4;
-
-        sector[3][4] &= 0xf0;
-        sector[3][4] |= nvmi[1];
-
-        sector[3][5] &= 0x0f;
-        sector[3][5] |= nvmi[2] << 4;
-
-        // PDO 1: Fixed at 5V .5A
-
-        // PDO 2:
-        digv = volts[1] * 20;
-        sector[4][0] &= 0x3f;
-        sector[4][0] |= (digv & 0x03) << 6;
-        sector[4][1] = digv >> 2;
-
-        // PDO 3:
-        digv = volts[2] * 20;
-        sector[4][2] = digv & 0xff;
-        sector[4][3] &= 0xfc;
-        sector[4][3] |= digv >> 8;
-
-        uint8_t *data = new uint8_t[1]();
-        read_from_reg(DPM_PDO_NUMB, 1, data);
-        sector[3][2] &= 0xf9;
-        sector[3][2] |= data[0] << 1;
-        enter_write_mode(SECTOR_0 | SECTOR_1 | SECTOR_2 | SECTOR_3 | SECTOR_4);
-        for (int i = 0; i < NUM_OF_SECTORS; ++i) {
-          write_sector(i, sector[i]);
-        }
-      }
+bool STUSB4500::write_image(const STUSB4500_NVM_IMAGE &image) {
+  memcpy(sector, image.bytes, sizeof(sector));
+  return program(sector);
+}
+
+bool STUSB4500::write(bool default_mode) {
+  if (default_mode) return write_image(STUSB4500_NVM_DEFAULT);
+
+  uint8_t nvmi[3] = {0, 0, 0};  // just to be explicit
+  Millivolts volts[3];
+
+  for (int i = 0; i < 3; ++i) {
+    load_pdo(PDO_NUM(i + 1));
+    nvmi[i] = stusb4500_current_code(Milliamps(SNK_PDO_CURRENT::read(pdo_data.value)));
+
+    Millivolts voltage(SNK_PDO_VOLTAGE::read(pdo_data.value));
+    if (voltage < 5000_mV) {
+      voltage = 5000_mV;
+    } else if (voltage > 20000_mV) {
+      voltage = 20000_mV;
     }
+    volts[i] = voltage;
   }
-  exit_test_mode();
+  NVM_I_SNK_PDO1::write_image(nvm(), nvmi[0]);
+  NVM_I_SNK_PDO2::write_image(nvm(), nvmi[1]);
+  NVM_I_SNK_PDO3::write_image(nvm(), nvmi[2]);
+
+  // PDO 1: Fixed at 5V .5A
+
+  // PDO 2:
+  NVM_V_SNK_PDO2::write_image(nvm(), volts[1].value());
+
+  // PDO 3:
+  NVM_V_SNK_PDO3::write_image(nvm(), volts[2].value());
+
+  NVM_SNK_PDO_NUMB::write_image(nvm(), get_pdo_num());
+  return program(sector);
 }
@@ -10,6 +10,9 @@
 #define _STUSB4500_H
 
 #include "../i2c/i2c.hpp"
+#include "../i2c/reg_cache.hpp"
+#include "../utils/spsc_ring.hpp"
+#include "../utils/units.hpp"
 #include "stusb4xxx_register_map.hpp"
 
 static const uint STUSB4500_RESET_PIN = PIN_UNUSED;
@@ -19,6 +22,22 @@ static const uint8_t NUM_OF_SECTORS = 5;
 static const uint8_t SIZE_OF_SECTOR = 8;
 static const uint8_t BYTES_PER_PDO = 4;
 
+/* ALERT engine */
+static const uint8_t STUSB4500_EVENT_QUEUE_LEN = 16;  // power of two
+static const uint8_t STUSB4500_ALERT_BURST_LEN = PRT_STATUS - ALERT_STATUS_1 + 1;
+
+/* NVM programming */
+static const uint32_t STUSB4500_NVM_TIMEOUT_US = 500000;  // per FTP operation
+static const uint32_t STUSB4500_NVM_POLL_MIN_US = 20;
+static const uint32_t STUSB4500_NVM_POLL_MAX_US = 2000;
+
+/* Snapshot */
+static const uint8_t STUSB4500_STATUS_LEN = PHY_STATUS - ALERT_STATUS_1 + 1;
+static const uint8_t STUSB4500_RX_LEN = RX_DATA_OBJ7_3 - RX_HEADER_LOW + 1;
+static const uint8_t STUSB4500_RX_OBJ_MAX = 7;
+static const uint8_t STUSB4500_READ_CHUNK = 32;  // bytes per read transfer
+static const uint8_t PD_MSG_SOURCE_CAPABILITIES = 0x01;
+
 /* Op-Codes */
 static const uint8_t READ = 0x00;
 static const uint8_t WRITE_PL = 0x01;
@@ -46,6 +65,18 @@ static const uint8_t RW_BUFFER = 0x53;
 static const uint8_t SOFT_RESET = 0x0D;
 static const uint8_t SEND_CMD = 0x26;
 
+/* Registers shadowed in RAM, everything else goes straight to the bus */
+struct STUSB4500_REGS {
+  static constexpr uint8_t ADDRESS = STUSB4500_ADDRESS;
+  static constexpr bool BYTE_COUNT = false;
+  static constexpr RegDesc REGS[] = {
+      DPM_PDO_NUMB_REG::desc(false),
+      DPM_SNK_PDO1::desc(false),
+      DPM_SNK_PDO2::desc(false),
+      DPM_SNK_PDO3::desc(false),
+  };
+};
+
 #define HARD_RESET_USB_SINK            \
   do {                                 \
     gpio_put(STUSB4500_RESET_PIN, 1);  \
@@ -54,6 +85,60 @@ static const uint8_t SEND_CMD = 0x26;
     gpio_put(STUSB4500_RESET_PIN, 0);  \
   } while (0)
 
+enum STUSB4500_EVENT_TYPE {
+  STUSB4500_ATTACH,
+  STUSB4500_DETACH,
+  STUSB4500_CONTRACT,  // a PD message arrived while attached, e.g. PS_RDY
+  STUSB4500_FAULT,     // VBUS out of range, VPU overvoltage or hard reset
+};
+
+struct STUSB4500_EVENT {
+  STUSB4500_EVENT_TYPE type;
+  uint32_t time_ms;     // since boot
+  uint8_t port_status;  // PORT_STATUS_1
+  uint8_t monitoring;   // TYPEC_MONITORING_STATUS_0
+  uint8_t fault;        // CC_HW_FAULT_STATUS_1
+  uint8_t prt_status;   // PRT_STATUS
+};
+
+/**
+ * @brief The status block and the last received PD message, read in one
+ * START ... STOP.
+ */
+struct STUSB4500_SNAPSHOT {
+  uint32_t time_ms;                       // since boot, 0 before the first read
+  uint8_t status[STUSB4500_STATUS_LEN];   // ALERT_STATUS_1 .. PHY_STATUS
+  bool attached;
+  uint8_t rx_msg_type;                    // RX_HEADER message type
+  uint8_t num_rx_obj;                     // data objects in the last message
+  uint32_t rx_obj[STUSB4500_RX_OBJ_MAX];  // RX_DATA_OBJx, little-endian words
+
+  /* raw status register, reg in ALERT_STATUS_1 .. PHY_STATUS */
+  uint8_t get(uint8_t reg) const { return status[reg - ALERT_STATUS_1]; }
+};
+
+/* The five NVM sectors back to back, as programmed by write_image() */
+struct STUSB4500_NVM_IMAGE {
+  uint8_t bytes[NUM_OF_SECTORS * SIZE_OF_SECTOR];  // indexed by nvm_byte()
+};
+
+static constexpr STUSB4500_NVM_IMAGE STUSB4500_NVM_DEFAULT = {{
+    0x00, 0x00, 0xb0, 0xaa, 0x00, 0x45, 0x00, 0x00,  // sector 0
+    0x10, 0x40, 0x9C, 0x1C, 0xFF, 0x01, 0x3C, 0xDF,  // sector 1
+    0x02, 0x40, 0x0F, 0x00, 0x32, 0x00, 0xFC, 0xF1,  // sector 2
+    0x00, 0x19, 0x56, 0xAF, 0xF5, 0x35, 0x5F, 0x00,  // sector 3
+    0x00, 0x4B, 0x90, 0x21, 0x43, 0x00, 0x40, 0xFB,  // sector 4
+}};
+
+/* Outcome of the last STUSB4500::write() */
+struct STUSB4500_NVM_STATS {
+  uint8_t erased;      // SECTOR_x mask, 0 if the NVM already matched
+  uint8_t programmed;  // sectors written
+  uint32_t polls;      // FTP_CTRL_0 reads while waiting
+  uint32_t time_us;
+  bool verified;
+};
+
 enum PDO_NUM {
   PDO_1 = 1,
   PDO_2,
@@ -67,18 +152,35 @@ class STUSB4500 {
   register32_t pdo_data;
   uint8_t sector[NUM_OF_SECTORS][SIZE_OF_SECTOR];
   I2C i2c;
+  RegCache<STUSB4500_REGS> regs;
+
+  /* ALERT engine, see init_alerts() */
+  static STUSB4500 *alert_owner;
+  SPSCRing<STUSB4500_EVENT, STUSB4500_EVENT_QUEUE_LEN> events;
+  I2CTransfer alert_xfer;
+  uint8_t alert_reg = ALERT_STATUS_1;
+  uint8_t alert_burst[STUSB4500_ALERT_BURST_LEN];
+  STUSB4500_SNAPSHOT snap = {};
+  STUSB4500_NVM_STATS nvm_stats = {};
 
   /* Private Methods */
   void init_pins();
+  void init_alerts();
+  void start_alert_read();
+  void decode_alert(const uint8_t *status, bool initial);
+  static void alert_isr();
+  static void alert_done(I2CTransfer *xfer, void *ctx);
   void write_byte_to_reg(uint8_t addr, uint8_t value);
-  void write_to_reg(uint8_t addr, uint8_t *data);
-  void read_from_reg(uint8_t addr, uint8_t num_of_bytes, uint8_t *rbuf);
-  void enter_write_mode(uint8_t esector);
-  void write_sector(uint8_t sector_num, uint8_t *data);
+  bool read_from_reg(uint8_t addr, uint8_t num_of_bytes, uint8_t *rbuf);
+  uint8_t *nvm() { return &sector[0][0]; }  // image for the NVM_ fields
+  bool enter_write_mode(uint8_t esector);
+  bool write_sector(uint8_t sector_num, const uint8_t *data);
+  bool read_sectors(uint8_t dst[NUM_OF_SECTORS][SIZE_OF_SECTOR]);
+  bool program(const uint8_t image[NUM_OF_SECTORS][SIZE_OF_SECTOR]);
   void read();
   void reset_sector();
   void exit_test_mode(void);
-  void wait_exec(void);
+  bool wait_exec(void);
 
  public:
   static STUSB4500 *inst;
@@ -95,12 +197,59 @@ class STUSB4500 {
 
   STUSB4500(STUSB4500 const &) = delete;
   STUSB4500 &operator=(STUSB4500 const &) = delete;
+  /**
+   * \brief Takes the next attach, detach, contract or fault event. Events
+   * are decoded from the ALERT line in the background, nothing needs to
+   * poll the device.
+   *
+   * \return false if no event is queued
+   */
+  bool pop_event(STUSB4500_EVENT *event) { return events.pop(event); }
+  uint8_t pending_events() const { return events.size(); }
+
+  /**
+   * \return events lost because the queue was full.
+   */
+  uint32_t get_dropped_events() const { return events.get_dropped(); }
+
+  /**
+   * \brief Reads ALERT_STATUS_1 .. PHY_STATUS and the RX header and data
+   * objects in one batched transfer. Alerts latched in the status block are
+   * queued as events, as if the ALERT line had fired.
+   *
+   * \return the refreshed snapshot, or the previous one if the bus failed
+   */
+  const STUSB4500_SNAPSHOT &snapshot();
+
+  /* Served from the last snapshot(), no bus traffic */
+  const STUSB4500_SNAPSHOT &get_snapshot() const { return snap; }
+  bool is_attached() const { return snap.attached; }
+  uint8_t get_source_pdo_count() const;
+  Millivolts get_source_voltage(uint8_t index) const;
+  Milliamps get_source_current(uint8_t index) const;
+
   /**
    * \brief performs a soft reset to renegotiate a PD contract
    * with the source.
    */
   void soft_reset();
-  void write(bool def);
+  /**
+   * \brief Programs the NVM with the factory defaults (def) or with the
+   * current PDO settings. Only sectors that differ from what the NVM holds
+   * are erased and written, and the result is read back.
+   *
+   * \return true if the NVM verified
+   */
+  bool write(bool def);
+
+  /**
+   * \brief Programs a prebuilt image, usually STUSB4500_NVM<PROFILE>::image
+   * from stusb4500_profile.hpp. Same diff and verify as write().
+   *
+   * \return true if the NVM verified
+   */
+  bool write_image(const STUSB4500_NVM_IMAGE &image);
+  const STUSB4500_NVM_STATS &get_nvm_stats() const { return nvm_stats; }
   void write_pdo(PDO_NUM pdo_num, uint8_t *data);
 
   /**
@@ -108,12 +257,32 @@ class STUSB4500 {
    */
   void load_pdo(PDO_NUM pdo_num);
 
+  /**
+   * \brief Drops the RAM copy of the PDO registers. Call after a hard
+   * reset, which reloads them from NVM.
+   */
+  void invalidate_cache() { regs.invalidate(); }
+
+  /**
+   * \brief Re-reads the shadowed registers from the device.
+   *
+   * \return number of registers read, or PICO_ERROR_GENERIC
+   */
+  int sync_cache() {
+    return regs.sync();
+  }
+
+  /**
+   * \return bus transactions avoided by the register cache.
+   */
+  uint32_t get_saved_transactions() const { return regs.get_saved(); }
+
   /* Getters */
-  float get_voltage(PDO_NUM pdo_num);
-  float get_current(PDO_NUM pdo_num);
-  float get_low_volt_limit(PDO_NUM pdo_num);
-  float get_upper_volt_limit(PDO_NUM pdo_num);
-  float get_flex_current();
+  Millivolts get_voltage(PDO_NUM pdo_num);
+  Milliamps get_current(PDO_NUM pdo_num);
+  uint8_t get_low_volt_limit(PDO_NUM pdo_num);    // percent, 0 for PDO1
+  uint8_t get_upper_volt_limit(PDO_NUM pdo_num);  // percent
+  Milliamps get_flex_current();
   uint8_t get_pdo_num();
 
   /**
@@ -151,7 +320,7 @@ class STUSB4500 {
    * \return control code
    */
   uint8_t get_GPIO_ctrl();
-  float get_requested_source_current();
+  bool get_requested_source_current();
 
   /**
    * \brief Sets the pdo to desired number.
@@ -162,12 +331,12 @@ class STUSB4500 {
 
   /**
    * \brief Sets the voltage of pdo number to
-   * value. Note: pdo 1 cannot be changed from
+   * value, 5V .. 20V. Note: pdo 1 cannot be changed from
    * 5V
    *
    * \return True if set, false otherwise
    */
-  bool set_voltage(PDO_NUM pdo_num, float value);
+  bool set_voltage(PDO_NUM pdo_num, Millivolts value);
 
   /**
    * \brief Set the current of pdo number to
@@ -176,10 +345,17 @@ class STUSB4500 {
    *
    * \return True if set, false otherwise
    */
-  bool set_current(PDO_NUM pdo_num, float i);
-  bool set_lower_volt_limit(PDO_NUM pdo_num, float value);
-  bool set_upper_volt_limit(PDO_NUM pdo_num, float value);
-  bool set_flex_current(float value);
+  bool set_current(PDO_NUM pdo_num, Milliamps i);
+
+  /**
+   * \brief VBUS monitoring margins in percent of the PDO voltage,
+   * 5 .. 20. PDO1 has no lower limit.
+   *
+   * \return True if set, false otherwise
+   */
+  bool set_lower_volt_limit(PDO_NUM pdo_num, uint8_t percent);
+  bool set_upper_volt_limit(PDO_NUM pdo_num, uint8_t percent);
+  bool set_flex_current(Milliamps value);
   void set_ext_power(bool enable);
   void set_usb_comms_capable(bool enable);
   bool set_POWER_OK_config(uint8_t config_code);
@@ -0,0 +1,220 @@
+/** @file stusb4500_profile.hpp
+ *
+ * @brief Compile-time STUSB4500 power profiles.
+ *
+ * @par
+ * A STUSB4500_PROFILE describes the sink PDOs, their VBUS monitoring limits,
+ * the GPIO and POWER_OK configuration and the power path flags. It is
+ * compiled into the 40-byte NVM image by the compiler, starting from the
+ * factory image so bits the profile does not describe keep their defaults.
+ * STUSB4500_NVM<PROFILE> rejects values the NVM cannot hold with a
+ * static_assert instead of rounding them:
+ *
+ * @code
+ * static constexpr STUSB4500_PROFILE BOARD = STUSB4500_PROFILE()
+ *     .set_pdo(PDO_2, 9000_mV, 3000_mA)
+ *     .set_pdo(PDO_3, 12000_mV, 2000_mA);
+ *
+ * STUSB4500::get_instance()->write_image(STUSB4500_NVM<BOARD>::image);
+ * @endcode
+ *
+ * The device loads the new image on its next power cycle or hard reset.
+ */
+
+#ifndef _STUSB4500_PROFILE_H
+#define _STUSB4500_PROFILE_H
+
+#include "stusb4500.hpp"
+
+/**
+ * @brief NVM current code of a sink PDO. 0 selects the flex current,
+ * 1 .. 11 are 500mA .. 3A in 250mA steps and 12 .. 15 are 3.5A .. 5A in
+ * 500mA steps. Currents between steps round down.
+ */
+constexpr uint8_t stusb4500_current_code(Milliamps current) {
+  int32_t ma = current.value();
+  if (ma > 5000) ma = 5000;
+  if (ma < 500) return 0;
+  if (ma <= 3000) return ma / 250 - 1;
+  return ma / 500 + 5;
+}
+
+/* true if current has an exact NVM code */
+constexpr bool stusb4500_current_valid(Milliamps current) {
+  int32_t ma = current.value();
+  if (ma == 0) return true;
+  if (ma < 500 || ma > 5000) return false;
+  return ma <= 3000 ? ma % 250 == 0 : ma % 500 == 0;
+}
+
+struct STUSB4500_PDO_CFG {
+  Millivolts voltage;  // 5V .. 20V in 50mV steps, PDO1 is fixed at 5V
+  Milliamps current;   // see stusb4500_current_code(), 0 uses the flex current
+  uint8_t lower_pct;  // VBUS undervoltage margin, 5 .. 20, unused for PDO1
+  uint8_t upper_pct;  // VBUS overvoltage margin, 5 .. 20
+};
+
+struct STUSB4500_PROFILE {
+  /* factory defaults */
+  uint8_t num_pdo = 3;
+  STUSB4500_PDO_CFG pdo[3] = {
+      {5000_mV, 1500_mA, 20, 15},
+      {15000_mV, 1500_mA, 20, 10},
+      {20000_mV, 1000_mA, 20, 10},
+  };
+  Milliamps flex_current = 2000_mA;  // 0 .. 5A in 10mA steps
+  uint8_t gpio_ctrl = 1;     // see STUSB4500::get_GPIO_ctrl()
+  uint8_t power_ok_cfg = 2;  // see STUSB4500::get_POWER_OK_config()
+  bool ext_power = false;
+  bool usb_comm_capable = false;
+  bool power_only_above_5v = false;
+  bool req_src_current = false;
+
+  constexpr STUSB4500_PROFILE &set_pdo_num(uint8_t num) {
+    num_pdo = num;
+    return *this;
+  }
+
+  constexpr STUSB4500_PROFILE &set_pdo(PDO_NUM num, Millivolts voltage,
+                                       Milliamps current) {
+    pdo[num - 1].voltage = voltage;
+    pdo[num - 1].current = current;
+    return *this;
+  }
+
+  constexpr STUSB4500_PROFILE &set_limits(PDO_NUM num, uint8_t lower_pct,
+                                          uint8_t upper_pct) {
+    pdo[num - 1].lower_pct = lower_pct;
+    pdo[num - 1].upper_pct = upper_pct;
+    return *this;
+  }
+
+  constexpr STUSB4500_PROFILE &set_flex_current(Milliamps current) {
+    flex_current = current;
+    return *this;
+  }
+
+  constexpr STUSB4500_PROFILE &set_gpio_ctrl(uint8_t code) {
+    gpio_ctrl = code;
+    return *this;
+  }
+
+  constexpr STUSB4500_PROFILE &set_POWER_OK_config(uint8_t code) {
+    power_ok_cfg = code;
+    return *this;
+  }
+
+  constexpr STUSB4500_PROFILE &set_ext_power(bool enable) {
+    ext_power = enable;
+    return *this;
+  }
+
+  constexpr STUSB4500_PROFILE &set_usb_comms_capable(bool enable) {
+    usb_comm_capable = enable;
+    return *this;
+  }
+
+  constexpr STUSB4500_PROFILE &set_power_over_5v_only(bool enable) {
+    power_only_above_5v = enable;
+    return *this;
+  }
+
+  constexpr STUSB4500_PROFILE &set_request_source_current(bool enable) {
+    req_src_current = enable;
+    return *this;
+  }
+};
+
+constexpr bool stusb4500_voltages_valid(const STUSB4500_PROFILE &p) {
+  for (int i = 1; i < 3; ++i) {
+    Millivolts v = p.pdo[i].voltage;
+    if (v < 5000_mV || v > 20000_mV || !PD_FIXED_VOLTAGE::exact(v)) return false;
+  }
+  return true;
+}
+
+constexpr bool stusb4500_currents_valid(const STUSB4500_PROFILE &p) {
+  for (int i = 0; i < 3; ++i) {
+    if (!stusb4500_current_valid(p.pdo[i].current)) return false;
+  }
+  return true;
+}
+
+constexpr bool stusb4500_limits_valid(const STUSB4500_PROFILE &p) {
+  for (int i = 0; i < 3; ++i) {
+    if (p.pdo[i].upper_pct < 5 || p.pdo[i].upper_pct > 20) return false;
+    if (i && (p.pdo[i].lower_pct < 5 || p.pdo[i].lower_pct > 20)) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Packs a profile into an NVM image. Values are clamped to the field
+ * ranges, STUSB4500_NVM<> checks them first.
+ */
+constexpr STUSB4500_NVM_IMAGE stusb4500_compile(const STUSB4500_PROFILE &p) {
+  STUSB4500_NVM_IMAGE image = STUSB4500_NVM_DEFAULT;
+  uint8_t *nvm = image.bytes;
+
+  NVM_SNK_PDO_NUMB::write_image(nvm, p.num_pdo);
+  NVM_I_SNK_PDO1::write_image(nvm, stusb4500_current_code(p.pdo[0].current));
+  NVM_I_SNK_PDO2::write_image(nvm, stusb4500_current_code(p.pdo[1].current));
+  NVM_I_SNK_PDO3::write_image(nvm, stusb4500_current_code(p.pdo[2].current));
+  NVM_V_SNK_PDO2::write_image(nvm, p.pdo[1].voltage.value());
+  NVM_V_SNK_PDO3::write_image(nvm, p.pdo[2].voltage.value());
+
+  NVM_PDO1_UPPER_LIMIT::write_image(nvm, p.pdo[0].upper_pct);
+  NVM_PDO2_LOWER_LIMIT::write_image(nvm, p.pdo[1].lower_pct);
+  NVM_PDO2_UPPER_LIMIT::write_image(nvm, p.pdo[1].upper_pct);
+  NVM_PDO3_LOWER_LIMIT::write_image(nvm, p.pdo[2].lower_pct);
+  NVM_PDO3_UPPER_LIMIT::write_image(nvm, p.pdo[2].upper_pct);
+
+  NVM_FLEX_CURRENT::write_image(nvm, p.flex_current.value());
+  NVM_GPIO_CTRL::write_image(nvm, p.gpio_ctrl);
+  NVM_POWER_OK_CFG::write_image(nvm, p.power_ok_cfg);
+  NVM_EXT_POWER::write_image(nvm, p.ext_power);
+  NVM_USB_COMM_CAPABLE::write_image(nvm, p.usb_comm_capable);
+  NVM_POWER_ONLY_ABOVE_5V::write_image(nvm, p.power_only_above_5v);
+  NVM_REQ_SRC_CURRENT::write_image(nvm, p.req_src_current);
+  return image;
+}
+
+constexpr bool stusb4500_image_equal(const STUSB4500_NVM_IMAGE &a,
+                                     const STUSB4500_NVM_IMAGE &b) {
+  for (size_t i = 0; i < sizeof(a.bytes); ++i) {
+    if (a.bytes[i] != b.bytes[i]) return false;
+  }
+  return true;
+}
+
+static_assert(stusb4500_image_equal(stusb4500_compile(STUSB4500_PROFILE()),
+                                    STUSB4500_NVM_DEFAULT),
+              "default profile does not match the factory NVM image");
+
+/**
+ * @brief The NVM image of PROFILE, computed at build time. PROFILE must be a
+ * constexpr object with static storage.
+ */
+template <const STUSB4500_PROFILE &PROFILE>
+struct STUSB4500_NVM {
+  static_assert(PROFILE.num_pdo >= 1 && PROFILE.num_pdo <= 3, "1 to 3 sink PDOs");
+  static_assert(PROFILE.pdo[0].voltage == 5000_mV, "PDO1 is fixed at 5V");
+  static_assert(stusb4500_voltages_valid(PROFILE),
+                "PDO2/PDO3 voltage must be 5V .. 20V in 50mV steps");
+  static_assert(stusb4500_currents_valid(PROFILE),
+                "PDO current must be 0 (flex), 0.5A .. 3A in 250mA steps or "
+                "3.5A .. 5A in 500mA steps");
+  static_assert(stusb4500_limits_valid(PROFILE), "VBUS limits must be 5% .. 20%");
+  static_assert(PROFILE.flex_current >= 0_mA && PROFILE.flex_current <= 5000_mA &&
+                    PD_FIXED_CURRENT::exact(PROFILE.flex_current),
+                "flex current must be 0 .. 5A in 10mA steps");
+  static_assert(PROFILE.gpio_ctrl <= 3, "GPIO control code is 0 .. 3");
+  static_assert(PROFILE.power_ok_cfg != 1 && PROFILE.power_ok_cfg <= 3,
+                "POWER_OK configuration is 0, 2 or 3");
+
+  static constexpr STUSB4500_NVM_IMAGE image = stusb4500_compile(PROFILE);
+};
+
+#endif  // END _STUSB4500_PROFILE_H
+
+/* END OF FILE */
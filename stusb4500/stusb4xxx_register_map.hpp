@@ -12,6 +12,8 @@
 #pragma once
 #include <stdint.h>
 
+#include "../i2c/reg_field.hpp"
+
 /* Register Map */
 static const uint8_t BCD_TYPEC_REV_LOW = 0x06;
 static const uint8_t BCD_TYPEC_REV_HIGH = 0x07;
@@ -143,3 +145,80 @@ static const uint8_t DPM_REQ_RDO3_0 = 0x91;
 static const uint8_t DPM_REQ_RDO3_1 = 0x92;
 static const uint8_t DPM_REQ_RDO3_2 = 0x93;
 static const uint8_t DPM_REQ_RDO3_3 = 0x94;
+
+/* Typed registers and fields */
+
+typedef Register<DPM_PDO_NUMB, 1> DPM_PDO_NUMB_REG;
+typedef RegField<DPM_PDO_NUMB_REG, BitField<0, 3>> DPM_PDO_NUMB_FIELD;
+
+typedef Register<DPM_SNK_PDO1_0, 4> DPM_SNK_PDO1;
+typedef Register<DPM_SNK_PDO2_0, 4> DPM_SNK_PDO2;
+typedef Register<DPM_SNK_PDO3_0, 4> DPM_SNK_PDO3;
+
+/* Fixed supply PDO, shared by the DPM_SNK_PDOx words and received PDOs */
+typedef BitField<0, 10, 10> SNK_PDO_CURRENT;   // mA
+typedef BitField<10, 10, 50> SNK_PDO_VOLTAGE;  // mV
+
+/* NVM image, addressed as sector * 8 + byte */
+constexpr uint8_t nvm_byte(uint8_t sector, uint8_t byte) { return sector * 8 + byte; }
+
+typedef Register<nvm_byte(1, 0), 1> NVM_GPIO_CFG;
+typedef RegField<NVM_GPIO_CFG, BitField<4, 2>> NVM_GPIO_CTRL;
+
+typedef Register<nvm_byte(3, 2), 1> NVM_SNK_CFG;
+typedef RegField<NVM_SNK_CFG, BitField<0, 1>> NVM_USB_COMM_CAPABLE;
+typedef RegField<NVM_SNK_CFG, BitField<1, 2>> NVM_SNK_PDO_NUMB;
+typedef RegField<NVM_SNK_CFG, BitField<3, 1>> NVM_EXT_POWER;
+typedef RegField<NVM_SNK_CFG, BitField<4, 4>> NVM_I_SNK_PDO1;
+
+/* VBUS monitoring limits, in percent of the PDO voltage, 5 - 20 */
+typedef Register<nvm_byte(3, 3), 1> NVM_SNK_PDO1_CFG;
+typedef RegField<NVM_SNK_PDO1_CFG, BitField<4, 4, 1, 5>> NVM_PDO1_UPPER_LIMIT;
+
+typedef Register<nvm_byte(3, 4), 1> NVM_SNK_PDO2_CFG;
+typedef RegField<NVM_SNK_PDO2_CFG, BitField<0, 4>> NVM_I_SNK_PDO2;
+typedef RegField<NVM_SNK_PDO2_CFG, BitField<4, 4, 1, 5>> NVM_PDO2_LOWER_LIMIT;
+
+typedef Register<nvm_byte(3, 5), 1> NVM_SNK_PDO2_CFG_1;
+typedef RegField<NVM_SNK_PDO2_CFG_1, BitField<0, 4, 1, 5>> NVM_PDO2_UPPER_LIMIT;
+typedef RegField<NVM_SNK_PDO2_CFG_1, BitField<4, 4>> NVM_I_SNK_PDO3;
+
+typedef Register<nvm_byte(3, 6), 1> NVM_SNK_PDO3_CFG;
+typedef RegField<NVM_SNK_PDO3_CFG, BitField<0, 4, 1, 5>> NVM_PDO3_LOWER_LIMIT;
+typedef RegField<NVM_SNK_PDO3_CFG, BitField<4, 4, 1, 5>> NVM_PDO3_UPPER_LIMIT;
+
+/* sink voltages and the flex current straddle byte boundaries */
+typedef Register<nvm_byte(4, 0), 2> NVM_V_SNK_PDO2_REG;
+typedef RegField<NVM_V_SNK_PDO2_REG, BitField<6, 10, 50>> NVM_V_SNK_PDO2;  // mV
+
+typedef Register<nvm_byte(4, 2), 2> NVM_V_SNK_PDO3_REG;
+typedef RegField<NVM_V_SNK_PDO3_REG, BitField<0, 10, 50>> NVM_V_SNK_PDO3;  // mV
+
+typedef Register<nvm_byte(4, 3), 2> NVM_FLEX_CURRENT_REG;
+typedef RegField<NVM_FLEX_CURRENT_REG, BitField<2, 10, 10>> NVM_FLEX_CURRENT;  // mA
+
+typedef Register<nvm_byte(4, 4), 1> NVM_POWER_OK_REG;
+typedef RegField<NVM_POWER_OK_REG, BitField<5, 2>> NVM_POWER_OK_CFG;
+
+typedef Register<nvm_byte(4, 6), 1> NVM_SNK_CTRL;
+typedef RegField<NVM_SNK_CTRL, BitField<3, 1>> NVM_POWER_ONLY_ABOVE_5V;
+typedef RegField<NVM_SNK_CTRL, BitField<4, 1>> NVM_REQ_SRC_CURRENT;
+
+/* ALERT_STATUS_1 and ALERT_STATUS_1_MASK (1 = masked) */
+typedef BitField<1, 1> ALERT_PRT_STATUS;
+typedef BitField<4, 1> ALERT_CC_HW_FAULT;
+typedef BitField<5, 1> ALERT_TYPEC_MONITORING;
+typedef BitField<6, 1> ALERT_CC_DETECTION;
+
+/* Status bits decoded from the alert burst */
+typedef BitField<0, 1> PORT_CC_DETECTION_TRANS;  // PORT_STATUS_0
+typedef BitField<0, 1> PORT_CC_ATTACH_STATE;     // PORT_STATUS_1
+typedef BitField<4, 1> MONITORING_VBUS_LOW;      // TYPEC_MONITORING_STATUS_0
+typedef BitField<5, 1> MONITORING_VBUS_HIGH;     // TYPEC_MONITORING_STATUS_0
+typedef BitField<7, 1> CC_HW_VPU_OVP_FAULT;      // CC_HW_FAULT_STATUS_1
+typedef BitField<0, 1> PRT_HW_RESET_RECEIVED;    // PRT_STATUS
+typedef BitField<2, 1> PRT_MSG_RECEIVED;         // PRT_STATUS
+
+/* RX_HEADER_LOW/HIGH */
+typedef BitField<0, 5> RX_HEADER_MSG_TYPE;
+typedef BitField<12, 3> RX_HEADER_NUM_DATA_OBJ;
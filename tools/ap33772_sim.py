@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+"""ap33772_sim.py
+
+Host-side fake AP33772 for the telemetry sampler (ap33772/ap33772.cpp). The
+fake generates VBUS voltage, current and NTC temperature waveforms and
+quantises them the way the chip's ADC does (80mV, 24mA and 1C per code). The
+sampler model then reads them at a fixed rate, skips ticks that find the last
+read still queued behind a blocking call, and folds every sample into the same
+integer decimation tiers as AP33772::record_sample(): min, max and a mean
+scaled by 256, AP33772_DECIMATION inputs per summary.
+
+Waveforms:
+
+  step    load step: current jumps, VBUS sags and recovers, NTC warms up
+  ripple  steady load with switching ripple and noise on VBUS
+  ramp    PPS voltage ramp from 5V to 20V at constant current
+
+  ap33772_sim.py step --rate 2000 --seconds 0.5 --dump tier0
+  ap33772_sim.py ripple --check     # compare tiers against exact statistics
+"""
+
+import argparse
+import math
+import random
+import sys
+
+ADC_MV = 80
+ADC_MA = 24
+TEMP_C = 1
+
+SAMPLE_HISTORY = 256  # AP33772_SAMPLE_HISTORY
+TIER_HISTORY = 64  # AP33772_TIER_HISTORY
+NUM_TIERS = 2  # AP33772_NUM_TIERS
+DECIMATION = 16  # AP33772_DECIMATION
+
+READ_US = 3 * 9 * 1e6 / 400000 + 60  # 3-byte burst at 400kHz plus the pointer write
+
+
+class FakeAP33772:
+    """Registers CMD_VOLTAGE .. CMD_TEMP as a function of time."""
+
+    def __init__(self, shape, seed):
+        self.shape = shape
+        self.rng = random.Random(seed)
+
+    def analog(self, t):
+        noise = self.rng.gauss(0, 15)
+        if self.shape == "step":
+            load = 3000 if t >= 0.1 else 500
+            sag = 600 * math.exp(-(t - 0.1) / 0.004) if t >= 0.1 else 0
+            mv = 20000 - sag - load * 0.05 + noise
+            ma = load + self.rng.gauss(0, 10)
+            temp = 30 + (15 * (1 - math.exp(-(t - 0.1) / 0.2)) if t >= 0.1 else 0)
+        elif self.shape == "ripple":
+            mv = 12000 + 120 * math.sin(2 * math.pi * 1000 * t) + noise
+            ma = 2000 + 40 * math.sin(2 * math.pi * 1000 * t + 1)
+            temp = 35
+        else:
+            mv = 5000 + min(t / 0.4, 1) * 15000 + noise
+            ma = 1500
+            temp = 30 + 10 * min(t / 0.4, 1)
+        return mv, ma, temp
+
+    def read(self, t):
+        mv, ma, temp = self.analog(t)
+        clamp = lambda v: max(0, min(255, int(v)))
+        return [clamp(mv / ADC_MV), clamp(ma / ADC_MA), clamp(temp / TEMP_C)]
+
+
+class Window:
+    """AP33772::Window"""
+
+    def __init__(self):
+        self.inputs = 0
+
+    def fold(self, s):
+        if self.inputs == 0:
+            self.acc = {"time_us": s["time_us"], "count": 0, "lo": [255] * 3, "hi": [0] * 3}
+            self.sum = [0] * 3
+        for c in range(3):
+            self.acc["lo"][c] = min(self.acc["lo"][c], s["lo"][c])
+            self.acc["hi"][c] = max(self.acc["hi"][c], s["hi"][c])
+            self.sum[c] += s["mean_q8"][c] * s["count"]
+        self.acc["count"] += s["count"]
+        self.inputs += 1
+
+    def close(self):
+        out = dict(self.acc)
+        out["mean_q8"] = [self.sum[c] // out["count"] for c in range(3)]
+        self.inputs = 0
+        return out
+
+
+def history(items, n):
+    """HistoryRing keeps the newest n - 1"""
+    return items[-(n - 1):]
+
+
+def run(fake, rate, seconds, busy, seed):
+    rng = random.Random(seed)
+    period = 1.0 / rate
+    samples, tiers = [], [[] for _ in range(NUM_TIERS)]
+    windows = [Window() for _ in range(NUM_TIERS)]
+    stats = {"samples": 0, "missed": 0}
+    for k in range(int(seconds * rate)):
+        t = k * period
+        if rng.random() < busy or READ_US * 1e-6 > period:
+            stats["missed"] += 1
+            continue
+        raw = fake.read(t)
+        sample = {"time_us": int(t * 1e6), "raw": raw}
+        samples.append(sample)
+        stats["samples"] += 1
+        s = {"time_us": sample["time_us"], "count": 1, "lo": raw[:], "hi": raw[:],
+             "mean_q8": [r << 8 for r in raw]}
+        for w, tier in zip(windows, tiers):
+            w.fold(s)
+            if w.inputs < DECIMATION:
+                break
+            s = w.close()
+            tier.append(s)
+    return samples, tiers, stats
+
+
+def check(samples, tiers):
+    """Tier 0 and tier 1 against exact statistics of the samples they cover."""
+    span = 1
+    for level, tier in enumerate(tiers):
+        span *= DECIMATION
+        for i, s in enumerate(tier):
+            covered = samples[i * span:(i + 1) * span]
+            assert s["count"] == len(covered) == span
+            for c in range(3):
+                values = [x["raw"][c] for x in covered]
+                exact = sum(values) * 256 / span
+                if s["lo"][c] != min(values) or s["hi"][c] != max(values):
+                    print("tier %d summary %d: min/max mismatch on channel %d" % (level, i, c))
+                    return 1
+                if not 0 <= exact - s["mean_q8"][c] < level + 1:
+                    print(
+                        "tier %d summary %d: mean %d, exact %.2f"
+                        % (level, i, s["mean_q8"][c], exact)
+                    )
+                    return 1
+    print("%d samples, %s summaries ok" % (len(samples), "/".join(str(len(t)) for t in tiers)))
+    return 0
+
+
+def dump(samples, tiers, which):
+    if which == "samples":
+        print("time_us,mV,mA,cC")
+        for s in history(samples, SAMPLE_HISTORY):
+            r = s["raw"]
+            mv, ma, cc = r[0] * ADC_MV, r[1] * ADC_MA, r[2] * TEMP_C * 100
+            print("%d,%d,%d,%d" % (s["time_us"], mv, ma, cc))
+        return
+    print("time_us,count,mV_min,mV_max,mV_mean,mA_min,mA_max,mA_mean")
+    for s in history(tiers[int(which[-1])], TIER_HISTORY):
+        row = [s["time_us"], s["count"]]
+        for c, lsb in ((0, ADC_MV), (1, ADC_MA)):
+            row += [s["lo"][c] * lsb, s["hi"][c] * lsb, (s["mean_q8"][c] * lsb) >> 8]
+        print(",".join(str(v) for v in row))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("shape", choices=("step", "ripple", "ramp"))
+    parser.add_argument("--rate", type=float, default=2000, help="samples per second")
+    parser.add_argument("--seconds", type=float, default=0.5)
+    parser.add_argument(
+        "--busy", type=float, default=0.0, help="chance a tick finds the last read still queued"
+    )
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--dump", choices=("samples", "tier0", "tier1"))
+    parser.add_argument("--check", action="store_true")
+    args = parser.parse_args()
+
+    samples, tiers, stats = run(FakeAP33772(args.shape, args.seed), args.rate, args.seconds,
+                                args.busy, args.seed)
+    if args.check:
+        return check(samples, tiers)
+    if args.dump:
+        dump(samples, tiers, args.dump)
+        return 0
+    print("%d samples, %d missed" % (stats["samples"], stats["missed"]))
+    for level, tier in enumerate(tiers):
+        if tier:
+            v = [s["lo"][0] * ADC_MV for s in tier], [s["hi"][0] * ADC_MV for s in tier]
+            print("  tier %d: %d summaries of %d samples, VBUS %d .. %d mV"
+                  % (level, len(tier), tier[0]["count"], min(v[0]), max(v[1])))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+"""fontconv.py
+
+Converts a font into the page-native PageFont format used by the SSD1306
+driver. Each glyph is stored as ceil(height / 8) pages of `width` bytes,
+LSB at the top, so OLED::print_char can OR it straight into the framebuffer.
+
+Accepted inputs:
+  * Adafruit-GFX headers (.h/.hpp), e.g. ssd1306/font/dialog_bold_16.hpp
+  * BDF bitmap fonts (.bdf)
+
+TTF fonts should first be rasterised to BDF (otf2bdf) or to a GFX header
+(Adafruit fontconvert, http://oleddisplay.squix.ch).
+
+Usage:
+  fontconv.py INPUT OUTPUT NAME [--first 0x20] [--last 0x7e]
+"""
+
+import argparse
+import re
+import sys
+
+
+class Glyph:
+    def __init__(self, width, height, x_advance, x_offset, y_offset, rows):
+        self.width = width
+        self.height = height
+        self.x_advance = x_advance
+        self.x_offset = x_offset
+        self.y_offset = y_offset
+        self.rows = rows  # list of rows, each a list of 0/1 pixels
+
+
+def strip_comments(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    return re.sub(r"//[^\n]*", "", text)
+
+
+def parse_gfx(text):
+    text = strip_comments(text)
+
+    bitmap_match = re.search(r"uint8_t\s+\w+\s*\[\s*\]\s*=\s*\{(.*?)\}\s*;", text, re.S)
+    glyph_match = re.search(r"GFXglyph\s+\w+\s*\[\s*\]\s*=\s*\{(.*)\}\s*;", text, re.S)
+    font_match = re.search(
+        r"GFXfont\s+\w+\s*=\s*\{[^,]*,[^,]*,\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*\}", text)
+    if not (bitmap_match and glyph_match and font_match):
+        sys.exit("fontconv: not a GFXfont header")
+
+    bitmap = [int(b, 0) for b in re.findall(r"0x[0-9a-fA-F]+|\d+", bitmap_match.group(1))]
+    entries = re.findall(r"\{\s*(-?\d+)\s*,\s*(-?\d+)\s*,\s*(-?\d+)\s*,\s*(-?\d+)\s*,"
+                         r"\s*(-?\d+)\s*,\s*(-?\d+)\s*\}", glyph_match.group(1))
+    first, last, y_advance = (int(v, 0) for v in font_match.groups())
+
+    glyphs = {}
+    for code, entry in zip(range(first, last + 1), entries):
+        offset, width, height, x_advance, x_offset, y_offset = (int(v) for v in entry)
+        rows = []
+        bit = 0
+        for _ in range(height):
+            row = []
+            for _ in range(width):
+                byte = bitmap[offset + (bit >> 3)]
+                row.append((byte >> (7 - (bit & 7))) & 1)
+                bit += 1
+            rows.append(row)
+        glyphs[code] = Glyph(width, height, x_advance, x_offset, y_offset, rows)
+    return glyphs, y_advance
+
+
+def parse_bdf(text):
+    glyphs = {}
+    ascent = descent = 0
+    lines = iter(text.splitlines())
+    for line in lines:
+        fields = line.split()
+        if not fields:
+            continue
+        if fields[0] == "FONT_ASCENT":
+            ascent = int(fields[1])
+        elif fields[0] == "FONT_DESCENT":
+            descent = int(fields[1])
+        elif fields[0] == "STARTCHAR":
+            code = -1
+            x_advance = width = height = x_off = y_off = 0
+            rows = []
+            for line in lines:
+                fields = line.split()
+                if fields[0] == "ENCODING":
+                    code = int(fields[1])
+                elif fields[0] == "DWIDTH":
+                    x_advance = int(fields[1])
+                elif fields[0] == "BBX":
+                    width, height, x_off, y_off = (int(v) for v in fields[1:5])
+                elif fields[0] == "BITMAP":
+                    for _ in range(height):
+                        hex_row = next(lines).strip()
+                        value = int(hex_row, 16)
+                        row_bits = len(hex_row) * 4
+                        rows.append([(value >> (row_bits - 1 - j)) & 1 for j in range(width)])
+                elif fields[0] == "ENDCHAR":
+                    break
+            if code >= 0:
+                # GFX convention: y_offset is from the baseline to the top row
+                glyphs[code] = Glyph(width, height, x_advance, x_off, -(y_off + height), rows)
+    # y_advance in this driver is the distance from the top of a line to its baseline
+    return glyphs, ascent if ascent else max(-g.y_offset for g in glyphs.values())
+
+
+def to_pages(glyph):
+    pages = (glyph.height + 7) // 8
+    data = [0] * (pages * glyph.width)
+    for i, row in enumerate(glyph.rows):
+        for j, pixel in enumerate(row):
+            if pixel:
+                data[(i >> 3) * glyph.width + j] |= 1 << (i & 7)
+    return data
+
+
+def emit(glyphs, y_advance, name, first, last):
+    data = []
+    table = []
+    for code in range(first, last + 1):
+        glyph = glyphs.get(code, Glyph(0, 0, 0, 0, 0, []))
+        pages = to_pages(glyph)
+        label = chr(code) if 0x20 <= code < 0x7F else "0x%02X" % code
+        table.append("    {%d, %d, %d, %d, %d, %d},  // '%s'" %
+                     (len(data), glyph.width, glyph.height, glyph.x_advance,
+                      glyph.x_offset, glyph.y_offset, label))
+        data.extend(pages)
+
+    guard = "_%s_PAGE_H" % name.upper()
+    out = []
+    out.append("/* Generated by tools/fontconv.py, do not edit. */")
+    out.append("")
+    out.append("#ifndef %s" % guard)
+    out.append("#define %s" % guard)
+    out.append("")
+    out.append('#include "ssd1306.hpp"')
+    out.append("")
+    out.append("constexpr uint8_t %sPages[] = {" % name)
+    for i in range(0, len(data), 13):
+        out.append("    " + ", ".join("0x%02X" % b for b in data[i:i + 13]) + ",")
+    out.append("};")
+    out.append("")
+    out.append("constexpr GFXglyph %sPageGlyphs[] = {" % name)
+    out.extend(table)
+    out.append("};")
+    out.append("")
+    out.append("constexpr PageFont %s_page = {%sPages, %sPageGlyphs, 0x%02X, 0x%02X, %d};" %
+               (name, name, name, first, last, y_advance))
+    out.append("")
+    out.append("#endif")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert a font to the SSD1306 PageFont format")
+    parser.add_argument("input")
+    parser.add_argument("output")
+    parser.add_argument("name")
+    parser.add_argument("--first", type=lambda v: int(v, 0), default=0x20)
+    parser.add_argument("--last", type=lambda v: int(v, 0), default=0x7E)
+    args = parser.parse_args()
+
+    with open(args.input) as f:
+        text = f.read()
+
+    if args.input.lower().endswith(".bdf"):
+        glyphs, y_advance = parse_bdf(text)
+    else:
+        glyphs, y_advance = parse_gfx(text)
+
+    with open(args.output, "w") as f:
+        f.write(emit(glyphs, y_advance, args.name, args.first, args.last))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,293 @@
+#!/usr/bin/env python3
+"""ftp_sim.py
+
+Host simulation of the STUSB4500 FTP (NVM) controller driven the way
+STUSB4500::write() does it (stusb4500/stusb4500.cpp). Two pipelines are run
+against the same target image:
+
+  full  the old path: erase all five sectors, program all five, and poll
+        FTP_CTRL_0 back to back until each request completes
+  diff  read the sectors back, erase and program only the ones that differ,
+        poll with a doubling backoff, then read everything again to verify
+
+The device model enforces the FTP rules the driver relies on: the password
+must be written, an operation starts when FTP_CUST_REQ is set and the bit
+stays set for the operation's latency, erase clears a sector to 0x00 and
+programming may only set bits in an erased sector.
+
+  ftp_sim.py --changed 1 --baud 400000
+  ftp_sim.py --check 2000    # random images, assert the diff pipeline is exact
+"""
+
+import argparse
+import random
+import sys
+
+NUM_OF_SECTORS = 5
+SIZE_OF_SECTOR = 8
+
+FTP_CUST_PASSWORD_REG = 0x95
+FTP_CUST_PASSWORD = 0x47
+FTP_CTRL_0 = 0x96
+FTP_CTRL_1 = 0x97
+RW_BUFFER = 0x53
+
+FTP_CUST_PWR = 0x80
+FTP_CUST_RST_N = 0x40
+FTP_CUST_REQ = 0x10
+FTP_CUST_SECT = 0x07
+FTP_CUST_SER = 0xF8
+FTP_CUST_OPCODE = 0x07
+
+READ, WRITE_PL, WRITE_SER, ERASE_SECTOR, PROG_SECTOR, SOFT_PROG_SECTOR = 0, 1, 2, 5, 6, 7
+
+# operation latency in microseconds, rough figures for an FTP macro
+LATENCY_US = {
+    READ: 50,
+    WRITE_PL: 10,
+    WRITE_SER: 10,
+    SOFT_PROG_SECTOR: 500,
+    ERASE_SECTOR: 5000,
+    PROG_SECTOR: 2000,
+}
+
+POLL_MIN_US = 20  # STUSB4500_NVM_POLL_MIN_US
+POLL_MAX_US = 2000  # STUSB4500_NVM_POLL_MAX_US
+SW_OVERHEAD_US = 15  # per transaction, driver and SDK
+
+
+class FTP:
+    def __init__(self, nvm):
+        self.nvm = [list(s) for s in nvm]
+        self.regs = {FTP_CUST_PASSWORD_REG: 0, FTP_CTRL_0: 0, FTP_CTRL_1: 0}
+        self.rw = [0] * SIZE_OF_SECTOR
+        self.ser = 0
+        self.busy_until = 0.0
+        self.erases = [0] * NUM_OF_SECTORS
+
+    def write(self, now, reg, data):
+        for i, value in enumerate(data):
+            r = reg + i
+            if RW_BUFFER <= r < RW_BUFFER + SIZE_OF_SECTOR:
+                self.rw[r - RW_BUFFER] = value
+                continue
+            self.regs[r] = value
+            if r == FTP_CTRL_0 and value & FTP_CUST_REQ:
+                self.execute(now, value & FTP_CUST_SECT)
+
+    def read(self, now, reg, n):
+        out = []
+        for i in range(n):
+            r = reg + i
+            if RW_BUFFER <= r < RW_BUFFER + SIZE_OF_SECTOR:
+                out.append(self.rw[r - RW_BUFFER])
+            elif r == FTP_CTRL_0:
+                value = self.regs[FTP_CTRL_0]
+                if now >= self.busy_until:
+                    value &= ~FTP_CUST_REQ
+                    self.regs[FTP_CTRL_0] = value
+                out.append(value)
+            else:
+                out.append(self.regs.get(r, 0))
+        return out
+
+    def execute(self, now, sect):
+        if self.regs[FTP_CUST_PASSWORD_REG] != FTP_CUST_PASSWORD:
+            raise RuntimeError("FTP request without the customer password")
+        if now < self.busy_until:
+            raise RuntimeError("FTP request while busy")
+        op = self.regs[FTP_CTRL_1] & FTP_CUST_OPCODE
+        if op == READ:
+            self.rw = list(self.nvm[sect])
+        elif op == WRITE_SER:
+            self.ser = (self.regs[FTP_CTRL_1] & FTP_CUST_SER) >> 3
+        elif op == ERASE_SECTOR:
+            for i in range(NUM_OF_SECTORS):
+                if self.ser & (1 << i):
+                    self.nvm[i] = [0] * SIZE_OF_SECTOR
+                    self.erases[i] += 1
+        elif op == PROG_SECTOR:
+            if any(old & ~new & 0xFF for old, new in zip(self.nvm[sect], self.rw)):
+                raise RuntimeError("programming sector %d without erasing it" % sect)
+            self.nvm[sect] = [old | new for old, new in zip(self.nvm[sect], self.rw)]
+        self.busy_until = now + LATENCY_US[op]
+
+
+class Bus:
+    """Blocking I2C at baud, one START ... STOP per transaction."""
+
+    def __init__(self, dev, baud):
+        self.dev = dev
+        self.baud = baud
+        self.now = 0.0
+        self.transactions = 0
+
+    def cost(self, nbytes):
+        self.transactions += 1
+        self.now += (nbytes + 1) * 9 * 1e6 / self.baud + SW_OVERHEAD_US
+
+    def batch(self, writes):
+        """I2CBatch::run(): writes joined by repeated starts."""
+        self.cost(sum(1 + len(d) for _, d in writes))
+        for reg, data in writes:
+            self.dev.write(self.now, reg, data)
+
+    def read(self, reg, n):
+        self.cost(1 + n)
+        return self.dev.read(self.now, reg, n)
+
+    def sleep(self, us):
+        self.now += us
+
+
+def wait_exec(bus, backoff):
+    delay = POLL_MIN_US
+    while bus.read(FTP_CTRL_0, 1)[0] & FTP_CUST_REQ:
+        if backoff:
+            bus.sleep(delay)
+            delay = min(delay * 2, POLL_MAX_US)
+
+
+def request(bus, opcode, sect=0):
+    return [
+        (FTP_CTRL_1, [opcode & FTP_CUST_OPCODE]),
+        (FTP_CTRL_0, [(sect & FTP_CUST_SECT) | FTP_CUST_PWR | FTP_CUST_RST_N | FTP_CUST_REQ]),
+    ]
+
+
+def enter_write_mode(bus, mask, backoff):
+    bus.batch(
+        [
+            (FTP_CUST_PASSWORD_REG, [FTP_CUST_PASSWORD]),
+            (RW_BUFFER, [0]),
+            (FTP_CTRL_0, [0]),
+            (FTP_CTRL_0, [FTP_CUST_PWR | FTP_CUST_RST_N]),
+            (FTP_CTRL_1, [((mask << 3) & FTP_CUST_SER) | WRITE_SER]),
+            (FTP_CTRL_0, [FTP_CUST_PWR | FTP_CUST_RST_N | FTP_CUST_REQ]),
+        ]
+    )
+    wait_exec(bus, backoff)
+    bus.batch(request(bus, SOFT_PROG_SECTOR))
+    wait_exec(bus, backoff)
+    bus.batch(request(bus, ERASE_SECTOR))
+    wait_exec(bus, backoff)
+
+
+def write_sector(bus, sect, data, backoff):
+    bus.batch([(RW_BUFFER, list(data)), (FTP_CTRL_0, [FTP_CUST_PWR | FTP_CUST_RST_N])]
+              + request(bus, WRITE_PL))
+    wait_exec(bus, backoff)
+    bus.batch(request(bus, PROG_SECTOR, sect))
+    wait_exec(bus, backoff)
+
+
+def read_sectors(bus, backoff):
+    bus.batch(
+        [
+            (FTP_CUST_PASSWORD_REG, [FTP_CUST_PASSWORD]),
+            (FTP_CTRL_0, [0]),
+            (FTP_CTRL_0, [FTP_CUST_PWR | FTP_CUST_RST_N]),
+        ]
+    )
+    out = []
+    for i in range(NUM_OF_SECTORS):
+        bus.batch([(FTP_CTRL_0, [FTP_CUST_PWR | FTP_CUST_RST_N])] + request(bus, READ, i))
+        wait_exec(bus, backoff)
+        out.append(bus.read(RW_BUFFER, SIZE_OF_SECTOR))
+    return out
+
+
+def exit_test_mode(bus):
+    bus.batch([(FTP_CTRL_0, [FTP_CUST_RST_N]), (FTP_CUST_PASSWORD_REG, [0])])
+
+
+def program_full(bus, image):
+    enter_write_mode(bus, 0x1F, False)
+    for i in range(NUM_OF_SECTORS):
+        write_sector(bus, i, image[i], False)
+    exit_test_mode(bus)
+    return True
+
+
+def program_diff(bus, image):
+    """Mirrors STUSB4500::program()."""
+    current = read_sectors(bus, True)
+    mask = 0
+    for i in range(NUM_OF_SECTORS):
+        if current[i] != list(image[i]):
+            mask |= 1 << i
+    ok = True
+    if mask:
+        enter_write_mode(bus, mask, True)
+        for i in range(NUM_OF_SECTORS):
+            if mask & (1 << i):
+                write_sector(bus, i, image[i], True)
+        ok = read_sectors(bus, True) == [list(s) for s in image]
+    exit_test_mode(bus)
+    return ok
+
+
+def random_image(rng):
+    return [[rng.randrange(256) for _ in range(SIZE_OF_SECTOR)] for _ in range(NUM_OF_SECTORS)]
+
+
+def mutate(rng, image, changed):
+    out = [list(s) for s in image]
+    for i in rng.sample(range(NUM_OF_SECTORS), changed):
+        j = rng.randrange(SIZE_OF_SECTOR)
+        out[i][j] ^= 1 << rng.randrange(8)
+    return out
+
+
+def run(pipeline, start, target, baud):
+    dev = FTP(start)
+    bus = Bus(dev, baud)
+    ok = pipeline(bus, target) and dev.nvm == [list(s) for s in target]
+    return ok, bus, dev
+
+
+def check(count, baud, seed):
+    rng = random.Random(seed)
+    for n in range(count):
+        start = random_image(rng)
+        changed = rng.randrange(NUM_OF_SECTORS + 1)
+        target = mutate(rng, start, changed)
+        ok, _, dev = run(program_diff, start, target, baud)
+        if not ok:
+            print("case %d: NVM does not match the target" % n)
+            return 1
+        stale = [i for i in range(NUM_OF_SECTORS) if start[i] != target[i]]
+        erased = [i for i in range(NUM_OF_SECTORS) if dev.erases[i]]
+        if erased != stale or any(e > 1 for e in dev.erases):
+            print("case %d: erased %s, expected %s" % (n, erased, stale))
+            return 1
+    print("%d cases ok" % count)
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--changed", type=int, default=1, help="sectors that differ")
+    parser.add_argument("--baud", type=int, default=400000)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--check", type=int, metavar="N", help="run N random cases")
+    args = parser.parse_args()
+
+    if args.check:
+        return check(args.check, args.baud, args.seed)
+
+    rng = random.Random(args.seed)
+    start = random_image(rng)
+    target = mutate(rng, start, max(0, min(args.changed, NUM_OF_SECTORS)))
+    print("%d of %d sectors differ, %d baud" % (args.changed, NUM_OF_SECTORS, args.baud))
+    for name, pipeline in (("full", program_full), ("diff", program_diff)):
+        ok, bus, dev = run(pipeline, start, target, args.baud)
+        print(
+            "  %-4s %-8s %6.1f ms  %5d transactions  %d sector erases"
+            % (name, "ok" if ok else "FAILED", bus.now / 1000, bus.transactions, sum(dev.erases))
+        )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,581 @@
+/** @file pico_host.cpp
+ *
+ * @brief Simulated Pico SDK peripherals for host builds, see pico_host.h.
+ *
+ * @par
+ * Every tick is 100 ns. The DMA moves at most one element per channel per
+ * tick, paced by its DREQ. An SPI block shifts one byte per 8 clocks from an
+ * 8 entry TX FIFO. Register writes that land on a peripheral's data register
+ * feed that peripheral, everything else is plain memory.
+ *
+ * An I2C block runs 16 entry command and RX FIFOs the way the DW_apb_i2c
+ * does: a byte takes 9 bit times, an address byte goes out at the start, on
+ * a RESTART and on a direction change, and the STOP bit ends the transfer.
+ * A NAK aborts it, flushes the TX FIFO and drops writes until the abort is
+ * cleared. Interrupt bits only latch while unmasked. The clear-on-read
+ * registers can't see their reads, so the bits an I2C handler was entered
+ * for are cleared when it returns.
+ */
+
+#include <deque>
+#include <vector>
+
+#include "pico_host.h"
+
+namespace {
+
+const uint64_t TICK_NS = 100;
+const uint DREQ_SPI0_TX = 16;
+const uint DREQ_I2C0_TX = 32;
+const uint DREQ_FORCE = 0x3f;
+const size_t SPI_FIFO_DEPTH = 8;
+const size_t I2C_FIFO_DEPTH = 16;
+
+uint64_t now_ns = 0;
+
+/* Interrupts */
+struct IrqLine {
+  std::vector<irq_handler_t> handlers;
+  bool enabled;
+};
+IrqLine irqs[32];
+uint32_t irqs_disabled = 0;
+bool in_handler = false;
+
+/* GPIO outputs, one bit per pin */
+uint64_t gpio_out = 0;
+
+/* DMA */
+struct Channel {
+  bool claimed;
+  bool busy;
+  dma_channel_config c;
+  volatile uint8_t *write;
+  const volatile uint8_t *read;
+  uint count;
+  bool intr;  // raw completion flag
+  bool irq0_enabled;
+  bool irq1_enabled;
+};
+Channel channels[NUM_DMA_CHANNELS];
+
+}  // namespace
+
+/* I2C */
+struct I2CTarget {
+  uint8_t addr;
+  uint8_t regs[256];
+  uint8_t ptr;
+  uint32_t nak_after;
+};
+
+struct i2c_inst {
+  i2c_hw_t hw;
+  uint index;
+  uint baudrate;
+  std::deque<uint16_t> tx;
+  std::deque<uint8_t> rx;
+  std::deque<I2CTarget> targets;
+  I2CTarget *target;  // addressed target, nullptr if it NAKed
+  bool in_xfer;       // between START and STOP
+  bool reading;       // direction of the current phase
+  uint32_t written;   // data bytes in the current write phase
+  bool word_active;   // a command word is on the wire
+  uint16_t word;
+  uint64_t word_end;
+  bool aborted;     // TX FIFO flushed until the abort is cleared
+  uint64_t stop_at; // STOP the controller sends after an abort, 0 for none
+  bool abort_seen;  // for the blocking calls, which run with interrupts masked
+  uint32_t raw;     // latched interrupt bits
+};
+
+/* SPI */
+struct spi_inst {
+  spi_hw_t hw;
+  uint index;
+  uint baudrate;
+  std::deque<uint8_t> fifo;
+  bool shifting;
+  uint64_t shift_end;
+  host_spi_byte_t current;
+};
+
+namespace {
+
+spi_inst spis[NUM_SPIS] = {{{}, 0, 1000000, {}, false, 0, {}},
+                           {{}, 1, 1000000, {}, false, 0, {}}};
+std::vector<host_spi_byte_t> spi_capture;
+uint32_t spi_resets_while_busy = 0;
+
+i2c_inst i2cs[NUM_I2CS];
+std::vector<host_i2c_event_t> i2c_log;
+
+struct I2CDefaults {
+  I2CDefaults() {
+    for (uint i = 0; i < NUM_I2CS; ++i) {
+      i2cs[i].index = i;
+      i2cs[i].baudrate = 100000;
+    }
+  }
+} i2c_defaults;
+
+void i2c_event(i2c_inst *i2c, uint8_t kind, uint8_t value, bool ack, bool read) {
+  i2c_log.push_back({now_ns, (uint8_t)i2c->index, kind, value, ack, read});
+}
+
+void i2c_raise(i2c_inst *i2c, uint32_t bits) {
+  i2c->raw |= bits & i2c->hw.intr_mask;
+  i2c->hw.intr_stat = i2c->raw;
+}
+
+/* TX_ABRT is raised at once, STOP_DET a bit time later with the STOP */
+void i2c_abort(i2c_inst *i2c) {
+  i2c->tx.clear();
+  i2c->aborted = true;
+  i2c->abort_seen = true;
+  i2c->stop_at = now_ns + 1000000000ull / i2c->baudrate;
+  i2c_raise(i2c, I2C_IC_INTR_STAT_R_TX_ABRT_BITS);
+}
+
+I2CTarget *i2c_find_target(i2c_inst *i2c, uint8_t addr) {
+  for (I2CTarget &t : i2c->targets) {
+    if (t.addr == addr) return &t;
+  }
+  return nullptr;
+}
+
+/* Everything a command word does happens when its last bit is on the wire */
+void i2c_finish_word(i2c_inst *i2c) {
+  uint16_t word = i2c->word;
+  bool read = word & I2C_IC_DATA_CMD_CMD_BITS;
+  i2c->word_active = false;
+
+  if (!i2c->in_xfer || (word & I2C_IC_DATA_CMD_RESTART_BITS) || read != i2c->reading) {
+    i2c_event(i2c, i2c->in_xfer ? HOST_I2C_RESTART : HOST_I2C_START, 0, true, false);
+    i2c->in_xfer = true;
+    i2c->reading = read;
+    i2c->written = 0;
+    i2c->target = i2c_find_target(i2c, (uint8_t)(i2c->hw.tar & 0x7f));
+    i2c_event(i2c, HOST_I2C_ADDR, (uint8_t)(i2c->hw.tar & 0x7f), i2c->target, read);
+    if (!i2c->target) return i2c_abort(i2c);
+  }
+
+  I2CTarget *t = i2c->target;
+  if (read) {
+    uint8_t value = t->regs[t->ptr++];
+    i2c->rx.push_back(value);
+    i2c_event(i2c, HOST_I2C_READ, value, true, true);
+  } else {
+    uint8_t value = (uint8_t)word;
+    bool ack = !t->nak_after || i2c->written < t->nak_after;
+    i2c_event(i2c, HOST_I2C_WRITE, value, ack, false);
+    if (!ack) return i2c_abort(i2c);
+    if (i2c->written++ == 0) {
+      t->ptr = value;
+    } else {
+      t->regs[t->ptr++] = value;
+    }
+  }
+
+  if (word & I2C_IC_DATA_CMD_STOP_BITS) {
+    i2c_event(i2c, HOST_I2C_STOP, 0, true, false);
+    i2c->in_xfer = false;
+    i2c_raise(i2c, I2C_IC_INTR_STAT_R_STOP_DET_BITS);
+  }
+}
+
+void i2c_step(i2c_inst *i2c) {
+  if (i2c->word_active && now_ns >= i2c->word_end) i2c_finish_word(i2c);
+  if (i2c->stop_at && now_ns >= i2c->stop_at) {
+    i2c_event(i2c, HOST_I2C_STOP, 0, true, false);
+    i2c->in_xfer = false;
+    i2c->stop_at = 0;
+    i2c_raise(i2c, I2C_IC_INTR_STAT_R_STOP_DET_BITS);
+  }
+  if (i2c->word_active || i2c->stop_at || i2c->tx.empty()) return;
+  /* a read stalls the bus while the RX FIFO is full */
+  bool read = i2c->tx.front() & I2C_IC_DATA_CMD_CMD_BITS;
+  if (read && i2c->rx.size() >= I2C_FIFO_DEPTH) return;
+
+  uint64_t bit_ns = 1000000000ull / i2c->baudrate;
+  uint bits = 9;
+  if (!i2c->in_xfer || (i2c->tx.front() & I2C_IC_DATA_CMD_RESTART_BITS) ||
+      read != i2c->reading) {
+    bits += 10;  // START or RESTART and the address byte
+  }
+  if (i2c->tx.front() & I2C_IC_DATA_CMD_STOP_BITS) bits += 1;
+  i2c->word = i2c->tx.front();
+  i2c->tx.pop_front();
+  i2c->word_active = true;
+  i2c->word_end = now_ns + bits * bit_ns;
+}
+
+bool i2c_idle(const i2c_inst *i2c) {
+  return !i2c->word_active && !i2c->stop_at && i2c->tx.empty();
+}
+
+/* the SDK's blocking calls, on the same FIFOs as the DMA engine */
+void i2c_push(i2c_inst *i2c, uint16_t word) {
+  while (i2c->tx.size() >= I2C_FIFO_DEPTH) tight_loop_contents();
+  if (!i2c->aborted) i2c->tx.push_back(word);
+}
+
+void i2c_begin_blocking(i2c_inst *i2c, uint8_t addr) {
+  i2c->hw.tar = addr;
+  i2c->aborted = false;
+  i2c->abort_seen = false;
+}
+
+void spi_step(spi_inst *spi) {
+  if (spi->shifting && now_ns >= spi->shift_end) {
+    spi->current.end_ns = now_ns;
+    spi->current.gpio_end = gpio_out;
+    spi_capture.push_back(spi->current);
+    spi->shifting = false;
+  }
+  if (!spi->shifting && !spi->fifo.empty()) {
+    spi->current = {0, (uint8_t)spi->index, spi->fifo.front(), gpio_out, 0};
+    spi->fifo.pop_front();
+    spi->shift_end = now_ns + 8000000000ull / spi->baudrate;
+    spi->shifting = true;
+  }
+}
+
+bool dreq_ready(uint dreq) {
+  if (dreq == DREQ_FORCE) return true;
+  if (dreq >= DREQ_SPI0_TX && dreq < DREQ_SPI0_TX + 2 * NUM_SPIS && !(dreq & 1)) {
+    return spis[(dreq - DREQ_SPI0_TX) / 2].fifo.size() < SPI_FIFO_DEPTH;
+  }
+  if (dreq >= DREQ_I2C0_TX && dreq < DREQ_I2C0_TX + 2 * NUM_I2CS) {
+    const i2c_inst *i2c = &i2cs[(dreq - DREQ_I2C0_TX) / 2];
+    return (dreq & 1) ? !i2c->rx.empty() : i2c->tx.size() < I2C_FIFO_DEPTH;
+  }
+  return false;
+}
+
+uint32_t bus_read(const volatile uint8_t *addr, uint size) {
+  for (i2c_inst &i2c : i2cs) {
+    if (addr == (const volatile uint8_t *)&i2c.hw.data_cmd) {
+      if (i2c.rx.empty()) return 0;
+      uint8_t value = i2c.rx.front();
+      i2c.rx.pop_front();
+      return value;
+    }
+  }
+  if (size == DMA_SIZE_8) return *addr;
+  if (size == DMA_SIZE_16) return *(const volatile uint16_t *)addr;
+  return *(const volatile uint32_t *)addr;
+}
+
+void bus_write(volatile uint8_t *addr, uint32_t value, uint size) {
+  for (spi_inst &spi : spis) {
+    if (addr == (volatile uint8_t *)&spi.hw.dr) {
+      spi.fifo.push_back((uint8_t)value);
+      return;
+    }
+  }
+  for (i2c_inst &i2c : i2cs) {
+    if (addr == (volatile uint8_t *)&i2c.hw.data_cmd) {
+      if (!i2c.aborted) i2c.tx.push_back((uint16_t)value);
+      return;
+    }
+  }
+  if (size == DMA_SIZE_8) {
+    *addr = (uint8_t)value;
+  } else if (size == DMA_SIZE_16) {
+    *(volatile uint16_t *)addr = (uint16_t)value;
+  } else {
+    *(volatile uint32_t *)addr = value;
+  }
+}
+
+void dma_step() {
+  for (uint i = 0; i < NUM_DMA_CHANNELS; ++i) {
+    Channel *ch = &channels[i];
+    if (!ch->busy || !dreq_ready(ch->c.dreq)) continue;
+    uint width = 1u << ch->c.size;
+    bus_write(ch->write, bus_read(ch->read, ch->c.size), ch->c.size);
+    if (ch->c.read_increment) ch->read += width;
+    if (ch->c.write_increment) ch->write += width;
+    if (--ch->count == 0) {
+      ch->busy = false;
+      ch->intr = true;
+      if (ch->c.chain_to != i) channels[ch->c.chain_to].busy = true;
+    }
+  }
+}
+
+bool irq_pending(uint num) {
+  if (num == I2C0_IRQ || num == I2C1_IRQ) {
+    const i2c_inst *i2c = &i2cs[num - I2C0_IRQ];
+    return i2c->raw & i2c->hw.intr_mask;
+  }
+  for (uint i = 0; i < NUM_DMA_CHANNELS; ++i) {
+    if (!channels[i].intr) continue;
+    if (num == DMA_IRQ_0 && channels[i].irq0_enabled) return true;
+    if (num == DMA_IRQ_1 && channels[i].irq1_enabled) return true;
+  }
+  return false;
+}
+
+void tick() {
+  now_ns += TICK_NS;
+  for (spi_inst &spi : spis) spi_step(&spi);
+  for (i2c_inst &i2c : i2cs) i2c_step(&i2c);
+  dma_step();
+  if (irqs_disabled || in_handler) return;
+  for (uint num = 0; num < 32; ++num) {
+    if (!irqs[num].enabled || !irq_pending(num)) continue;
+    bool is_i2c = num == I2C0_IRQ || num == I2C1_IRQ;
+    i2c_inst *i2c = is_i2c ? &i2cs[num - I2C0_IRQ] : nullptr;
+    uint32_t entered = i2c ? i2c->raw : 0;
+    in_handler = true;
+    for (irq_handler_t handler : irqs[num].handlers) handler();
+    in_handler = false;
+    if (!i2c) continue;
+    /* the handler's reads of the clear registers */
+    i2c->raw &= ~entered;
+    i2c->hw.intr_stat = i2c->raw;
+    if (entered & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) i2c->aborted = false;
+  }
+}
+
+}  // namespace
+
+/* Time */
+absolute_time_t get_absolute_time() {
+  tick();
+  return now_ns / 1000;
+}
+
+uint32_t time_us_32() {
+  tick();
+  return (uint32_t)(now_ns / 1000);
+}
+
+void sleep_us(uint64_t us) { host_advance_ns(us * 1000); }
+
+void sleep_ms(uint32_t ms) { host_advance_ns(ms * 1000000ull); }
+
+void tight_loop_contents() { tick(); }
+
+/* Interrupts */
+uint32_t save_and_disable_interrupts() {
+  uint32_t status = irqs_disabled;
+  irqs_disabled = 1;
+  return status;
+}
+
+void restore_interrupts(uint32_t status) { irqs_disabled = status; }
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t) {
+  irqs[num].handlers.push_back(handler);
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+  irqs[num].handlers.assign(1, handler);
+}
+
+void irq_set_enabled(uint num, bool enabled) { irqs[num].enabled = enabled; }
+
+/* GPIO */
+void gpio_init(uint gpio) { gpio_out &= ~(1ull << gpio); }
+
+void gpio_set_dir(uint, bool) {}
+
+void gpio_put(uint gpio, bool value) {
+  if (value) {
+    gpio_out |= 1ull << gpio;
+  } else {
+    gpio_out &= ~(1ull << gpio);
+  }
+}
+
+bool gpio_get(uint gpio) { return (gpio_out >> gpio) & 1; }
+
+void gpio_set_function(uint, uint) {}
+
+/* DMA */
+int dma_claim_unused_channel(bool required) {
+  for (uint i = 0; i < NUM_DMA_CHANNELS; ++i) {
+    if (!channels[i].claimed) {
+      channels[i] = Channel();
+      channels[i].claimed = true;
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+void dma_channel_unclaim(uint channel) { channels[channel].claimed = false; }
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+  return {DMA_SIZE_32, true, false, DREQ_FORCE, channel};
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config,
+                           volatile void *write_addr, const volatile void *read_addr,
+                           uint transfer_count, bool trigger) {
+  Channel *ch = &channels[channel];
+  ch->c = *config;
+  ch->write = (volatile uint8_t *)write_addr;
+  ch->read = (const volatile uint8_t *)read_addr;
+  ch->count = transfer_count;
+  ch->busy = trigger && transfer_count > 0;
+}
+
+/* RP2040-E13: aborting a channel with transfers in flight raises its IRQ */
+void dma_channel_abort(uint channel) {
+  if (channels[channel].busy) channels[channel].intr = true;
+  channels[channel].busy = false;
+}
+
+bool dma_channel_is_busy(uint channel) { return channels[channel].busy; }
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled) {
+  channels[channel].irq0_enabled = enabled;
+}
+
+void dma_channel_set_irq1_enabled(uint channel, bool enabled) {
+  channels[channel].irq1_enabled = enabled;
+}
+
+bool dma_channel_get_irq0_status(uint channel) {
+  return channels[channel].intr && channels[channel].irq0_enabled;
+}
+
+bool dma_channel_get_irq1_status(uint channel) {
+  return channels[channel].intr && channels[channel].irq1_enabled;
+}
+
+void dma_channel_acknowledge_irq0(uint channel) { channels[channel].intr = false; }
+
+void dma_channel_acknowledge_irq1(uint channel) { channels[channel].intr = false; }
+
+/* SPI */
+spi_inst_t *host_spi_instance(uint index) { return &spis[index]; }
+
+uint spi_init(spi_inst_t *spi, uint baudrate) {
+  /* the SDK resets the block, losing whatever is in flight */
+  if (spi->shifting || !spi->fifo.empty()) ++spi_resets_while_busy;
+  spi->fifo.clear();
+  spi->shifting = false;
+  spi->baudrate = baudrate;
+  return baudrate;
+}
+
+void spi_set_format(spi_inst_t *, uint, spi_cpol_t, spi_cpha_t, spi_order_t) {}
+
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    while (spi->fifo.size() >= SPI_FIFO_DEPTH) tick();
+    spi->fifo.push_back(src[i]);
+  }
+  while (spi_is_busy(spi)) tick();
+  return (int)len;
+}
+
+bool spi_is_busy(const spi_inst_t *spi) { return spi->shifting || !spi->fifo.empty(); }
+
+uint spi_get_index(const spi_inst_t *spi) { return spi->index; }
+
+spi_hw_t *spi_get_hw(spi_inst_t *spi) { return &spi->hw; }
+
+uint spi_get_dreq(spi_inst_t *spi, bool is_tx) {
+  return DREQ_SPI0_TX + 2 * spi->index + (is_tx ? 0 : 1);
+}
+
+/* I2C */
+i2c_inst_t *host_i2c_instance(uint index) { return &i2cs[index]; }
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+  i2c->baudrate = baudrate;
+  return baudrate;
+}
+
+void i2c_deinit(i2c_inst_t *) {}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len,
+                       bool nostop) {
+  i2c_begin_blocking(i2c, addr);
+  for (size_t i = 0; i < len; ++i) {
+    bool last = i == len - 1;
+    i2c_push(i2c, src[i] | ((last && !nostop) ? I2C_IC_DATA_CMD_STOP_BITS : 0));
+  }
+  while (!i2c_idle(i2c)) tight_loop_contents();
+  i2c->aborted = false;
+  return i2c->abort_seen ? PICO_ERROR_GENERIC : (int)len;
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len,
+                      bool nostop) {
+  i2c_begin_blocking(i2c, addr);
+  size_t got = 0;
+  for (size_t i = 0; i < len && !i2c->abort_seen; ++i) {
+    bool last = i == len - 1;
+    i2c_push(i2c, I2C_IC_DATA_CMD_CMD_BITS |
+                      ((last && !nostop) ? I2C_IC_DATA_CMD_STOP_BITS : 0));
+    while (!i2c->abort_seen && i2c->rx.empty()) tight_loop_contents();
+    if (!i2c->rx.empty()) {
+      dst[got++] = i2c->rx.front();
+      i2c->rx.pop_front();
+    }
+  }
+  while (!i2c_idle(i2c)) tight_loop_contents();
+  i2c->aborted = false;
+  return i2c->abort_seen ? PICO_ERROR_GENERIC : (int)got;
+}
+
+uint i2c_get_index(i2c_inst_t *i2c) { return i2c->index; }
+
+i2c_inst_t *i2c_get_instance(uint index) { return host_i2c_instance(index); }
+
+i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c) { return &i2c->hw; }
+
+uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx) {
+  return DREQ_I2C0_TX + 2 * i2c->index + (is_tx ? 0 : 1);
+}
+
+/* Host side */
+uint64_t host_now_ns() { return now_ns; }
+
+void host_advance_ns(uint64_t ns) {
+  uint64_t until = now_ns + ns;
+  while (now_ns < until) tick();
+}
+
+size_t host_spi_capture(host_spi_byte_t *out, size_t max) {
+  for (size_t i = 0; i < spi_capture.size() && i < max; ++i) out[i] = spi_capture[i];
+  return spi_capture.size();
+}
+
+uint32_t host_spi_resets_while_busy() { return spi_resets_while_busy; }
+
+uint32_t host_dma_claimed() {
+  uint32_t n = 0;
+  for (const Channel &ch : channels) n += ch.claimed;
+  return n;
+}
+
+uint8_t *host_i2c_add_target(uint index, uint8_t addr) {
+  i2c_inst *i2c = host_i2c_instance(index);
+  I2CTarget *t = i2c_find_target(i2c, addr);
+  if (!t) {
+    i2c->targets.push_back(I2CTarget());
+    t = &i2c->targets.back();
+    t->addr = addr;
+  }
+  return t->regs;
+}
+
+void host_i2c_nak_after(uint index, uint8_t addr, uint32_t n) {
+  I2CTarget *t = i2c_find_target(host_i2c_instance(index), addr);
+  if (t) t->nak_after = n;
+}
+
+size_t host_i2c_log(host_i2c_event_t *out, size_t max) {
+  for (size_t i = 0; i < i2c_log.size() && i < max; ++i) out[i] = i2c_log[i];
+  return i2c_log.size();
+}
+
+/* END OF FILE */
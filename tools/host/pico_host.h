@@ -0,0 +1,232 @@
+/** @file pico_host.h
+ *
+ * @brief The part of the Pico SDK the drivers use, for host builds.
+ *
+ * @par
+ * tools/pico_host.py points every SDK header the drivers include
+ * (pico/stdlib.h, hardware/dma.h, ...) at this one file, so a driver
+ * translation unit compiles unchanged on Linux. pico_host.cpp implements it
+ * against simulated peripherals that run on a simulated clock. Time advances
+ * in ticks from every time read, tight_loop_contents() and sleep, and each
+ * tick moves the DMA channels and peripherals on and then runs any pending
+ * IRQ handler, unless interrupts are disabled or a handler is running.
+ *
+ * The host_* functions at the end let a check drive and inspect the model.
+ */
+
+#ifndef _PICO_HOST_H
+#define _PICO_HOST_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+typedef volatile uint32_t io_rw_32;
+typedef volatile uint16_t io_rw_16;
+typedef uint64_t absolute_time_t;  // microseconds
+
+enum { PICO_OK = 0, PICO_ERROR_GENERIC = -1, PICO_ERROR_TIMEOUT = -2 };
+#define hard_assert(x) assert(x)
+
+#define PICO_DEFAULT_I2C 0
+#define PICO_DEFAULT_I2C_SDA_PIN 4
+#define PICO_DEFAULT_I2C_SCL_PIN 5
+#define PICO_DEFAULT_SPI_RX_PIN 16
+#define PICO_DEFAULT_SPI_TX_PIN 19
+#define PICO_DEFAULT_SPI_SCK_PIN 18
+#define PICO_DEFAULT_SPI_CSN_PIN 17
+#define PICO_DEFAULT_LED_PIN 25
+
+#define NUM_I2CS 2u
+#define NUM_SPIS 2u
+#define NUM_PIOS 3u
+#define NUM_PIO_STATE_MACHINES 4u
+#define NUM_DMA_CHANNELS 16u
+#define NUM_BANK0_GPIOS 48u
+
+/* Time */
+absolute_time_t get_absolute_time();
+inline uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000); }
+uint32_t time_us_32();
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+void tight_loop_contents();
+
+/* Interrupts */
+typedef void (*irq_handler_t)(void);
+enum { DMA_IRQ_0 = 10, DMA_IRQ_1 = 11, I2C0_IRQ = 23, I2C1_IRQ = 24 };
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+uint32_t save_and_disable_interrupts();
+void restore_interrupts(uint32_t status);
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t priority);
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+
+/* GPIO */
+enum gpio_function { GPIO_FUNC_SPI = 1, GPIO_FUNC_I2C = 3, GPIO_FUNC_SIO = 5,
+                     GPIO_FUNC_NULL = 0x1f };
+#define GPIO_OUT 1
+#define GPIO_IN 0
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+void gpio_set_function(uint gpio, uint fn);
+inline void gpio_pull_up(uint) {}
+inline void gpio_disable_pulls(uint) {}
+
+/* DMA */
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+typedef struct {
+  uint size;
+  bool read_increment;
+  bool write_increment;
+  uint dreq;
+  uint chain_to;
+} dma_channel_config;
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint channel);
+dma_channel_config dma_channel_get_default_config(uint channel);
+inline void channel_config_set_transfer_data_size(dma_channel_config *c,
+                                                  enum dma_channel_transfer_size size) {
+  c->size = size;
+}
+inline void channel_config_set_read_increment(dma_channel_config *c, bool incr) {
+  c->read_increment = incr;
+}
+inline void channel_config_set_write_increment(dma_channel_config *c, bool incr) {
+  c->write_increment = incr;
+}
+inline void channel_config_set_dreq(dma_channel_config *c, uint dreq) { c->dreq = dreq; }
+inline void channel_config_set_chain_to(dma_channel_config *c, uint chan) {
+  c->chain_to = chan;
+}
+void dma_channel_configure(uint channel, const dma_channel_config *config,
+                           volatile void *write_addr, const volatile void *read_addr,
+                           uint transfer_count, bool trigger);
+void dma_channel_abort(uint channel);
+bool dma_channel_is_busy(uint channel);
+void dma_channel_set_irq0_enabled(uint channel, bool enabled);
+void dma_channel_set_irq1_enabled(uint channel, bool enabled);
+bool dma_channel_get_irq0_status(uint channel);
+bool dma_channel_get_irq1_status(uint channel);
+void dma_channel_acknowledge_irq0(uint channel);
+void dma_channel_acknowledge_irq1(uint channel);
+
+/* SPI */
+typedef struct {
+  io_rw_32 cr0, cr1, dr, sr;
+} spi_hw_t;
+typedef struct spi_inst spi_inst_t;
+spi_inst_t *host_spi_instance(uint index);
+#define spi0 (host_spi_instance(0))
+#define spi1 (host_spi_instance(1))
+typedef enum { SPI_CPOL_0 = 0, SPI_CPOL_1 = 1 } spi_cpol_t;
+typedef enum { SPI_CPHA_0 = 0, SPI_CPHA_1 = 1 } spi_cpha_t;
+typedef enum { SPI_LSB_FIRST = 0, SPI_MSB_FIRST = 1 } spi_order_t;
+uint spi_init(spi_inst_t *spi, uint baudrate);
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha,
+                    spi_order_t order);
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len);
+bool spi_is_busy(const spi_inst_t *spi);
+uint spi_get_index(const spi_inst_t *spi);
+spi_hw_t *spi_get_hw(spi_inst_t *spi);
+uint spi_get_dreq(spi_inst_t *spi, bool is_tx);
+
+/* I2C, the registers the drivers touch */
+typedef struct {
+  io_rw_32 enable, tar, data_cmd, intr_mask, intr_stat;
+  io_rw_32 clr_intr, clr_tx_abrt, clr_stop_det;
+} i2c_hw_t;
+typedef struct i2c_inst i2c_inst_t;
+i2c_inst_t *host_i2c_instance(uint index);
+#define i2c0 (host_i2c_instance(0))
+#define i2c1 (host_i2c_instance(1))
+#define I2C_IC_DATA_CMD_CMD_BITS 0x00000100u
+#define I2C_IC_DATA_CMD_STOP_BITS 0x00000200u
+#define I2C_IC_DATA_CMD_RESTART_BITS 0x00000400u
+#define I2C_IC_INTR_MASK_M_TX_ABRT_BITS 0x00000040u
+#define I2C_IC_INTR_MASK_M_STOP_DET_BITS 0x00000200u
+#define I2C_IC_INTR_STAT_R_TX_ABRT_BITS 0x00000040u
+#define I2C_IC_INTR_STAT_R_STOP_DET_BITS 0x00000200u
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+void i2c_deinit(i2c_inst_t *i2c);
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len,
+                       bool nostop);
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len,
+                      bool nostop);
+uint i2c_get_index(i2c_inst_t *i2c);
+i2c_inst_t *i2c_get_instance(uint index);
+i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c);
+uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx);
+
+/* PIO, declared for the headers that name the types */
+typedef struct pio_hw pio_hw_t;
+typedef pio_hw_t *PIO;
+
+/* Host side, unmangled for ctypes */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief One byte shifted out of an SPI block, with the GPIO outputs as they
+ * were when the byte started and when it ended.
+ */
+typedef struct {
+  uint64_t end_ns;
+  uint8_t spi;
+  uint8_t value;
+  uint64_t gpio_start;
+  uint64_t gpio_end;
+} host_spi_byte_t;
+
+/**
+ * @brief One I2C bus condition or byte. value is the 7-bit address for
+ * HOST_I2C_ADDR, with read set for a read phase.
+ */
+typedef struct {
+  uint64_t ns;
+  uint8_t i2c;
+  uint8_t kind;
+  uint8_t value;
+  uint8_t ack;
+  uint8_t read;
+} host_i2c_event_t;
+
+enum {
+  HOST_I2C_START,
+  HOST_I2C_RESTART,
+  HOST_I2C_ADDR,
+  HOST_I2C_WRITE,
+  HOST_I2C_READ,
+  HOST_I2C_STOP
+};
+
+uint64_t host_now_ns();
+void host_advance_ns(uint64_t ns);
+size_t host_spi_capture(host_spi_byte_t *out, size_t max);
+uint32_t host_spi_resets_while_busy();
+uint32_t host_dma_claimed();
+
+/**
+ * @brief Puts a register file target on an I2C bus. The first byte of a
+ * write sets its register pointer, later bytes and reads go through it.
+ * @return the target's 256 registers
+ */
+uint8_t *host_i2c_add_target(uint index, uint8_t addr);
+
+/**
+ * @brief Makes a target NAK the data byte after the first n of every write,
+ * 0 acks them all.
+ */
+void host_i2c_nak_after(uint index, uint8_t addr, uint32_t n);
+size_t host_i2c_log(host_i2c_event_t *out, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // end _PICO_HOST_H
+/* END OF FILE */
@@ -0,0 +1,24 @@
+/** @file pio_i2c_host.cpp
+ *
+ * @brief PIOI2C entry points for host builds of i2c.cpp.
+ *
+ * @par
+ * The host SDK has no PIO, so an I2C built on a PIOI2C fails every call.
+ * tools/pio_i2c_sim.py covers the PIO program itself.
+ */
+
+#include "pio_i2c.hpp"
+
+int PIOI2C::write_blocking(uint8_t, const uint8_t *, size_t, bool) {
+  return PICO_ERROR_GENERIC;
+}
+
+int PIOI2C::read_blocking(uint8_t, uint8_t *, size_t, bool) { return PICO_ERROR_GENERIC; }
+
+bool PIOI2C::submit(I2CTransfer *) { return false; }
+
+void PIOI2C::lock() {}
+
+void PIOI2C::unlock() {}
+
+/* END OF FILE */
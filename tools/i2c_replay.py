@@ -0,0 +1,376 @@
+#!/usr/bin/env python3
+"""i2c_replay.py
+
+Host check of the I2C DMA engine in i2c/i2c.cpp.
+
+The script builds i2c.cpp against the host SDK model (tools/pico_host.py),
+so the engine under test is the firmware's own: its DMA channels feed a
+model of the DW_apb_i2c command FIFO, and its IRQ handlers run on STOP_DET,
+TX_ABRT and DMA completion. The targets are register files on i2c0, and the
+bus is logged condition by condition. Checks:
+
+  order     callbacks run in submission order with the byte count, the wire
+            carries each transfer whole and in that order, and submit()
+            refuses a transfer once the queue is full
+  chained   a transfer submitted from a completion callback runs to its own
+            callback, alone on the bus or behind queued transfers
+  abort     an address NAK and a data NAK in the middle of a staged run
+            both fail their own transfer with PICO_ERROR_GENERIC, and the
+            next transfer goes out whole, with nothing left over from the
+            aborted one. It runs again with the IRQ held off until the
+            STOP, so TX_ABRT and STOP_DET arrive together. The DMA model
+            raises the channel IRQ on abort, as RP2040-E13 does
+  lock      a blocking call waits for the transfer on the wire and goes out
+            ahead of the queue, and transfers queued under lock() wait for
+            unlock()
+
+It then keeps the queue full of 2-byte writes at 400 kHz and reports the
+transfers per second of simulated time, and the share of it the bus spent
+shifting. The model has no IRQ latency, so any gap comes from the engine.
+
+  i2c_replay.py
+  i2c_replay.py -v
+"""
+
+import argparse
+import ctypes
+import sys
+import tempfile
+
+import pico_host
+
+BAUDRATE = 400000
+I2C_DMA_CHUNK_LEN = 32
+PICO_ERROR_GENERIC = -1
+OLED, EEPROM, ABSENT = 0x3C, 0x50, 0x21
+
+SHIM = r"""
+#include <stdint.h>
+
+#include <vector>
+
+#include "i2c.hpp"
+
+namespace {
+const int XFERS = 256;
+I2C *bus;
+I2CTransfer xfers[XFERS];
+int chained[XFERS];  // transfer a callback submits, -1 for none
+bool chain_ok[XFERS];
+std::vector<int> order;
+
+void on_done(I2CTransfer *xfer, void *ctx) {
+  int id = (int)(intptr_t)ctx;
+  order.push_back(id);
+  if (chained[id] >= 0) chain_ok[chained[id]] = bus->submit(&xfers[chained[id]]);
+}
+}  // namespace
+
+extern "C" {
+void check_new(uint32_t baudrate) {
+  for (int &next : chained) next = -1;
+  bus = new I2C(4, 5, baudrate);
+}
+bool check_write(int id, uint8_t addr, const uint8_t *src, size_t len) {
+  return bus->write_async(&xfers[id], addr, src, len, on_done, (void *)(intptr_t)id);
+}
+bool check_read(int id, uint8_t addr, const uint8_t *reg, uint8_t *dst, size_t len) {
+  return bus->read_async(&xfers[id], addr, reg, dst, len, on_done, (void *)(intptr_t)id);
+}
+void check_chain(int id, int next, uint8_t addr, const uint8_t *src, size_t len) {
+  xfers[next] = {addr, src, len, nullptr, 0, on_done, (void *)(intptr_t)next, false, 0};
+  chained[id] = next;
+}
+bool check_chain_ok(int id) { return chain_ok[id]; }
+bool check_done(int id) { return xfers[id].done; }
+int check_result(int id) { return xfers[id].result; }
+size_t check_order(int *out, size_t max) {
+  for (size_t i = 0; i < order.size() && i < max; ++i) out[i] = order[i];
+  return order.size();
+}
+int check_write_blocking(uint8_t addr, const uint8_t *src, size_t len) {
+  return bus->write_blocking(addr, src, len, false);
+}
+int check_reg_read(uint8_t addr, uint8_t reg) { return bus->reg_read_uint8(addr, reg); }
+void check_lock() { bus->lock(); }
+void check_unlock() { bus->unlock(); }
+bool check_busy() { return bus->is_busy(); }
+void check_irqs(bool enabled) {
+  static uint32_t saved;
+  if (enabled) {
+    restore_interrupts(saved);
+  } else {
+    saved = save_and_disable_interrupts();
+  }
+}
+}
+"""
+
+
+def buf(values):
+    return (ctypes.c_uint8 * max(len(values), 1))(*values)
+
+
+def transactions(events):
+    """Splits a bus log into START .. STOP runs of [addr, read, ack, bytes]"""
+    out, phases = [], None
+    for e in events:
+        if e.kind == pico_host.I2C_START:
+            phases = []
+        elif e.kind == pico_host.I2C_ADDR:
+            phases.append([e.value, bool(e.read), bool(e.ack), []])
+        elif e.kind in (pico_host.I2C_WRITE, pico_host.I2C_READ):
+            phases[-1][3].append(e.value)
+            phases[-1][2] = phases[-1][2] and bool(e.ack)
+        elif e.kind == pico_host.I2C_STOP:
+            out.append([tuple(p[:3]) + (tuple(p[3]),) for p in phases])
+    return out
+
+
+def write_txn(addr, data, ack=True):
+    return [(addr, False, ack, tuple(data))]
+
+
+class Replay:
+    def __init__(self, lib):
+        self.lib = lib
+        self.failures = []
+        self.keep = []
+        self.next_id = 0
+        self.log_mark = 0
+        self.order_mark = 0
+        lib.check_write.restype = ctypes.c_bool
+        lib.check_read.restype = ctypes.c_bool
+        lib.check_chain_ok.restype = ctypes.c_bool
+        lib.check_done.restype = ctypes.c_bool
+        lib.check_busy.restype = ctypes.c_bool
+        lib.check_order.restype = ctypes.c_size_t
+        lib.check_new(BAUDRATE)
+        self.regs = {addr: lib.host_i2c_add_target(0, addr) for addr in (OLED, EEPROM)}
+
+    def fail(self, case, message):
+        self.failures.append("%s: %s" % (case, message))
+
+    def ids(self, n):
+        first = self.next_id
+        self.next_id += n
+        return range(first, first + n)
+
+    def write(self, xid, addr, data):
+        src = buf(data)
+        self.keep.append(src)
+        return self.lib.check_write(xid, addr, src, len(data))
+
+    def wait(self, cond, limit_ns=50000000):
+        end = self.lib.host_now_ns() + limit_ns
+        while not cond() and self.lib.host_now_ns() < end:
+            self.lib.host_advance_ns(10000)
+        return cond()
+
+    def idle(self):
+        return self.wait(lambda: not self.lib.check_busy())
+
+    def stops(self):
+        return sum(e.kind == pico_host.I2C_STOP for e in pico_host.i2c_log(self.lib))
+
+    def writes_since_stop(self):
+        n = 0
+        for e in reversed(pico_host.i2c_log(self.lib)):
+            if e.kind == pico_host.I2C_STOP:
+                break
+            n += e.kind == pico_host.I2C_WRITE
+        return n
+
+    def new_wire(self):
+        events = pico_host.i2c_log(self.lib)
+        out = transactions(events[self.log_mark:])
+        self.log_mark = len(events)
+        return out
+
+    def new_order(self):
+        n = self.lib.check_order(None, 0)
+        out = (ctypes.c_int * max(n, 1))()
+        self.lib.check_order(out, n)
+        order = list(out)[self.order_mark:n]
+        self.order_mark = n
+        return order
+
+    def expect(self, case, xids, results, wire):
+        order = self.new_order()
+        if order != list(xids):
+            self.fail(case, "callbacks ran as %s, submitted as %s" % (order, list(xids)))
+        for xid, result in zip(xids, results):
+            if self.lib.check_result(xid) != result:
+                self.fail(case, "transfer %d returned %d, not %d" % (
+                    xid, self.lib.check_result(xid), result))
+        got = self.new_wire()
+        if got != wire:
+            self.fail(case, "wire differs, %d transactions for %d" % (len(got), len(wire)))
+            for g, w in zip(got, wire):
+                if g != w:
+                    self.fail(case, "first difference %s, expected %s" % (g, w))
+                    break
+
+    def order(self):
+        xids = list(self.ids(10))
+        payloads = [[0x10 + i] + [(7 * i + j) & 0xFF for j in range(i * 11 % 40 + 1)]
+                    for i in range(len(xids))]
+        payloads[3] = [0x00] + [j & 0xFF for j in range(100)]  # several DMA runs
+        accepted = [self.write(x, OLED, p) for x, p in zip(xids, payloads)]
+        # one transfer starts at once and I2C_ASYNC_QUEUE_LEN wait
+        if accepted != [True] * 9 + [False]:
+            self.fail("order", "submit() accepted %s" % accepted)
+        if not self.idle():
+            self.fail("order", "the queue never drained")
+        sent = [p for p, a in zip(payloads, accepted) if a]
+        self.expect("order", xids[:9], [len(p) for p in sent],
+                    [write_txn(OLED, p) for p in sent])
+        regs = [self.regs[OLED][i] for i in range(256)]
+        want = list(regs)
+        for p in sent:
+            want[p[0]:p[0] + len(p) - 1] = p[1:]
+        if regs != want[:256]:
+            self.fail("order", "the target holds different bytes")
+
+        xid = self.ids(1)[0]
+        for i in range(6):
+            self.regs[EEPROM][0x40 + i] = 0xA0 + i
+        reg, dst = buf([0x40]), buf([0] * 6)
+        self.keep += [reg, dst]
+        self.lib.check_read(xid, EEPROM, reg, dst, 6)
+        self.idle()
+        self.expect("order", [xid], [7], [[(EEPROM, False, True, (0x40,)),
+                                           (EEPROM, True, True, tuple(range(0xA0, 0xA6)))]])
+        if list(dst) != list(range(0xA0, 0xA6)):
+            self.fail("order", "read_async() returned %s" % list(dst))
+
+    def chained(self):
+        # alone on the bus: the callback's submit() starts the next transfer
+        a, b = self.ids(2)
+        data_b = [0x20, 1, 2, 3]
+        self.keep.append(buf(data_b))
+        self.lib.check_chain(a, b, OLED, self.keep[-1], len(data_b))
+        self.write(a, OLED, [0x10, 9])
+        if not self.wait(lambda: self.lib.check_done(b)):
+            self.fail("chained", "the transfer submitted from a callback never finished")
+        self.idle()
+        if not self.lib.check_chain_ok(b):
+            self.fail("chained", "submit() from the callback failed")
+        self.expect("chained", [a, b], [2, 4],
+                    [write_txn(OLED, [0x10, 9]), write_txn(OLED, data_b)])
+
+        # behind queued transfers: it joins the end of the queue
+        a, b, c, d = self.ids(4)
+        self.keep.append(buf([0x30, 4]))
+        self.lib.check_chain(a, d, OLED, self.keep[-1], 2)
+        for xid, data in ((a, [0x10, 1]), (b, [0x11, 2]), (c, [0x12, 3])):
+            self.write(xid, OLED, data)
+        if not self.wait(lambda: self.lib.check_done(d)):
+            self.fail("chained", "the chained transfer behind the queue never finished")
+        self.idle()
+        self.expect("chained", [a, b, c, d], [2, 2, 2, 2],
+                    [write_txn(OLED, d) for d in ([0x10, 1], [0x11, 2], [0x12, 3],
+                                                  [0x30, 4])])
+
+    def abort(self):
+        for late in (False, True):
+            case = "late abort" if late else "abort"
+            a, b, c = self.ids(3)
+            long_write = [0x00] + [(3 * j) & 0xFF for j in range(100)]
+            after = [0x40] + list(range(70))  # more than one DMA run
+            self.lib.host_i2c_nak_after(0, EEPROM, 40)
+            self.write(a, ABSENT, [0x00, 1, 2])
+            self.write(b, EEPROM, long_write)
+            self.write(c, OLED, after)
+            if late:
+                # from b's second DMA run, which holds the NAK, until its STOP
+                stops = self.stops()
+                self.wait(lambda: self.writes_since_stop() > I2C_DMA_CHUNK_LEN)
+                self.lib.check_irqs(False)
+                self.wait(lambda: self.stops() > stops + 1)
+                self.lib.check_irqs(True)
+            self.idle()
+            self.lib.host_i2c_nak_after(0, EEPROM, 0)
+            self.expect(case, [a, b, c],
+                        [PICO_ERROR_GENERIC, PICO_ERROR_GENERIC, len(after)],
+                        [[(ABSENT, False, False, ())],
+                         write_txn(EEPROM, long_write[:41], ack=False),
+                         write_txn(OLED, after)])
+
+    def lock(self):
+        # a blocking call goes out between the transfer on the wire and the queue
+        a, b = self.ids(2)
+        self.write(a, OLED, [0x10] + list(range(30)))
+        self.write(b, OLED, [0x11, 1])
+        data = buf([0x50, 0xEE])
+        if self.lib.check_write_blocking(OLED, data, 2) != 2:
+            self.fail("lock", "write_blocking() failed")
+        self.idle()
+        self.expect("lock", [a, b], [31, 2], [write_txn(OLED, [0x10] + list(range(30))),
+                                             write_txn(OLED, [0x50, 0xEE]),
+                                             write_txn(OLED, [0x11, 1])])
+
+        # under lock(), the queue waits until unlock()
+        c = self.ids(1)[0]
+        self.lib.check_lock()
+        self.write(c, OLED, [0x12, 2])
+        self.lib.host_advance_ns(2000000)
+        if self.lib.check_done(c) or self.new_wire():
+            self.fail("lock", "a transfer went out under lock()")
+        self.regs[EEPROM][0x07] = 0x5A
+        if self.lib.check_reg_read(EEPROM, 0x07) != 0x5A:
+            self.fail("lock", "reg_read_uint8() under lock() read the wrong value")
+        self.lib.check_unlock()
+        self.idle()
+        self.expect("lock", [c], [2], [write_txn(EEPROM, [0x07]),
+                                       [(EEPROM, True, True, (0x5A,))],
+                                       write_txn(OLED, [0x12, 2])])
+
+    def throughput(self, n):
+        xids = list(self.ids(n))
+        start = self.lib.host_now_ns()
+        for i, xid in enumerate(xids):
+            while not self.write(xid, OLED, [0x40, i & 0xFF]):
+                self.lib.host_advance_ns(1000)
+        self.idle()
+        elapsed = self.lib.host_now_ns() - start
+        self.expect("throughput", xids, [2] * n,
+                    [write_txn(OLED, [0x40, i & 0xFF]) for i in range(n)])
+        # START, address, 2 bytes and STOP
+        bus_ns = n * (1 + 9 + 2 * 9 + 1) * 1e9 / BAUDRATE
+        return n * 1e9 / elapsed, bus_ns / elapsed
+
+
+def run(lib, verbose):
+    replay = Replay(lib)
+    for case in (replay.order, replay.chained, replay.abort, replay.lock):
+        case()
+        # a blocking call would wait forever on a transfer that never ends
+        if lib.check_busy():
+            replay.fail(case.__name__, "the engine is stuck with a transfer in flight")
+            return replay.failures
+    rate, load = replay.throughput(200)
+    if lib.host_dma_claimed() != 2:
+        replay.fail("dma", "%d channels claimed, not 2" % lib.host_dma_claimed())
+    if verbose or not replay.failures:
+        print("throughput: %.0f transfers/s of 2 bytes at %d kHz, %.0f%% of the bus" % (
+            rate, BAUDRATE // 1000, 100 * load))
+    return replay.failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Replay the I2C DMA engine")
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as workdir:
+        lib = pico_host.build(workdir, ["i2c/i2c.cpp"], SHIM, "i2c")
+        failures = run(lib, args.verbose)
+    for failure in failures:
+        print("FAIL " + failure)
+    print("ok" if not failures else "%d failed" % len(failures))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
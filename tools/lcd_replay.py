@@ -0,0 +1,361 @@
+#!/usr/bin/env python3
+"""lcd_replay.py
+
+Host check of the I2C LCD driver (lcd/i2c_lcd/i2c_lcd.cpp) against a fake
+I2C bus and a model of the PCF8574 backpack and HD44780 controller.
+
+The script builds i2c_lcd.cpp with the host C++ compiler ($CXX, default c++)
+into a shared library, so the driver under test is the firmware's own. The
+Pico SDK headers are replaced by small stubs and I2C by a fake with the same
+ordering rules as the real one:
+
+  async     write_async() transfers queue and go out one at a time, in
+            submission order; they complete as simulated time passes,
+            which is advanced by every get_absolute_time() and
+            tight_loop_contents() call, the way the DMA IRQ would
+  blocking  write_blocking() waits for the transfer on the wire and then
+            goes out at once, ahead of anything still queued
+
+Every byte is timed at 400 kHz (nine bit times, plus START, address and
+STOP per transfer). The PCF8574 outputs are decoded on the falling edge of E
+into nibbles and instructions, which are replayed into DDRAM and CGRAM.
+Checks:
+
+  text      DDRAM holds the strings printed, wrapped and overwritten
+  cgram     put_custom_char() stores its 8 rows, which also runs the
+            transfer ring around twice without a command in between
+  busy      no instruction reaches the controller before the previous
+            one has finished (37 us, 1.52 ms for clear and home)
+  ring      no transfer or buffer is resubmitted while still queued or on
+            the wire
+  backlight the backlight change goes out after characters still queued
+
+  lcd_replay.py
+  lcd_replay.py -v
+"""
+
+import argparse
+import ctypes
+import os
+import subprocess
+import sys
+import tempfile
+
+REPO = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+MASK_RS, MASK_E = 0x01, 0x04
+SHORT_NS, LONG_NS = 37000, 1520000  # HD44780 execution times
+
+STUB = r"""
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+typedef unsigned int uint;
+typedef struct i2c_inst i2c_inst_t;
+typedef uint64_t absolute_time_t;
+enum { PICO_OK = 0, PICO_ERROR_GENERIC = -1 };
+enum { GPIO_FUNC_NULL = 0x1f };
+#define PICO_DEFAULT_I2C 0
+#define PICO_DEFAULT_I2C_SDA_PIN 4
+#define PICO_DEFAULT_I2C_SCL_PIN 5
+#define PICO_DEFAULT_SPI_TX_PIN 19
+#define PICO_DEFAULT_SPI_RX_PIN 16
+#define PICO_DEFAULT_SPI_SCK_PIN 18
+#define PICO_DEFAULT_SPI_CSN_PIN 17
+absolute_time_t get_absolute_time();
+inline uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000); }
+void tight_loop_contents();
+inline void i2c_deinit(i2c_inst_t *) {}
+inline void gpio_disable_pulls(uint) {}
+inline void gpio_set_function(uint, uint) {}
+"""
+
+SHIM = r"""
+#include <deque>
+#include <vector>
+
+#include "i2c_lcd.hpp"
+
+namespace {
+const uint64_t BIT_NS = 2500;  // 400 kHz
+const uint64_t TICK_NS = 100;  // per polled time read
+
+uint64_t now_ns = 0;
+std::vector<uint64_t> wire_t;
+std::vector<uint8_t> wire_v;
+std::deque<I2CTransfer *> queue;
+I2CTransfer *active = nullptr;
+uint64_t active_end = 0;
+int reused = 0, async_count = 0, blocking_count = 0;
+I2CLCD *lcd = nullptr;
+
+/* START, address and ACK, each byte and its ACK, STOP. A PCF8574 output
+ * changes at the ACK of its byte. */
+uint64_t put_on_wire(uint64_t t, const uint8_t *src, size_t len) {
+  t += 10 * BIT_NS;
+  for (size_t i = 0; i < len; ++i) {
+    t += 9 * BIT_NS;
+    wire_t.push_back(t);
+    wire_v.push_back(src[i]);
+  }
+  return t + BIT_NS;
+}
+
+void finish_active() {
+  active->result = (int)active->src_len;
+  active->done = true;
+  active = nullptr;
+}
+
+void service() {
+  now_ns += TICK_NS;
+  if (active && now_ns >= active_end) finish_active();
+  if (!active && !queue.empty()) {
+    active = queue.front();
+    queue.pop_front();
+    active_end = put_on_wire(now_ns, active->src, active->src_len);
+  }
+}
+
+bool in_flight(const I2CTransfer *xfer, const uint8_t *src) {
+  if (active && (active == xfer || active->src == src)) return true;
+  for (I2CTransfer *q : queue) {
+    if (q == xfer || q->src == src) return true;
+  }
+  return false;
+}
+}  // namespace
+
+absolute_time_t get_absolute_time() {
+  service();
+  return now_ns / 1000;
+}
+
+void tight_loop_contents() { service(); }
+
+void I2C::init() {}
+
+bool I2C::write_async(I2CTransfer *xfer, uint8_t addr, const uint8_t *src, size_t len,
+                      i2c_callback_t callback, void *ctx) {
+  if (in_flight(xfer, src)) ++reused;
+  xfer->done = false;
+  if (queue.size() == I2C_ASYNC_QUEUE_LEN) return false;
+  xfer->addr = addr;
+  xfer->src = src;
+  xfer->src_len = len;
+  xfer->dst = nullptr;
+  xfer->dst_len = 0;
+  xfer->callback = callback;
+  xfer->ctx = ctx;
+  queue.push_back(xfer);
+  ++async_count;
+  return true;
+}
+
+int I2C::write_blocking(uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+  /* the bus lock waits for the transfer on the wire only */
+  if (active) {
+    if (now_ns < active_end) now_ns = active_end;
+    finish_active();
+  }
+  now_ns = put_on_wire(now_ns, src, len);
+  ++blocking_count;
+  return (int)len;
+}
+
+extern "C" {
+void check_new(uint8_t rows, uint8_t cols) { lcd = new I2CLCD(rows, cols); }
+void check_delete() {
+  delete lcd;
+  lcd = nullptr;
+}
+void check_put_str(char *str) { lcd->put_str(str); }
+void check_write_data(uint8_t data) { lcd->write_data(data); }
+void check_move(uint8_t x, uint8_t y) { lcd->move_cursor_to(x, y); }
+void check_clear() { lcd->clear(); }
+void check_backlight(bool on) { lcd->backlight(on); }
+void check_custom_char(uint8_t location, uint8_t *map) {
+  lcd->put_custom_char(location, map);
+}
+size_t check_wire(uint64_t *t, uint8_t *v, size_t max) {
+  for (size_t i = 0; i < wire_v.size() && i < max; ++i) {
+    t[i] = wire_t[i];
+    v[i] = wire_v[i];
+  }
+  return wire_v.size();
+}
+uint64_t check_now() { return now_ns; }
+void check_stats(int *out) {
+  out[0] = reused;
+  out[1] = async_count;
+  out[2] = blocking_count;
+}
+}
+"""
+
+
+def build(workdir):
+    for header in ("pico/stdlib.h", "hardware/dma.h", "hardware/gpio.h", "hardware/i2c.h",
+                   "hardware/irq.h"):
+        path = os.path.join(workdir, header)
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, "w") as f:
+            f.write(STUB)
+    shim = os.path.join(workdir, "shim.cpp")
+    lib = os.path.join(workdir, "lcd.so")
+    with open(shim, "w") as f:
+        f.write(SHIM)
+    src = os.path.join(REPO, "lcd", "i2c_lcd")
+    subprocess.check_call([os.environ.get("CXX", "c++"), "-std=c++17", "-O2", "-shared",
+                           "-fPIC", "-w", "-I" + workdir, "-I" + src, shim,
+                           os.path.join(src, "i2c_lcd.cpp"), "-o", lib])
+    lib = ctypes.CDLL(lib)
+    lib.check_wire.restype = ctypes.c_size_t
+    lib.check_now.restype = ctypes.c_uint64
+    return lib
+
+
+class HD44780:
+    """PCF8574 outputs in, DDRAM and CGRAM out"""
+
+    def __init__(self):
+        self.eight_bit, self.high = True, None
+        self.ddram, self.cgram = [0x20] * 128, [0] * 64
+        self.ac, self.to_cgram = 0, False
+        self.e, self.busy_until = 0, 0
+        self.errors = []
+
+    def feed(self, t, value):
+        e = value & MASK_E
+        if self.e and not e:
+            self.latch(t, value & MASK_RS, value >> 4)
+        self.e = e
+
+    def latch(self, t, rs, nibble):
+        if self.eight_bit:
+            self.execute(t, 0, nibble << 4)  # D3-D0 are not wired
+        elif self.high is None:
+            self.high = nibble
+        else:
+            value, self.high = self.high << 4 | nibble, None
+            self.execute(t, rs, value)
+
+    def execute(self, t, rs, value):
+        if t < self.busy_until:
+            self.errors.append("%s 0x%02x at %.1f us, %.1f us early" % (
+                "data" if rs else "command", value, t / 1e3, (self.busy_until - t) / 1e3))
+        busy = SHORT_NS
+        if rs:
+            if self.to_cgram:
+                self.cgram[self.ac & 0x3f] = value
+                self.ac = (self.ac + 1) & 0x3f
+            else:
+                self.ddram[self.ac] = value
+                self.ac = (self.ac + 1) & 0x7f
+        elif value & 0x80:
+            self.ac, self.to_cgram = value & 0x7f, False
+        elif value & 0x40:
+            self.ac, self.to_cgram = value & 0x3f, True
+        elif value & 0x20:
+            self.eight_bit = bool(value & 0x10)
+        elif value == 0x01:
+            self.ddram, self.ac, self.to_cgram = [0x20] * 128, 0, False
+            busy = LONG_NS
+        elif value & 0xfe == 0x02:
+            self.ac, self.to_cgram = 0, False
+            busy = LONG_NS
+        self.busy_until = t + busy
+
+    def row(self, y, cols):
+        base = (0x40 if y & 1 else 0) + (cols if y & 2 else 0)
+        return bytes(self.ddram[base:base + cols]).decode("latin-1")
+
+
+class Session:
+    def __init__(self, lib, rows, cols):
+        self.lib, self.rows, self.cols = lib, rows, cols
+        self.model, self.fed = HD44780(), 0
+        self.last = 0
+        lib.check_new(rows, cols)
+
+    def sync(self):
+        """Feeds the wire bytes captured since the last call to the model"""
+        n = self.lib.check_wire(None, None, 0)
+        t, v = (ctypes.c_uint64 * n)(), (ctypes.c_uint8 * n)()
+        self.lib.check_wire(t, v, n)
+        for i in range(self.fed, n):
+            self.model.feed(t[i], v[i])
+        self.fed = n
+        self.last = v[n - 1] if n else 0
+
+    def rows_now(self):
+        self.sync()
+        return [self.model.row(y, self.cols) for y in range(self.rows)]
+
+
+def run(lib, verbose):
+    failures = []
+    s = Session(lib, 2, 16)
+    blank = " " * 16
+
+    def expect(name, rows):
+        got = s.rows_now()
+        if got != rows:
+            failures.append("text %s: %s, want %s" % (name, got, rows))
+
+    expect("init", [blank, blank])
+    start = lib.check_now()
+    s.lib.check_put_str(b"Hello, world")
+    expect("print", ["Hello, world    ", blank])
+    lib.check_move(0, 1)
+    s.lib.check_put_str(b"0123456789ABCDEF")
+    s.lib.check_put_str(b"Hi")
+    expect("wrap", ["Hillo, world    ", "0123456789ABCDEF"])
+    chars, elapsed = 30, lib.check_now() - start
+
+    glyph = (ctypes.c_uint8 * 8)(0x00, 0x0a, 0x1f, 0x1f, 0x0e, 0x04, 0x00, 0x15)
+    lib.check_custom_char(1, glyph)
+    s.sync()
+    if s.model.cgram[8:16] != list(glyph):
+        failures.append("cgram: %s" % s.model.cgram[8:16])
+
+    s.lib.check_put_str(b"!")
+    for c in b"abc":
+        lib.check_write_data(c)  # queued, no command behind them
+    lib.check_backlight(False)
+    expect("queued", ["Hi!abc world    ", "0123456789ABCDEF"])
+    if s.last != 0x00:
+        failures.append("backlight: last byte 0x%02x, not after the queued data" % s.last)
+    lib.check_clear()
+    s.lib.check_put_str(b"ok")
+    expect("clear", ["ok" + " " * 14, blank])
+    lib.check_delete()
+
+    failures += ["busy: " + e for e in s.model.errors]
+    stats = (ctypes.c_int * 3)()
+    lib.check_stats(stats)
+    if stats[0]:
+        failures.append("ring: %d transfers resubmitted while in flight" % stats[0])
+    if verbose:
+        print("%d async and %d blocking transfers, %d wire bytes" % (stats[1], stats[2],
+                                                                   s.fed))
+        print("%d characters in %.1f ms" % (chars, elapsed / 1e6))
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Replay the I2C LCD driver")
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as workdir:
+        lib = build(workdir)
+        failures = run(lib, args.verbose)
+    for failure in failures:
+        print("FAIL " + failure)
+    print("ok" if not failures else "%d failed" % len(failures))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
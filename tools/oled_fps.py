@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""oled_fps.py
+
+Frames per second of the SSD1306 flush paths against a simulated I2C bus.
+
+The bus model is byte accurate: START and STOP cost one SCL period each, and
+every byte, address included, costs nine (eight data bits and the ACK).
+Every transfer also pays a fixed software overhead, which is the call and
+the FIFO hand-off in the blocking driver or the DMA/IRQ hand-off in the
+async one. Times are reported in microseconds and in clk_sys cycles.
+
+Paths:
+
+  byte     the original show(): one 2 byte transfer per command and per
+           pixel byte, each with its own 0x00 / 0x40 control byte
+  page     OLED::show(): per page, the 6 window commands as one 0x00
+           prefixed transfer, then the page as one 0x40 prefixed burst
+  present  OLED::present(): one window command transfer and the whole
+           frame as a single DMA burst
+
+init() is compared the same way, 22 command bytes one per transfer against one
+command stream. Add --check to assert that the burst paths move the same
+pixel bytes as the byte path and are faster for every listed bus clock.
+
+  oled_fps.py --size 128x64 --baud 100000 400000 1000000
+"""
+
+import argparse
+import sys
+
+START_STOP_BITS = 2
+BITS_PER_BYTE = 9
+WINDOW_CMDS = 6  # SET_COL_ADDR x0 x1 SET_PAGE_ADDR p0 p1
+INIT_CMDS = 22   # OLED::init() command bytes
+
+
+class Bus:
+    """Accumulates the wire time of a sequence of write transfers."""
+
+    def __init__(self, baud, overhead_us):
+        self.baud = baud
+        self.overhead_us = overhead_us
+        self.transfers = 0
+        self.bytes = 0
+        self.us = 0.0
+
+    def write(self, payload):
+        bits = START_STOP_BITS + (payload + 1) * BITS_PER_BYTE  # + address
+        self.transfers += 1
+        self.bytes += payload + 1
+        self.us += bits * 1e6 / self.baud + self.overhead_us
+
+
+def frame_byte(bus, width, pages):
+    pixels = 0
+    for _ in range(pages):
+        for _ in range(WINDOW_CMDS):
+            bus.write(2)
+        for _ in range(width):
+            bus.write(2)
+            pixels += 1
+    return pixels
+
+
+def frame_page(bus, width, pages):
+    for _ in range(pages):
+        bus.write(1 + WINDOW_CMDS)
+        bus.write(1 + width)
+    return width * pages
+
+
+def frame_present(bus, width, pages):
+    bus.write(1 + WINDOW_CMDS)
+    bus.write(1 + width * pages)
+    return width * pages
+
+
+def init_byte(bus):
+    for _ in range(INIT_CMDS):
+        bus.write(2)
+
+
+def init_stream(bus):
+    bus.write(1 + INIT_CMDS)
+
+
+PATHS = (("byte", frame_byte), ("page", frame_page), ("present", frame_present))
+
+
+def measure(path, width, pages, baud, overhead_us):
+    bus = Bus(baud, overhead_us)
+    pixels = path(bus, width, pages)
+    return bus, pixels
+
+
+def parse_size(text):
+    try:
+        width, height = (int(v) for v in text.lower().split("x"))
+    except ValueError:
+        raise argparse.ArgumentTypeError("expected WIDTHxHEIGHT, got " + text)
+    if height % 8 or not 0 < height <= 64 or not 0 < width <= 128:
+        raise argparse.ArgumentTypeError("unsupported panel " + text)
+    return width, height
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare SSD1306 flush paths")
+    parser.add_argument("--size", type=parse_size, default=(128, 64))
+    parser.add_argument("--baud", type=int, nargs="+", default=[400000],
+                        help="I2C clock(s) in Hz")
+    parser.add_argument("--overhead", type=float, default=15.0,
+                        help="software overhead per transfer in us")
+    parser.add_argument("--clk-sys", type=int, default=125000000,
+                        help="system clock in Hz, for the cycle column")
+    parser.add_argument("--check", action="store_true")
+    args = parser.parse_args()
+
+    width, height = args.size
+    pages = height // 8
+    ok = True
+    for baud in args.baud:
+        print("%dx%d, %d Hz, %.1f us per transfer:" % (width, height, baud,
+                                                      args.overhead))
+        print("  %-8s %9s %9s %12s %14s %8s" % ("path", "transfers", "bytes",
+                                                 "frame us", "cycles", "fps"))
+        results = {}
+        for name, path in PATHS:
+            bus, pixels = measure(path, width, pages, baud, args.overhead)
+            results[name] = (bus.us, pixels)
+            print("  %-8s %9d %9d %12.1f %14d %8.1f" % (
+                name, bus.transfers, bus.bytes, bus.us,
+                int(bus.us * args.clk_sys / 1e6), 1e6 / bus.us))
+
+        slow, fast = Bus(baud, args.overhead), Bus(baud, args.overhead)
+        init_byte(slow)
+        init_stream(fast)
+        print("  init     %9.1f us one per transfer, %.1f us as one stream" % (
+            slow.us, fast.us))
+
+        if args.check:
+            base_us, base_pixels = results["byte"]
+            for name in ("page", "present"):
+                us, pixels = results[name]
+                if pixels != base_pixels or us >= base_us:
+                    print("  FAIL %s: %d pixel bytes in %.1f us" % (name, pixels, us))
+                    ok = False
+            if fast.us >= slow.us:
+                print("  FAIL init stream is not faster")
+                ok = False
+    if args.check:
+        print("ok" if ok else "check failed")
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""panel_sim.py
+
+Host simulation of PanelSet (ssd1306/panel.hpp) driving several SSD1306
+panels over the RP2040's two I2C blocks. Every panel is assumed to have a new
+frame ready at all times, so the result is the best case frame rate the
+scheduling policy can reach for a given layout and bus clock.
+
+A frame is the 7 byte window command followed by one control byte plus the
+panel's buffer, as sent by OLED::present(). Each byte costs 9 SCL periods, and
+each transfer adds its address byte, start, stop and a fixed software
+overhead for the DMA/IRQ hand-off.
+
+Panels are given as BUS:WIDTHxHEIGHT, e.g.
+
+  panel_sim.py 0:128x64 0:128x32 1:128x64 1:128x32 --baud 1000000
+
+The run is repeated with every panel on i2c0 for comparison.
+"""
+
+import argparse
+import sys
+
+WINDOW_CMD_BYTES = 7  # control byte + SET_COL_ADDR/SET_PAGE_ADDR window
+START_STOP_BITS = 2
+
+
+def transfer_us(payload, baud, overhead_us):
+    bits = (payload + 1) * 9 + START_STOP_BITS  # + address byte
+    return bits * 1e6 / baud + overhead_us
+
+
+def frame_us(width, height, baud, overhead_us):
+    buff = width * (height // 8)
+    return transfer_us(WINDOW_CMD_BYTES, baud, overhead_us) + transfer_us(
+        buff + 1, baud, overhead_us
+    )
+
+
+def simulate(panels, baud, overhead_us, seconds):
+    """Round robin per bus, one frame in flight per bus, like PanelSet::tick()."""
+    frames = [0] * len(panels)
+    for bus in sorted({p[0] for p in panels}):
+        members = [i for i, p in enumerate(panels) if p[0] == bus]
+        t = 0.0
+        turn = 0
+        while True:
+            i = members[turn % len(members)]
+            cost = frame_us(panels[i][1], panels[i][2], baud, overhead_us)
+            if t + cost > seconds * 1e6:
+                break
+            t += cost
+            frames[i] += 1
+            turn += 1
+    return [f / seconds for f in frames]
+
+
+def parse_panel(text):
+    try:
+        bus, geometry = text.split(":")
+        width, height = geometry.lower().split("x")
+        bus, width, height = int(bus), int(width), int(height)
+    except ValueError:
+        raise argparse.ArgumentTypeError("expected BUS:WIDTHxHEIGHT, got " + text)
+    if bus not in (0, 1) or height % 8 or not 0 < height <= 64 or not 0 < width <= 128:
+        raise argparse.ArgumentTypeError("unsupported panel " + text)
+    return bus, width, height
+
+
+def report(title, panels, fps):
+    print(title)
+    for (bus, width, height), rate in zip(panels, fps):
+        print("  i2c%d %3dx%-2d %8.1f fps" % (bus, width, height, rate))
+    print("  aggregate   %8.1f fps" % sum(fps))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulate PanelSet flush throughput")
+    parser.add_argument("panels", nargs="+", type=parse_panel)
+    parser.add_argument("--baud", type=int, default=400000, help="I2C clock in Hz")
+    parser.add_argument("--overhead", type=float, default=15.0,
+                        help="software overhead per transfer in us")
+    parser.add_argument("--seconds", type=float, default=10.0)
+    args = parser.parse_args()
+
+    fps = simulate(args.panels, args.baud, args.overhead, args.seconds)
+    report("PanelSet, %d Hz:" % args.baud, args.panels, fps)
+
+    if len({p[0] for p in args.panels}) > 1:
+        single = [(0, w, h) for _, w, h in args.panels]
+        report("All on i2c0:", single, simulate(single, args.baud, args.overhead,
+                                                 args.seconds))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,77 @@
+"""pico_host.py
+
+Builds driver sources on the host against the simulated SDK in tools/host.
+
+Every SDK header the drivers include is written into a scratch directory
+as a one-line include of tools/host/pico_host.h. The sources, a check's own
+shim and tools/host/pico_host.cpp are then compiled with the host C++
+compiler ($CXX, default c++) into a shared library for ctypes. A build of
+i2c/i2c.cpp also links tools/host/pio_i2c_host.cpp in place of the PIO bus.
+"""
+
+import ctypes
+import os
+import subprocess
+
+REPO = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+HOST = os.path.join(REPO, "tools", "host")
+
+HEADERS = ("pico/stdlib.h", "hardware/clocks.h", "hardware/dma.h", "hardware/gpio.h",
+           "hardware/i2c.h", "hardware/irq.h", "hardware/pio.h", "hardware/spi.h",
+           "hardware/sync.h")
+
+
+class HostSpiByte(ctypes.Structure):
+    _fields_ = [("end_ns", ctypes.c_uint64), ("spi", ctypes.c_uint8),
+                ("value", ctypes.c_uint8), ("gpio_start", ctypes.c_uint64),
+                ("gpio_end", ctypes.c_uint64)]
+
+
+class HostI2cEvent(ctypes.Structure):
+    _fields_ = [("ns", ctypes.c_uint64), ("i2c", ctypes.c_uint8), ("kind", ctypes.c_uint8),
+                ("value", ctypes.c_uint8), ("ack", ctypes.c_uint8), ("read", ctypes.c_uint8)]
+
+
+# host_i2c_event_t kinds
+I2C_START, I2C_RESTART, I2C_ADDR, I2C_WRITE, I2C_READ, I2C_STOP = range(6)
+
+
+def build(workdir, sources, shim, name="host"):
+    """sources are paths relative to the repo root"""
+    for header in HEADERS:
+        path = os.path.join(workdir, "include", header)
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, "w") as f:
+            f.write('#include "pico_host.h"\n')
+    shim_path = os.path.join(workdir, name + "_shim.cpp")
+    with open(shim_path, "w") as f:
+        f.write(shim)
+    lib = os.path.join(workdir, name + ".so")
+    dirs = {os.path.dirname(os.path.join(REPO, s)) for s in sources}
+    subprocess.check_call(
+        [os.environ.get("CXX", "c++"), "-std=c++17", "-O2", "-shared", "-fPIC", "-w",
+         "-I" + os.path.join(workdir, "include"), "-I" + HOST] +
+        ["-I" + d for d in sorted(dirs)] +
+        [shim_path, os.path.join(HOST, "pico_host.cpp")] +
+        ([os.path.join(HOST, "pio_i2c_host.cpp")] if "i2c/i2c.cpp" in sources else []) +
+        [os.path.join(REPO, s) for s in sources] + ["-o", lib])
+    lib = ctypes.CDLL(lib)
+    lib.host_now_ns.restype = ctypes.c_uint64
+    lib.host_spi_capture.restype = ctypes.c_size_t
+    lib.host_i2c_log.restype = ctypes.c_size_t
+    lib.host_i2c_add_target.restype = ctypes.POINTER(ctypes.c_uint8)
+    return lib
+
+
+def spi_capture(lib):
+    n = lib.host_spi_capture(None, 0)
+    out = (HostSpiByte * n)()
+    lib.host_spi_capture(out, n)
+    return list(out)
+
+
+def i2c_log(lib):
+    n = lib.host_i2c_log(None, 0)
+    out = (HostI2cEvent * n)()
+    lib.host_i2c_log(out, n)
+    return list(out)
@@ -0,0 +1,563 @@
+#!/usr/bin/env python3
+"""pio_i2c_sim.py
+
+Host assembler and bit-level simulator for the PIO I2C master
+(i2c/pio_i2c.pio, i2c/pio_i2c.cpp).
+
+The assembler handles the subset of pioasm the program uses (.program,
+.side_set N opt pindirs, labels, public labels, .wrap_target / .wrap and the
+jmp, wait, in, out, set, irq and nop instructions) and checks the result
+against the instruction listing pioasm generates for the pico-examples
+program this one derives from.
+
+The simulator runs the assembled program one PIO clock at a time: delays,
+side-set, autopull at 16 bits, autopush at 8 bits, OUT EXEC, the stall on
+IRQ WAIT and the inverted-OE pin setup from PIOI2C's constructor. SDA and
+SCL are open drain and shared with a simulated target, a register device
+that ACKs its address, drives read data and can stretch SCL while it
+fetches each read byte. A bus monitor decodes START, STOP, bytes and ACK
+bits from the line levels.
+
+The host side replays the TX record streams PIOI2C builds for START,
+repeated START, STOP, write_blocking() and read_blocking(), including the
+recovery after a NAK. Checks:
+
+  words     assembled program equals the pico-examples listing
+  write     register write, every byte ACKed, STOP after
+  read      pointer write with nostop, repeated START, read of 4 bytes
+            with the last one NAKed; the ISR is left full by the write, so
+            this also covers the PUSH in PIOI2C::rx_enable()
+  stretch   the same transfers with the target stretching SCL
+  nak       a missing target raises the SM IRQ, the SM halts, and the
+            driver's recovery leaves both lines released
+  timing    32 PIO clocks per SCL period within a byte, without stretching
+
+  pio_i2c_sim.py
+  pio_i2c_sim.py --listing
+"""
+
+import argparse
+import os
+import re
+import sys
+
+REPO = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# pioasm output for pico-examples pio/i2c/i2c.pio
+REFERENCE = [0x008c, 0xc030, 0xe027, 0x6781, 0xba42, 0x24a1, 0x4701, 0x1743, 0x6781,
+             0xbf42, 0x27a1, 0x12c0, 0x6026, 0x6041, 0x0022, 0x6060, 0x60f0, 0x0050]
+
+# TX record fields, as pio_i2c.cpp
+ICOUNT_LSB, FINAL_LSB, DATA_LSB, NAK_LSB = 10, 9, 1, 0
+
+JMP_COND = {"": 0, "!x": 1, "x--": 2, "!y": 3, "y--": 4, "x!=y": 5, "pin": 6, "!osre": 7}
+IN_SRC = {"pins": 0, "x": 1, "y": 2, "null": 3, "isr": 6, "osr": 7}
+OUT_DST = {"pins": 0, "x": 1, "y": 2, "null": 3, "pindirs": 4, "pc": 5, "isr": 6,
+           "exec": 7}
+SET_DST = {"pins": 0, "x": 1, "y": 2, "pindirs": 4}
+WAIT_SRC = {"gpio": 0, "pin": 1, "irq": 2}
+
+
+class Program:
+    def __init__(self, words, labels, public, wrap_target, wrap, sideset_bits):
+        self.words, self.labels, self.public = words, labels, public
+        self.wrap_target, self.wrap = wrap_target, wrap
+        self.sideset_bits = sideset_bits  # including the opt enable bit
+
+
+def assemble(path):
+    lines = []
+    with open(path) as f:
+        for raw in f:
+            line = raw.split(";")[0].strip()
+            if line:
+                lines.append(line)
+
+    sideset, opt = 0, False
+    labels, public, body = {}, set(), []
+    wrap_target, wrap = 0, None
+    for line in lines:
+        if line.startswith(".program"):
+            continue
+        if line.startswith(".side_set"):
+            parts = line.split()
+            sideset, opt = int(parts[1]), "opt" in parts[2:]
+            continue
+        if line == ".wrap_target":
+            wrap_target = len(body)
+            continue
+        if line == ".wrap":
+            wrap = len(body) - 1
+            continue
+        match = re.match(r"(public\s+)?(\w+):$", line)
+        if match:
+            labels[match.group(2)] = len(body)
+            if match.group(1):
+                public.add(match.group(2))
+            continue
+        body.append(line)
+    if wrap is None:
+        wrap = len(body) - 1
+
+    bits = sideset + (1 if opt else 0)
+    words = []
+    for line in body:
+        delay = 0
+        match = re.search(r"\[(\d+)\]$", line)
+        if match:
+            delay = int(match.group(1))
+            line = line[:match.start()].strip()
+        side = None
+        match = re.search(r"\bside\s+(\d+)$", line)
+        if match:
+            side = int(match.group(1))
+            line = line[:match.start()].strip()
+        if delay >= 1 << (5 - bits):
+            raise SystemExit("delay too long: " + line)
+
+        op, _, rest = line.partition(" ")
+        args = [a.strip() for a in rest.replace(",", " ").split()]
+        if op == "jmp":
+            cond = args[0] if len(args) == 2 else ""
+            word = (0 << 13) | (JMP_COND[cond] << 5) | labels[args[-1]]
+        elif op == "wait":
+            polarity, source, index = int(args[0]), WAIT_SRC[args[1]], int(args[2])
+            word = (1 << 13) | (polarity << 7) | (source << 5) | index
+        elif op == "in":
+            word = (2 << 13) | (IN_SRC[args[0]] << 5) | (int(args[1]) & 31)
+        elif op == "out":
+            word = (3 << 13) | (OUT_DST[args[0]] << 5) | (int(args[1]) & 31)
+        elif op == "nop":
+            word = (5 << 13) | (2 << 5) | 2  # mov y, y
+        elif op == "irq":
+            wait = "wait" in args
+            index = int([a for a in args if a.isdigit()][0])
+            index |= 0x10 if "rel" in args else 0
+            word = (6 << 13) | (int(wait) << 5) | index
+        elif op == "set":
+            word = (7 << 13) | (SET_DST[args[0]] << 5) | int(args[1], 0)
+        else:
+            raise SystemExit("unsupported instruction: " + line)
+
+        field = delay
+        if side is not None:
+            field |= side << (5 - bits)
+            if opt:
+                field |= 1 << 4
+        words.append(word | (field << 8))
+    return Program(words, labels, public, wrap_target, wrap, bits)
+
+
+def encode_set_pindirs(value):
+    return (7 << 13) | (SET_DST["pindirs"] << 5) | value
+
+
+def scl_sda(scl, sda):
+    """pio_i2c.cpp: set pindirs, sda side scl [7]"""
+    return encode_set_pindirs(sda) | (0x1000 | scl << 11) | (7 << 8)
+
+
+START = [1 << ICOUNT_LSB, scl_sda(1, 0), scl_sda(0, 0)]
+REPSTART = [3 << ICOUNT_LSB, scl_sda(0, 1), scl_sda(1, 1), scl_sda(1, 0), scl_sda(0, 0)]
+STOP = [2 << ICOUNT_LSB, scl_sda(0, 0), scl_sda(1, 0), scl_sda(1, 1)]
+
+
+class StateMachine:
+    """One PIO state machine wired as PIOI2C configures it"""
+
+    FIFO_DEPTH = 4
+
+    def __init__(self, program):
+        self.p = program
+        self.pc = program.labels["entry_point"]
+        self.x = self.y = 0
+        self.osr, self.osr_count = 0, 32  # empty, the first OUT pulls
+        self.isr, self.isr_count = 0, 0
+        self.delay = 0
+        self.exec_pending = None
+        self.tx, self.rx = [], []
+        self.autopush = False
+        self.irq = False
+        self.tx_stall = False
+        self.sda_dir = self.scl_dir = 1  # released
+
+    def put(self, record):
+        # halfword write: the record lands in both halves of the FIFO word
+        self.tx.append(record << 16 | record)
+
+    def step(self, sda, scl):
+        self.tx_stall = False
+        if self.delay:
+            self.delay -= 1
+            return
+        if self.exec_pending is not None:
+            word, from_exec = self.exec_pending, True
+        else:
+            word, from_exec = self.p.words[self.pc], False
+        field = (word >> 8) & 0x1f
+        bits = self.p.sideset_bits
+        if field & 0x10:  # opt side-set enable, applies even if the SM stalls
+            self.scl_dir = (field >> (5 - bits)) & 1
+        delay = field & ((1 << (5 - bits)) - 1)
+
+        op, arg1, arg2 = word >> 13, (word >> 5) & 7, word & 31
+        jump = None
+        if op == 0:
+            take = {0: True, 1: self.x == 0, 2: self.x != 0, 3: self.y == 0,
+                    4: self.y != 0, 5: self.x != self.y, 6: sda == 1,
+                    7: self.osr_count < 16}[arg1]
+            if arg1 == 2:
+                self.x = (self.x - 1) & 0xffffffff
+            if arg1 == 4:
+                self.y = (self.y - 1) & 0xffffffff
+            if take:
+                jump = arg2
+        elif op == 1:
+            polarity, index = (word >> 7) & 1, word & 31
+            level = (sda, scl)[index]
+            if level != polarity:
+                return
+        elif op == 2:
+            count = arg2 or 32
+            self.isr = ((self.isr << count) | (sda & ((1 << count) - 1))) & 0xffffffff
+            self.isr_count = min(32, self.isr_count + count)
+            if self.autopush and self.isr_count >= 8:
+                if len(self.rx) >= self.FIFO_DEPTH:
+                    return
+                self.rx.append(self.isr & 0xff)
+                self.isr, self.isr_count = 0, 0
+        elif op == 3:
+            if self.osr_count >= 16:  # autopull threshold
+                if not self.tx:
+                    self.tx_stall = True
+                    return
+                self.osr, self.osr_count = self.tx.pop(0), 0
+            count = arg2 or 32
+            data = self.osr >> (32 - count)
+            self.osr = (self.osr << count) & 0xffffffff
+            self.osr_count = min(32, self.osr_count + count)
+            if arg1 == OUT_DST["x"]:
+                self.x = data
+            elif arg1 == OUT_DST["y"]:
+                self.y = data
+            elif arg1 == OUT_DST["pindirs"]:
+                self.sda_dir = data & 1
+            elif arg1 == OUT_DST["exec"]:
+                self.exec_pending = data & 0xffff
+                self.advance(None, from_exec)
+                return
+        elif op == 6:
+            if not self.irq:
+                self.irq = True
+            if (word >> 5) & 1 and self.irq:
+                return  # halted until software clears the flag
+        elif op == 7:
+            if arg1 == SET_DST["pindirs"]:
+                self.sda_dir = arg2 & 1
+            elif arg1 == SET_DST["x"]:
+                self.x = arg2
+            elif arg1 == SET_DST["y"]:
+                self.y = arg2
+        self.delay = delay
+        self.advance(jump, from_exec)
+
+    def advance(self, jump, from_exec):
+        if from_exec:
+            self.exec_pending = None
+            if jump is not None:
+                self.pc = jump
+            return
+        if jump is not None:
+            self.pc = jump
+        elif self.pc == self.p.wrap:
+            self.pc = self.p.wrap_target
+        else:
+            self.pc += 1
+
+    def push(self):
+        """exec'd PUSH NOBLOCK: ISR to RX, ISR and its shift count cleared"""
+        if len(self.rx) < self.FIFO_DEPTH:
+            self.rx.append(self.isr & 0xff)
+        self.isr, self.isr_count = 0, 0
+
+    def idle(self):
+        """FDEBUG TXSTALL: blocked on autopull with nothing queued"""
+        return self.tx_stall and not self.tx and self.exec_pending is None
+
+    def recover(self):
+        """PIOI2C::recover(): drain TX, jump to the entry point, clear IRQ"""
+        self.tx = []
+        self.pc = self.p.labels["entry_point"]
+        self.delay = 0
+        self.exec_pending = None
+        self.osr_count = 32
+        self.irq = False
+
+
+class Target:
+    """Register device: first written byte is the pointer"""
+
+    def __init__(self, address, regs, stretch=0):
+        self.address, self.regs, self.stretch = address, regs, stretch
+        self.sda_drive = self.scl_hold = 0
+        self.state = "idle"
+        self.bit, self.shift = 0, 0
+        self.pointer = None
+        self.tx_byte, self.master_ack = 0, True
+        self.rose = False
+
+    def start(self):
+        self.state, self.bit, self.shift = "addr", 0, 0
+        self.pointer_written = False
+        self.sda_drive = self.scl_hold = 0
+        self.rose = False  # the SCL fall right after START is not a clock
+
+    def stop(self):
+        self.state, self.sda_drive = "idle", 0
+
+    def rise(self, sda):
+        self.rose = True
+        if self.state in ("addr", "write") and self.bit < 8:
+            self.shift = (self.shift << 1) | sda
+        elif self.state == "read" and self.bit == 8:
+            self.master_ack = sda == 0
+
+    def fall(self):
+        if self.state == "idle" or not self.rose:
+            return
+        self.rose = False
+        self.bit += 1
+        if self.bit == 8:
+            if self.state == "addr":
+                if self.shift >> 1 != self.address:
+                    self.state = "idle"
+                    return
+                self.mode = "read" if self.shift & 1 else "write"
+                self.sda_drive = 1  # ACK
+            elif self.state == "write":
+                if self.pointer is None or not self.pointer_written:
+                    self.pointer = self.shift
+                    self.pointer_written = True
+                else:
+                    self.regs[self.pointer] = self.shift
+                    self.pointer += 1
+                self.sda_drive = 1
+            else:
+                self.sda_drive = 0  # the master ACKs
+        elif self.bit == 9:
+            self.bit, self.shift = 0, 0
+            if self.state == "addr":
+                self.state = self.mode
+            if self.state == "read":
+                if self.mode == "read" and not self.master_ack:
+                    self.state, self.sda_drive = "idle", 0
+                    return
+                self.tx_byte = self.regs.get(self.pointer, 0)
+                self.pointer += 1
+                self.drive_bit()
+                self.scl_hold = self.stretch  # fetching the byte
+            else:
+                self.sda_drive = 0
+            self.master_ack = True
+        elif self.state == "read":
+            self.drive_bit()
+
+    def drive_bit(self):
+        self.sda_drive = 0 if (self.tx_byte >> (7 - self.bit)) & 1 else 1
+
+
+class Monitor:
+    """Decodes the bus into S / Sr / P markers and (byte, ack) pairs"""
+
+    def __init__(self):
+        self.events, self.bits, self.active = [], [], False
+        self.rises, self.byte_rises = [], []
+
+    def edge(self, t, prev, now):
+        (psda, pscl), (sda, scl) = prev, now
+        if pscl and scl and psda and not sda:
+            self.events.append("Sr" if self.active else "S")
+            self.active, self.bits, self.byte_rises = True, [], []
+        elif pscl and scl and not psda and sda:
+            self.events.append("P")
+            self.active = False
+        elif not pscl and scl:
+            if self.active:
+                self.bits.append(sda)
+                self.byte_rises.append(t)
+                if len(self.bits) == 9:
+                    self.rises.append(self.byte_rises)
+                    self.byte_rises = []
+                    byte = 0
+                    for b in self.bits[:8]:
+                        byte = byte << 1 | b
+                    self.events.append((byte, "A" if self.bits[8] == 0 else "N"))
+                    self.bits = []
+
+
+class Bus:
+    def __init__(self, program, target, limit=200000):
+        self.sm, self.target, self.mon = StateMachine(program), target, Monitor()
+        self.t, self.limit = 0, limit
+        self.levels = (1, 1)
+
+    def lines(self):
+        sda = int(self.sm.sda_dir == 1 and not self.target.sda_drive)
+        scl = int(self.sm.scl_dir == 1 and not self.target.scl_hold)
+        return sda, scl
+
+    def cycle(self):
+        sda, scl = self.levels
+        self.sm.step(sda, scl)
+        if self.target.scl_hold:
+            self.target.scl_hold -= 1
+        now = self.lines()
+        self.observe(self.levels, now)
+        after = self.lines()  # the target reacts within the cycle
+        if after != now:
+            self.observe(now, after)
+        self.levels = after
+        self.t += 1
+
+    def observe(self, prev, now):
+        (psda, pscl), (sda, scl) = prev, now
+        self.mon.edge(self.t, prev, now)
+        if pscl and scl and psda and not sda:
+            self.target.start()
+        elif pscl and scl and not psda and sda:
+            self.target.stop()
+        elif not pscl and scl:
+            self.target.rise(sda)
+        elif pscl and not scl:
+            self.target.fall()
+
+    def run(self, records, rx_wanted=0):
+        """Feeds records as the FIFO drains, like PIOI2C::put(); returns RX"""
+        pending, got = list(records), []
+        while self.t < self.limit:
+            while pending and len(self.sm.tx) < StateMachine.FIFO_DEPTH:
+                self.sm.put(pending.pop(0))
+            while self.sm.rx:
+                got.append(self.sm.rx.pop(0))
+            if self.sm.irq:
+                return None
+            if not pending and self.sm.idle() and len(got) >= rx_wanted:
+                return got
+            self.cycle()
+        raise SystemExit("simulation did not finish")
+
+
+class Driver:
+    """The blocking half of PIOI2C, record for record"""
+
+    def __init__(self, bus):
+        self.bus, self.held = bus, False
+
+    def recover_and_stop(self):
+        self.bus.sm.recover()
+        self.bus.run(STOP)
+        self.held = False
+
+    def write(self, addr, data, nostop=False):
+        self.bus.sm.autopush = False
+        records = list(REPSTART if self.held else START)
+        records.append((addr << 2) | 1)
+        records += [(b << DATA_LSB) | (1 << NAK_LSB) for b in data]
+        if not nostop:
+            records += STOP
+        if self.bus.run(records) is None:
+            self.recover_and_stop()
+            return -1
+        self.held = nostop
+        return len(data)
+
+    def read(self, addr, length, nostop=False):
+        self.bus.sm.autopush = True  # rx_enable(true)
+        self.bus.sm.push()
+        self.bus.sm.rx = []
+        records = list(REPSTART if self.held else START)
+        records.append((addr << 2) | 3)
+        for i in range(length):
+            last = (1 << FINAL_LSB) | (1 << NAK_LSB) if i == length - 1 else 0
+            records.append((0xff << DATA_LSB) | last)
+        if not nostop:
+            records += STOP
+        got = self.bus.run(records, rx_wanted=length + 1)
+        if got is None:
+            self.recover_and_stop()
+            return None
+        self.held = nostop
+        return got[1:]  # the address byte comes back first
+
+
+def check(program, stretch):
+    failures = []
+    regs = {0x10 + i: 0xa0 + i for i in range(8)}
+    bus = Bus(program, Target(0x28, regs, stretch))
+    driver = Driver(bus)
+
+    driver.write(0x28, [0x16, 0x5a, 0xc3])
+    want = ["S", (0x50, "A"), (0x16, "A"), (0x5a, "A"), (0xc3, "A"), "P"]
+    if bus.mon.events != want:
+        failures.append("write: %s" % bus.mon.events)
+    if regs.get(0x16) != 0x5a or regs.get(0x17) != 0xc3:
+        failures.append("write: target registers %s" % regs)
+    if bus.levels != (1, 1):
+        failures.append("write: bus not released after STOP")
+
+    bus.mon.events = []
+    driver.write(0x28, [0x10], nostop=True)
+    data = driver.read(0x28, 4)
+    want = ["S", (0x50, "A"), (0x10, "A"), "Sr", (0x51, "A"), (0xa0, "A"), (0xa1, "A"),
+            (0xa2, "A"), (0xa3, "N"), "P"]
+    if bus.mon.events != want:
+        failures.append("read: %s" % bus.mon.events)
+    if data != [0xa0, 0xa1, 0xa2, 0xa3]:
+        failures.append("read: returned %s" % data)
+
+    if not stretch:
+        periods = {b - a for rises in bus.mon.rises for a, b in zip(rises, rises[1:])}
+        if periods != {32}:
+            failures.append("timing: SCL periods %s PIO clocks" % sorted(periods))
+
+    bus.mon.events = []
+    if driver.write(0x33, [0x00]) != -1:
+        failures.append("nak: write to a missing target succeeded")
+    if bus.mon.events[:2] != ["S", (0x66, "N")] or bus.mon.events[-1] != "P":
+        failures.append("nak: %s" % bus.mon.events)
+    if bus.sm.irq or bus.levels != (1, 1):
+        failures.append("nak: bus not recovered")
+    if driver.write(0x28, [0x14, 0x77]) != 2 or regs.get(0x14) != 0x77:
+        failures.append("nak: next write after recovery failed")
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Assemble and simulate pio_i2c.pio")
+    parser.add_argument("--listing", action="store_true", help="print the words")
+    args = parser.parse_args()
+
+    program = assemble(os.path.join(REPO, "i2c", "pio_i2c.pio"))
+    if args.listing:
+        for i, word in enumerate(program.words):
+            mark = " <- wrap_target" if i == program.wrap_target else ""
+            mark += " <- wrap" if i == program.wrap else ""
+            print("  0x%04x, // %2d%s" % (word, i, mark))
+        print("entry_point = %d" % program.labels["entry_point"])
+
+    failures = []
+    if program.words != REFERENCE:
+        failures.append("words: assembled program differs from the reference listing")
+    if (program.wrap_target, program.wrap, program.labels["entry_point"]) != (12, 17, 12):
+        failures.append("words: wrap or entry point moved")
+    for stretch in (0, 40):
+        failures += ["stretch %d %s" % (stretch, f) for f in check(program, stretch)]
+
+    for failure in failures:
+        print("FAIL " + failure)
+    print("ok" if not failures else "%d failed" % len(failures))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
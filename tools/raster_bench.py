@@ -0,0 +1,247 @@
+#!/usr/bin/env python3
+"""raster_bench.py
+
+Host micro-benchmark of the SSD1306 span and word kernels against the
+per-pixel drawing path they replaced.
+
+The script builds ssd1306.cpp and raster.cpp against the host SDK model
+(tools/pico_host.py) with a transport that drops every byte, so the new
+path is the firmware's own OLED methods. Next to it the shim compiles the
+old path: every primitive a loop of draw_pixel(), with a bounds check, a
+divide and a modulo per pixel, and draw_bitmap() reading one bit at a time.
+Both run the same workloads on a 128x64 panel:
+
+  clear        clear_buffer()
+  hline        64 full-width draw_fast_hline(), one per row
+  vline        128 full-height draw_fast_vline(), one per column
+  fill         draw_filled_rectangle(3, 5, 120, 50)
+  bitmap       draw_bitmap() of a 64x48 image at (5, 3)
+  page bitmap  the same image, pre-transposed, through draw_page_bitmap()
+
+Each workload must leave both buffers identical before it is timed. Times
+are host nanoseconds per call and only the ratios carry over to the
+RP2040, where the divide and modulo cost more than they do here. The host
+compiler turns the old clear loop into memset, and draw_bitmap() still
+transposes bit by bit, so those two rows stay close. draw_page_bitmap() is
+the fast path for images.
+
+  raster_bench.py
+  raster_bench.py --reps 20000
+"""
+
+import argparse
+import ctypes
+import sys
+import tempfile
+
+import pico_host
+
+SOURCES = ["ssd1306/ssd1306.cpp", "ssd1306/raster.cpp", "ssd1306/glyph_cache.cpp",
+           "ssd1306/oled_transport.cpp", "i2c/i2c.cpp"]
+WORKLOADS = ["clear", "hline", "vline", "fill", "bitmap", "page bitmap"]
+
+SHIM = r"""
+#include <stdint.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "ssd1306.hpp"
+
+namespace {
+class NullTransport : public OLEDTransport {
+ public:
+  void write_cmds(const uint8_t *, uint16_t) override {}
+  void write_data(const uint8_t *, uint16_t) override {}
+  bool write_frame_async(const uint8_t *, uint8_t, uint8_t *, uint16_t,
+                         oled_flush_cb_t done, void *ctx) override {
+    if (done) done(ctx);
+    return true;
+  }
+  bool is_busy() override { return false; }
+  uint8_t get_bus() override { return 0; }
+};
+
+/* The drawing code before the span kernels, as it was in OLED */
+class PixelPath {
+ public:
+  uint8_t buffer[128 * 8];
+
+  void clear_buffer() {
+    for (uint16_t i = 0; i < buff_size; ++i) {
+      buffer[i] = 0x0000;
+    }
+    invalidate();
+  }
+
+  void draw_pixel(uint8_t x, uint8_t y) {
+    if (x < width && y < height) {
+      buffer[x + width * (y / 8)] |= 0x01 << (y % 8);
+      mark_dirty(y / 8, x, x);
+    }
+  }
+
+  void draw_fast_hline(uint8_t x, uint8_t y, uint8_t width) {
+    for (uint8_t i = 0; i < width; ++i) {
+      draw_pixel(x + i, y);
+    }
+  }
+
+  void draw_fast_vline(uint8_t x, uint8_t y, uint8_t height) {
+    for (uint8_t i = 0; i < height; ++i) {
+      draw_pixel(x, y + i);
+    }
+  }
+
+  void draw_filled_rectangle(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
+    for (uint8_t i = 0; i < height; ++i) {
+      draw_fast_hline(x, y + i, width);
+    }
+  }
+
+  void draw_bitmap(uint8_t x, uint8_t y, uint8_t width, uint8_t height,
+                   const uint8_t *img) {
+    for (uint8_t i = 0; i < height; ++i) {
+      for (uint8_t j = 0; j < width; ++j) {
+        bool value = bit_read(img[i * ((width - 1) / 8 + 1) + j / 8], 7 - j % 8);
+        if (value) draw_pixel(x + j, y + i);
+      }
+    }
+  }
+
+ private:
+  uint8_t width = 128;
+  uint8_t height = 64;
+  uint8_t pages = 8;
+  uint16_t buff_size = 128 * 8;
+  uint8_t dirty_start[8];
+  uint8_t dirty_end[8];
+
+  static bool bit_read(uint8_t character, uint8_t index) {
+    return bool((character >> index) & 0x01);
+  }
+
+  void invalidate() {
+    for (uint8_t page = 0; page < pages; ++page) {
+      dirty_start[page] = 0;
+      dirty_end[page] = width - 1;
+    }
+  }
+
+  void mark_dirty(uint8_t page, uint8_t x_start, uint8_t x_end) {
+    if (dirty_start[page] == OLED_PAGE_CLEAN) {
+      dirty_start[page] = x_start;
+      dirty_end[page] = x_end;
+      return;
+    }
+    if (x_start < dirty_start[page]) dirty_start[page] = x_start;
+    if (x_end > dirty_end[page]) dirty_end[page] = x_end;
+  }
+};
+
+const uint8_t IMG_W = 64, IMG_H = 48;
+NullTransport transport;
+OLED *oled;
+PixelPath pixels;
+uint8_t image[IMG_H * IMG_W / 8];      // row-major, MSB first
+uint8_t page_image[IMG_H / 8 * IMG_W];  // page-ordered, LSB at the top
+
+template <typename Path>
+void draw(Path *path, int workload) {
+  switch (workload) {
+    case 0:
+      path->clear_buffer();
+      break;
+    case 1:
+      for (uint8_t y = 0; y < 64; ++y) path->draw_fast_hline(0, y, 128);
+      break;
+    case 2:
+      for (uint8_t x = 0; x < 128; ++x) path->draw_fast_vline(x, 0, 64);
+      break;
+    case 3:
+      path->draw_filled_rectangle(3, 5, 120, 50);
+      break;
+    case 4:
+      path->draw_bitmap(5, 3, IMG_W, IMG_H, image);
+      break;
+  }
+}
+
+void draw_new(int workload) {
+  if (workload == 5) {
+    oled->draw_page_bitmap(5, 3, IMG_W, IMG_H, page_image);
+  } else {
+    draw(oled, workload);
+  }
+}
+
+void draw_old(int workload) { draw(&pixels, workload == 5 ? 4 : workload); }
+}  // namespace
+
+extern "C" {
+void bench_new() {
+  oled = new OLED(&transport, 64, 128, false);
+  for (int y = 0; y < IMG_H; ++y) {
+    for (int x = 0; x < IMG_W; ++x) {
+      if (((x * 7) ^ (y * 13)) % 5 > 1) continue;
+      image[y * (IMG_W / 8) + x / 8] |= 0x80 >> (x % 8);
+      page_image[(y / 8) * IMG_W + x] |= 1 << (y % 8);
+    }
+  }
+}
+
+/* both paths from a cleared buffer, 1 if they drew the same pixels */
+int bench_same(int workload) {
+  oled->clear_buffer();
+  pixels.clear_buffer();
+  if (workload == 0) memset(oled->get_buffer(), 0xA5, 128 * 8);
+  if (workload == 0) memset(pixels.buffer, 0xA5, 128 * 8);
+  draw_new(workload);
+  draw_old(workload);
+  return memcmp(oled->get_buffer(), pixels.buffer, 128 * 8) == 0;
+}
+
+/* nanoseconds per call */
+double bench_time(int workload, int old_path, int reps) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < reps; ++i) {
+    if (old_path) {
+      draw_old(workload);
+    } else {
+      draw_new(workload);
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / reps;
+}
+}
+"""
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Time the raster kernels against "
+                                     "the per-pixel path")
+    parser.add_argument("--reps", type=int, default=5000, help="calls per workload")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as workdir:
+        lib = pico_host.build(workdir, SOURCES, SHIM, "bench")
+        lib.bench_time.restype = ctypes.c_double
+        lib.bench_new()
+        failures = [w for i, w in enumerate(WORKLOADS) if not lib.bench_same(i)]
+        print("%-12s %12s %12s %8s" % ("workload", "per-pixel ns", "kernel ns", "speedup"))
+        for i, workload in enumerate(WORKLOADS):
+            if workload in failures:
+                continue
+            old = lib.bench_time(i, 1, args.reps)
+            new = lib.bench_time(i, 0, args.reps)
+            print("%-12s %12.0f %12.0f %7.1fx" % (workload, old, new, old / new))
+    for workload in failures:
+        print("FAIL %s: the kernels and the per-pixel path drew different pixels" %
+              workload)
+    print("ok" if not failures else "%d failed" % len(failures))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+"""raster_check.py
+
+Host check of the line, circle and clear kernels in ssd1306/raster.cpp.
+
+The script builds raster.cpp with the host C++ compiler ($CXX, default c++)
+into a shared library and draws into page-ordered framebuffers through
+ctypes, so the code under test is the firmware's own. Each image is compared
+against a reference computed from the ideal geometry:
+
+  line            one pixel per step along the major axis, both endpoints
+                  set, and no pixel further than half a pixel from the ideal
+                  segment
+  circle          eightfold symmetric about the centre, one pixel per row of
+                  each octant, no pixel further than half a pixel from the
+                  radius
+  filled circle   each row is one solid span, as wide as the outline on
+                  that row
+  clipping        a shape that leaves the panel matches the same shape drawn
+                  on a larger canvas and cropped
+  clear           exactly len bytes are zeroed for every len, including the
+                  ones that are not a whole number of words
+
+Add --dump DIR to write the reference sheets as PBM images.
+
+  raster_check.py
+  raster_check.py --dump /tmp/raster
+"""
+
+import argparse
+import ctypes
+import math
+import os
+import subprocess
+import sys
+import tempfile
+
+REPO = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+WIDTH, HEIGHT = 128, 64
+BIG, MARGIN = 248, 64  # clip reference canvas, panel placed at MARGIN
+
+SHIM = r"""
+#include "raster.hpp"
+extern "C" {
+void check_line(uint8_t *b, uint8_t w, uint8_t h, int x0, int y0, int x1, int y1) {
+  raster_line(b, w, h, x0, y0, x1, y1);
+}
+void check_circle(uint8_t *b, uint8_t w, uint8_t h, int xc, int yc, int r) {
+  raster_circle(b, w, h, xc, yc, r);
+}
+void check_filled_circle(uint8_t *b, uint8_t w, uint8_t h, int xc, int yc, int r) {
+  raster_filled_circle(b, w, h, xc, yc, r);
+}
+void check_clear(uint8_t *b, uint16_t len) { raster_clear(b, len); }
+}
+"""
+
+
+def build(workdir):
+    shim = os.path.join(workdir, "shim.cpp")
+    lib = os.path.join(workdir, "raster.so")
+    with open(shim, "w") as f:
+        f.write(SHIM)
+    src = os.path.join(REPO, "ssd1306")
+    subprocess.check_call([os.environ.get("CXX", "c++"), "-std=c++17", "-O2", "-shared",
+                           "-fPIC", "-I" + src, shim, os.path.join(src, "raster.cpp"),
+                           "-o", lib])
+    return ctypes.CDLL(lib)
+
+
+class Canvas:
+    def __init__(self, lib, width, height):
+        self.lib, self.width, self.height = lib, width, height
+        self.buf = (ctypes.c_uint8 * (width * height // 8))()
+
+    def draw(self, kernel, *args):
+        getattr(self.lib, "check_" + kernel)(self.buf, self.width, self.height, *args)
+        return self
+
+    def pixels(self):
+        out = set()
+        for page in range(self.height // 8):
+            for x in range(self.width):
+                byte = self.buf[page * self.width + x]
+                for bit in range(8):
+                    if byte >> bit & 1:
+                        out.add((x, page * 8 + bit))
+        return out
+
+
+def check_line(pixels, x0, y0, x1, y1):
+    if (x0, y0) not in pixels or (x1, y1) not in pixels:
+        return "endpoint missing"
+    steep = abs(y1 - y0) > abs(x1 - x0)
+    major = (lambda p: p[1]) if steep else (lambda p: p[0])
+    minor = (lambda p: p[0]) if steep else (lambda p: p[1])
+    a0, a1 = major((x0, y0)), major((x1, y1))
+    b0, b1 = minor((x0, y0)), minor((x1, y1))
+    if len(pixels) != abs(a1 - a0) + 1:
+        return "%d pixels for %d steps" % (len(pixels), abs(a1 - a0) + 1)
+    seen = set()
+    for p in pixels:
+        a, b = major(p), minor(p)
+        if not min(a0, a1) <= a <= max(a0, a1) or a in seen:
+            return "pixel %s off the major axis run" % (p,)
+        seen.add(a)
+        ideal = b0 if a1 == a0 else b0 + (b1 - b0) * (a - a0) / (a1 - a0)
+        if abs(b - ideal) > 0.5:
+            return "pixel %s is %.2f px off the segment" % (p, abs(b - ideal))
+    return None
+
+
+def check_circle(pixels, xc, yc, r):
+    rel = {(x - xc, y - yc) for x, y in pixels}
+    for x, y in rel:
+        for mx, my in ((x, -y), (-x, y), (y, x)):
+            if (mx, my) not in rel:
+                return "not symmetric at %s" % ((x + xc, y + yc),)
+        if abs(math.hypot(x, y) - r) > 0.5:
+            return "pixel %s is %.2f px off the radius" % (
+                (x + xc, y + yc), abs(math.hypot(x, y) - r))
+    octant = [(x, y) for x, y in rel if x >= y >= 0]
+    rows = [y for _, y in octant]
+    if sorted(rows) != list(range(len(rows))):
+        return "octant rows are not one pixel each"
+    return None
+
+
+def check_filled(filled, outline):
+    rows = {}
+    for x, y in outline:
+        lo, hi = rows.get(y, (x, x))
+        rows[y] = (min(lo, x), max(hi, x))
+    want = {(x, y) for y, (lo, hi) in rows.items() for x in range(lo, hi + 1)}
+    if filled != want:
+        return "%d pixels differ from the outline spans" % len(filled ^ want)
+    return None
+
+
+def crop(pixels):
+    return {(x - MARGIN, y - MARGIN) for x, y in pixels
+            if MARGIN <= x < MARGIN + WIDTH and MARGIN <= y < MARGIN + HEIGHT}
+
+
+LINES = [(0, 0, 127, 63), (127, 63, 0, 0), (0, 63, 127, 0), (10, 5, 20, 60),
+         (20, 60, 10, 5), (64, 32, 64, 32), (5, 5, 100, 5), (7, 0, 7, 63),
+         (0, 0, 63, 63), (63, 0, 0, 63), (30, 10, 31, 50), (3, 40, 120, 41)]
+for angle in range(0, 360, 15):
+    LINES.append((64, 32, 64 + round(30 * math.cos(math.radians(angle))),
+                  32 + round(30 * math.sin(math.radians(angle)))))
+CLIP_LINES = [(-20, -10, 150, 80), (140, 10, -5, 50), (64, -40, 64, 100),
+              (-30, 70, 160, -6), (120, -3, 135, 70)]
+CIRCLES = [(64, 32, r) for r in range(0, 32)]
+CLIP_CIRCLES = [(0, 0, 20), (127, 63, 30), (64, -10, 25), (-5, 32, 12), (100, 70, 40)]
+
+
+def run(lib):
+    failures = []
+
+    def report(name, error):
+        if error:
+            failures.append("%s: %s" % (name, error))
+
+    for x0, y0, x1, y1 in LINES:
+        pixels = Canvas(lib, WIDTH, HEIGHT).draw("line", x0, y0, x1, y1).pixels()
+        report("line %s" % ((x0, y0, x1, y1),), check_line(pixels, x0, y0, x1, y1))
+    for x0, y0, x1, y1 in CLIP_LINES:
+        pixels = Canvas(lib, WIDTH, HEIGHT).draw("line", x0, y0, x1, y1).pixels()
+        big = Canvas(lib, BIG, BIG).draw("line", x0 + MARGIN, y0 + MARGIN,
+                                         x1 + MARGIN, y1 + MARGIN).pixels()
+        report("clipped line %s" % ((x0, y0, x1, y1),),
+               check_line(big, x0 + MARGIN, y0 + MARGIN, x1 + MARGIN, y1 + MARGIN)
+               or (None if pixels == crop(big) else "differs from the cropped line"))
+    for xc, yc, r in CIRCLES:
+        outline = Canvas(lib, WIDTH, HEIGHT).draw("circle", xc, yc, r).pixels()
+        filled = Canvas(lib, WIDTH, HEIGHT).draw("filled_circle", xc, yc, r).pixels()
+        report("circle r=%d" % r, check_circle(outline, xc, yc, r))
+        report("filled circle r=%d" % r, check_filled(filled, outline))
+    for xc, yc, r in CLIP_CIRCLES:
+        for kernel in ("circle", "filled_circle"):
+            pixels = Canvas(lib, WIDTH, HEIGHT).draw(kernel, xc, yc, r).pixels()
+            big = Canvas(lib, BIG, BIG).draw(kernel, xc + MARGIN, yc + MARGIN, r).pixels()
+            if pixels != crop(big):
+                report("clipped %s %s" % (kernel, (xc, yc, r)),
+                       "differs from the cropped shape")
+    for length in range(24):
+        buf = (ctypes.c_uint8 * 32)(*([0xFF] * 32))
+        lib.check_clear(buf, length)
+        if list(buf) != [0] * length + [0xFF] * (32 - length):
+            report("clear %d bytes" % length, "cleared %d bytes" % list(buf).count(0))
+    return failures
+
+
+def write_pbm(path, pixels):
+    with open(path, "w") as f:
+        f.write("P1\n%d %d\n" % (WIDTH, HEIGHT))
+        for y in range(HEIGHT):
+            f.write(" ".join("1" if (x, y) in pixels else "0" for x in range(WIDTH)))
+            f.write("\n")
+
+
+def dump(lib, directory):
+    os.makedirs(directory, exist_ok=True)
+    sheets = {"lines": Canvas(lib, WIDTH, HEIGHT), "circles": Canvas(lib, WIDTH, HEIGHT),
+              "filled": Canvas(lib, WIDTH, HEIGHT)}
+    for line in LINES + CLIP_LINES:
+        sheets["lines"].draw("line", *line)
+    for xc, yc, r in CIRCLES[::4] + CLIP_CIRCLES:
+        sheets["circles"].draw("circle", xc, yc, r)
+    for xc, yc, r in CLIP_CIRCLES:
+        sheets["filled"].draw("filled_circle", xc, yc, r)
+    for name, canvas in sheets.items():
+        write_pbm(os.path.join(directory, name + ".pbm"), canvas.pixels())
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the raster kernels")
+    parser.add_argument("--dump", metavar="DIR", help="write PBM reference sheets")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as workdir:
+        lib = build(workdir)
+        failures = run(lib)
+        if args.dump:
+            dump(lib, args.dump)
+    for failure in failures:
+        print("FAIL " + failure)
+    print("%d lines, %d circles: %s" % (len(LINES) + len(CLIP_LINES),
+                                        len(CIRCLES) + len(CLIP_CIRCLES),
+                                        "ok" if not failures else "%d failed" %
+                                        len(failures)))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,383 @@
+#!/usr/bin/env python3
+"""transport_replay.py
+
+Host check that the I2C and SPI SSD1306 transports (ssd1306/oled_transport.cpp,
+ssd1306/spi_transport.cpp) carry the same command and data stream.
+
+A fixed OLED session (init(), a few show() calls with partial dirty windows,
+then present()) is framed the way each transport puts it on the wire:
+
+  I2C   one transfer per write_cmds() / write_data(), led by the 0x00 or
+        0x40 control byte; write_frame_async() is the window command
+        transfer followed by the 0x40-led frame transfer
+  SPI   the DC pin level latched with every byte under CS; the window
+        commands go out with DC low, the frame by DMA with DC high
+
+Both captures are decoded back to (dc, byte) streams, which must be byte
+identical. The stream is then replayed into a model of the SSD1306 command
+parser and GDDRAM (horizontal addressing, column and page windows), and the
+GDDRAM must equal the framebuffer after every flush. Command and control
+byte values are read from the driver headers.
+
+The shared SPI case builds ssd1306/spi_transport.cpp against the host SDK
+model (tools/pico_host.py) with two panels on one SPI block, each with its
+own CS and D/C pin. Both sessions run interleaved, with background frames
+overlapping the other panel's blocking writes and frames. Every byte the
+block shifts out must have exactly one CS low from its first bit to its
+last, each panel's bytes must decode to its own stream, its GDDRAM must end
+equal to its framebuffer, and the block must never be reset while busy.
+
+  transport_replay.py
+  transport_replay.py --seed 7 --frames 50 -v
+"""
+
+import argparse
+import ctypes
+import os
+import random
+import re
+import sys
+import tempfile
+
+import pico_host
+
+REPO = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# bytes of arguments after each opcode, anything not listed takes none
+ARGS = {"SET_MEM_ADDR": 1, "SET_COL_ADDR": 2, "SET_PAGE_ADDR": 2, "SET_CONTRAST": 1,
+        "SET_MUX_RATIO": 1, "SET_DISP_OFFSET": 1, "SET_COM_PIN_CFG": 1,
+        "SET_DISP_CLK_DIV": 1, "SET_PRECHARGE": 1, "SET_VCOM_DESEL": 1,
+        "SET_CHARGE_PUMP": 1, "SET_HOR_SCROLL": 6, "SET_CONTENT_SCROLL_RIGHT": 6,
+        "SET_CONTENT_SCROLL_LEFT": 6}
+
+
+def constants():
+    """static constexpr uint8_t NAME = value; from the driver headers"""
+    found = {}
+    pattern = re.compile(r"static constexpr uint\w+ (\w+) = (0x[0-9a-fA-F]+|\d+);")
+    for name in ("ssd1306.hpp", "oled_transport.hpp"):
+        with open(os.path.join(REPO, "ssd1306", name)) as f:
+            for key, value in pattern.findall(f.read()):
+                found[key] = int(value, 0)
+    return found
+
+
+class Session:
+    """The OLED side: what the driver hands its transport, as calls."""
+
+    def __init__(self, c, width, height, rng):
+        self.c, self.width, self.pages, self.rng = c, width, height // 8, rng
+        self.buffer = [0] * (width * self.pages)
+        self.calls = []
+
+    def init(self):
+        c = self.c
+        self.calls.append(("cmds", [
+            c["SET_DISP"] | 0x00, c["SET_MEM_ADDR"], 0x00, c["SET_SEG_REMAP"] | 0x01,
+            c["SET_DISP_OFFSET"], 0x00, c["SET_COM_PIN_CFG"],
+            0x12 if self.pages == 8 else 0x02, c["SET_DISP_CLK_DIV"], 0x80,
+            c["SET_PRECHARGE"], 0xF1, c["SET_VCOM_DESEL"], 0x30, c["SET_CONTRAST"],
+            0xFF, c["SET_ENTIRE_ON"], c["SET_NORM_INV"], c["SET_CHARGE_PUMP"], 0x14,
+            c["SET_SCROLL"] | 0x00, c["SET_DISP"] | 0x01]))
+
+    def show(self):
+        """OLED::show(): a window command and a data burst per dirty page"""
+        for page in range(self.pages):
+            if self.rng.random() < 0.5:
+                continue
+            x0 = self.rng.randrange(self.width)
+            x1 = self.rng.randrange(x0, self.width)
+            for x in range(x0, x1 + 1):
+                self.buffer[page * self.width + x] = self.rng.randrange(256)
+            self.calls.append(("cmds", [self.c["SET_COL_ADDR"], x0, x1,
+                                        self.c["SET_PAGE_ADDR"], page, page]))
+            self.calls.append(("data", self.buffer[page * self.width + x0:
+                                                   page * self.width + x1 + 1]))
+        self.calls.append(("check", list(self.buffer)))
+
+    def present(self):
+        """OLED::present(): the whole frame behind one window command"""
+        self.buffer = [self.rng.randrange(256) for _ in self.buffer]
+        cmds = [self.c["SET_COL_ADDR"], 0, self.width - 1, self.c["SET_PAGE_ADDR"], 0,
+                self.pages - 1]
+        if len(cmds) > self.c["OLED_FRAME_CMDS_MAX"]:
+            raise SystemExit("window command longer than OLED_FRAME_CMDS_MAX")
+        self.calls.append(("frame", cmds, list(self.buffer)))
+        self.calls.append(("check", list(self.buffer)))
+
+
+def frame_i2c(c, calls):
+    """I2C: a list of transfers, each starting with its control byte"""
+    wire = []
+    for call in calls:
+        if call[0] == "cmds":
+            wire.append([c["OLED_CTRL_CMD"]] + call[1])
+        elif call[0] == "data":
+            wire.append([c["OLED_CTRL_DATA"]] + call[1])
+        elif call[0] == "frame":
+            wire.append([c["OLED_CTRL_CMD"]] + call[1])
+            wire.append([c["OLED_CTRL_DATA"]] + call[2])
+        else:
+            wire.append(call)
+    return wire
+
+
+def frame_spi(calls):
+    """SPI: (dc, byte) pairs as latched under CS"""
+    wire = []
+    for call in calls:
+        if call[0] == "cmds":
+            wire.extend((0, b) for b in call[1])
+        elif call[0] == "data":
+            wire.extend((1, b) for b in call[1])
+        elif call[0] == "frame":
+            wire.extend((0, b) for b in call[1])
+            wire.extend((1, b) for b in call[2])
+        else:
+            wire.append(call)
+    return wire
+
+
+def decode_i2c(c, wire):
+    stream = []
+    for transfer in wire:
+        if transfer[0] == "check":
+            stream.append(transfer)
+            continue
+        control, payload = transfer[0], transfer[1:]
+        if control == c["OLED_CTRL_CMD"]:
+            dc = 0
+        elif control == c["OLED_CTRL_DATA"]:
+            dc = 1
+        else:
+            raise SystemExit("unknown control byte 0x%02x" % control)
+        stream.extend((dc, b) for b in payload)
+    return stream
+
+
+class Controller:
+    """SSD1306 command parser and GDDRAM in horizontal addressing mode"""
+
+    def __init__(self, c, width, pages):
+        self.width, self.pages = width, pages
+        self.ram = [0] * (width * pages)
+        self.args = {c[name]: n for name, n in ARGS.items() if name in c}
+        self.col_addr, self.page_addr = c["SET_COL_ADDR"], c["SET_PAGE_ADDR"]
+        self.window = (0, width - 1, 0, pages - 1)
+        self.col, self.page = 0, 0
+        self.pending = []
+
+    def feed(self, dc, byte):
+        if dc:
+            self.ram[self.page * self.width + self.col] = byte
+            c0, c1, p0, p1 = self.window
+            self.col += 1
+            if self.col > c1:
+                self.col = c0
+                self.page = p0 if self.page >= p1 else self.page + 1
+            return
+        self.pending.append(byte)
+        if len(self.pending) <= self.args.get(self.pending[0], 0):
+            return
+        op, args = self.pending[0], self.pending[1:]
+        self.pending = []
+        c0, c1, p0, p1 = self.window
+        if op == self.col_addr:
+            c0, c1 = args
+            self.col = c0
+        elif op == self.page_addr:
+            p0, p1 = args
+            self.page = p0
+        self.window = (c0, c1, p0, p1)
+
+
+def run(c, width, height, frames, seed, verbose):
+    rng = random.Random(seed)
+    session = Session(c, width, height, rng)
+    session.init()
+    for n in range(frames):
+        if n % 5 == 4:
+            session.present()
+        else:
+            session.show()
+
+    i2c = decode_i2c(c, frame_i2c(c, session.calls))
+    spi = frame_spi(session.calls)
+    if i2c != spi:
+        first = next(i for i, (a, b) in enumerate(zip(i2c, spi)) if a != b)
+        print("FAIL streams differ at byte %d: i2c %s spi %s" % (first, i2c[first],
+                                                                 spi[first]))
+        return False
+
+    controller = Controller(c, width, height // 8)
+    checks = 0
+    for item in i2c:
+        if item[0] == "check":
+            checks += 1
+            if controller.ram != item[1]:
+                print("FAIL GDDRAM differs from the framebuffer at flush %d" % checks)
+                return False
+        else:
+            controller.feed(*item)
+    if verbose:
+        print("%dx%d: %d stream bytes, %d flushes" % (width, height, len(i2c) - checks,
+                                                     checks))
+    return True
+
+
+SPI_SHIM = r"""
+#include <stdint.h>
+
+#include "spi_transport.hpp"
+
+namespace {
+SPIOLEDTransport *panels[2];
+int flushed[2];
+
+void on_done(void *ctx) { ++flushed[(intptr_t)ctx]; }
+}  // namespace
+
+extern "C" {
+void spi_new(uint cs0, uint dc0, uint cs1, uint dc1) {
+  panels[0] = new SPIOLEDTransport(dc0, PIN_UNUSED, cs0);
+  panels[1] = new SPIOLEDTransport(dc1, PIN_UNUSED, cs1);
+}
+void spi_delete() {
+  delete panels[0];
+  delete panels[1];
+}
+void spi_cmds(int p, const uint8_t *cmds, uint16_t len) { panels[p]->write_cmds(cmds, len); }
+void spi_data(int p, const uint8_t *data, uint16_t len) { panels[p]->write_data(data, len); }
+bool spi_frame(int p, const uint8_t *cmds, uint8_t cmd_len, uint8_t *data, uint16_t len) {
+  return panels[p]->write_frame_async(cmds, cmd_len, data, len, on_done, (void *)(intptr_t)p);
+}
+bool spi_busy(int p) { return panels[p]->is_busy(); }
+int spi_flushed(int p) { return flushed[p]; }
+}
+"""
+
+PINS = ((17, 20), (13, 21))  # (CS, D/C) per panel, both on spi0
+
+
+def bytes_of(values):
+    return (ctypes.c_uint8 * len(values))(*values)
+
+
+def run_shared_spi(c, frames, seed, verbose):
+    """Two panels on spi0, driven through the firmware's SPIOLEDTransport"""
+    with tempfile.TemporaryDirectory() as workdir:
+        lib = pico_host.build(workdir, ["ssd1306/spi_transport.cpp"], SPI_SHIM, "spi")
+        return shared_spi_session(c, lib, frames, seed, verbose)
+
+
+def shared_spi_session(c, lib, frames, seed, verbose):
+    failures = []
+    rng = random.Random(seed)
+    lib.spi_frame.restype = ctypes.c_bool
+    lib.spi_busy.restype = ctypes.c_bool
+    lib.spi_new(PINS[0][0], PINS[0][1], PINS[1][0], PINS[1][1])
+    sessions = [Session(c, 128, 64, rng), Session(c, 128, 64, rng)]
+    sent = [0, 0]       # calls of each session already executed
+    presented = [0, 0]  # frames started per panel
+    keep = []           # frame buffers stay alive until the DMA is done
+
+    def frame(p, cmds, data):
+        buf, cmd_buf = bytes_of(data), bytes_of(cmds)
+        keep.extend((buf, cmd_buf))
+        while not lib.spi_frame(p, cmd_buf, len(cmds), buf, len(data)):
+            lib.host_advance_ns(10000)
+        presented[p] += 1
+
+    def execute(p):
+        for call in sessions[p].calls[sent[p]:]:
+            if call[0] == "cmds":
+                lib.spi_cmds(p, bytes_of(call[1]), len(call[1]))
+            elif call[0] == "data":
+                lib.spi_data(p, bytes_of(call[1]), len(call[1]))
+            elif call[0] == "frame":
+                frame(p, call[1], call[2])
+        sent[p] = len(sessions[p].calls)
+
+    # a frame in flight on panel 0 makes the block busy for panel 1
+    sessions[0].present()
+    execute(0)
+    if not lib.spi_busy(1):
+        failures.append("shared spi: the other panel sees the block idle mid-frame")
+    if lib.spi_frame(1, bytes_of([0]), 1, bytes_of([0]), 1):
+        failures.append("shared spi: a second frame started on a busy block")
+        lib.host_advance_ns(5000000)
+        presented[1] += 1
+
+    for p in (0, 1):
+        sessions[p].init()
+        execute(p)
+    for _ in range(frames):
+        p = rng.randrange(2)
+        while lib.spi_flushed(p) < presented[p]:  # OLED waits for its own frame
+            lib.host_advance_ns(10000)
+        if rng.random() < 0.4:
+            sessions[p].present()
+        else:
+            sessions[p].show()
+        execute(p)
+        lib.host_advance_ns(rng.randrange(1200000))
+    while any(lib.spi_flushed(p) < presented[p] for p in (0, 1)):
+        lib.host_advance_ns(10000)
+    lib.spi_delete()
+
+    streams = [[], []]
+    for byte in pico_host.spi_capture(lib):
+        selected = []
+        for p, (cs, dc) in enumerate(PINS):
+            start, end = not byte.gpio_start >> cs & 1, not byte.gpio_end >> cs & 1
+            if start != end:
+                failures.append("shared spi: CS %d changed inside a byte" % cs)
+            elif start:
+                selected.append(p)
+                if (byte.gpio_start ^ byte.gpio_end) >> dc & 1:
+                    failures.append("shared spi: D/C %d changed inside a byte" % dc)
+                streams[p].append((byte.gpio_start >> dc & 1, byte.value))
+        if len(selected) != 1:
+            failures.append("shared spi: byte 0x%02x at %d ns with %d panels selected" % (
+                byte.value, byte.end_ns, len(selected)))
+        if len(failures) > 5:
+            break
+    if lib.host_spi_resets_while_busy():
+        failures.append("shared spi: the block was reset while busy")
+
+    for p in (0, 1):
+        want = [b for b in frame_spi(sessions[p].calls) if b[0] != "check"]
+        if not failures and streams[p] != want:
+            failures.append("shared spi: panel %d stream differs from its calls" % p)
+        controller = Controller(c, 128, 8)
+        for dc, b in streams[p]:
+            controller.feed(dc, b)
+        if not failures and controller.ram != sessions[p].buffer:
+            failures.append("shared spi: panel %d GDDRAM differs from its framebuffer" % p)
+    if verbose:
+        print("shared spi: %d bytes, %d + %d frames in %.1f ms" % (
+            sum(len(s) for s in streams), presented[0], presented[1],
+            lib.host_now_ns() / 1e6))
+    for failure in failures:
+        print("FAIL " + failure)
+    return not failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Replay the OLED transport streams")
+    parser.add_argument("--frames", type=int, default=20)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+
+    c = constants()
+    ok = True
+    for width, height in ((128, 64), (128, 32)):
+        ok &= run(c, width, height, args.frames, args.seed, args.verbose)
+    ok &= run_shared_spi(c, args.frames, args.seed, args.verbose)
+    print("ok" if ok else "check failed")
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -7,3 +7,9 @@
 #include "tps25750.hpp"
 
 TPS25750 *TPS25750::inst = nullptr;
+
+TPS25750::TPS25750() : i2c(I2C()), regs(&i2c) {}
+
+TPS25750::~TPS25750() {}
+
+/* END OF FILE */
@@ -30,6 +30,8 @@
 #include <cstdint>
 
 #include "../i2c/i2c.hpp"
+#include "../i2c/reg_cache.hpp"
+#include "tps2575x_register_map.hpp"
 
 static constexpr uint8_t TPS25750_EXTERNAL_EEPROM_ADDRESS = 0x50;
 
@@ -41,6 +43,21 @@ enum TPS25750_SLAVE_ADDRESSES {
   TPS25750_SADDR_4 = 0b001000110
 };
 
+static constexpr uint8_t TPS25750_ADDRESS = TPS25750_SADDR_1 >> 1;
+
+/* Every host interface transfer carries a byte count after the register */
+struct TPS25750_REGS {
+  static constexpr uint8_t ADDRESS = TPS25750_ADDRESS;
+  static constexpr bool BYTE_COUNT = true;
+  static constexpr RegDesc REGS[] = {
+      TPS_MODE::desc(true),
+      TPS_TYPE::desc(false),
+      TPS_CUSTUSE::desc(false),
+      TPS_CMD1::desc(true),
+      TPS_DATA1::desc(true),
+  };
+};
+
 class TPS25750 {
  public:
   static TPS25750 *inst;
@@ -52,6 +69,27 @@ class TPS25750 {
     return inst;
   }
 
+  /**
+   * @brief Reads a whole register, constant registers come from RAM after
+   * the first read.
+   *
+   * @return number of data bytes, or PICO_ERROR_GENERIC
+   */
+  int read_register(TPS2575X_USB_PD_REGISTER reg, uint8_t *dst) {
+    return regs.read(reg, dst);
+  }
+
+  int write_register(TPS2575X_USB_PD_REGISTER reg, const uint8_t *src) {
+    return regs.write(reg, src);
+  }
+
+  void invalidate_cache() { regs.invalidate(); }
+
+  /**
+   * @return bus transactions avoided by the register cache.
+   */
+  uint32_t get_saved_transactions() const { return regs.get_saved(); }
+
  private:
   TPS25750();
   ~TPS25750();
@@ -60,6 +98,7 @@ class TPS25750 {
 
   /* private members */
   I2C i2c;
+  RegCache<TPS25750_REGS> regs;
 };
 
 #endif /* END _TSP25750_H */
@@ -1,3 +1,7 @@
+#pragma once
+
+#include "../i2c/reg_field.hpp"
+
 enum TPS2575X_USB_PD_REGISTER {
   /**
    * Access: RO
@@ -35,3 +39,10 @@ enum TPS2575X_USB_PD_REGISTER {
    * */
   USB_PD_DATA1 = 0x09,
 };
+
+/* Typed registers, widths from the host interface reference */
+typedef Register<USB_PD_MODE, 4> TPS_MODE;
+typedef Register<USB_PD_TYPE, 4> TPS_TYPE;
+typedef Register<USB_PD_CUSTUSE, 8> TPS_CUSTUSE;
+typedef Register<USB_PD_CMD1, 4> TPS_CMD1;
+typedef Register<USB_PD_DATA1, 64> TPS_DATA1;
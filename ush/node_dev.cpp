@@ -1,5 +1,6 @@
 #include "picoshell.h"
 #include "../utils/common.hpp"
+#include "../ssd1306/glyph_cache.hpp"
 
 // led file get data callback
 size_t led_get_data_callback(struct ush_object *self,
@@ -41,6 +42,22 @@ size_t uptime_get_data_callback(struct ush_object *self,
   return strlen((char *)(*data));
 }
 
+// glyph cache file get data callback
+size_t glyphs_get_data_callback(struct ush_object *self,
+                                struct ush_file_descriptor const *file, uint8_t **data) {
+  static char stats_buf[64];
+  // don't create the cache just to report on it
+  if (GlyphCache::inst == nullptr) {
+    snprintf(stats_buf, sizeof(stats_buf), "glyph cache not in use\r\n");
+  } else {
+    const GlyphCacheStats &stats = GlyphCache::inst->get_stats();
+    snprintf(stats_buf, sizeof(stats_buf), "hits: %lu misses: %lu evictions: %lu\r\n",
+             (unsigned long)stats.hits, (unsigned long)stats.misses,
+             (unsigned long)stats.evictions);
+  }
+  *data = (uint8_t *)stats_buf;
+  return strlen((char *)(*data));
+}
 
 // dev directory handler
 static struct ush_node_object dev;
@@ -62,6 +79,13 @@ static const struct ush_file_descriptor dev_files[] = {
     .exec = NULL,
     .get_data = uptime_get_data_callback,
   },
+  {
+    .name = "glyphs",
+    .description = "glyph cache hit/miss counters",
+    .help = NULL,
+    .exec = NULL,
+    .get_data = glyphs_get_data_callback,
+  },
 };
 
 extern struct ush_object ush;
@@ -1,4 +1,12 @@
+#include <cstdlib>
+
+#include "hardware/clocks.h"
 #include "picoshell.h"
+#include "../ap33772/ap33772.hpp"
+#include "../ssd1306/raster.hpp"
+#include "../stusb4500/stusb4500.hpp"
+#include "../utils/heap_stats.hpp"
+#include "../utils/units.hpp"
 
 #define AIRCR_Register (*((volatile uint32_t*)(PPB_BASE + 0x0ED0C))) //for reboot
 
@@ -10,6 +18,136 @@ static void reboot_exec_callback(struct ush_object *self,
   AIRCR_Register = 0x5FA0004;
 }
 
+// heapsoak cmd file execute callback
+static void heapsoak_exec_callback(struct ush_object *self,
+                                   struct ush_file_descriptor const *file, int argc,
+                                   char *argv[]) {
+  if (argc > 2) {
+    ush_print_status(self, USH_STATUS_ERROR_COMMAND_WRONG_ARGUMENTS);
+    return;
+  }
+  long loops = (argc == 2) ? atol(argv[1]) : 10000;
+  if (loops <= 0) {
+    ush_print_status(self, USH_STATUS_ERROR_COMMAND_WRONG_ARGUMENTS);
+    return;
+  }
+
+  // the one allocation the driver makes happens before the probe
+  STUSB4500 *pd = STUSB4500::get_instance();
+  HeapProbe probe;
+  for (long i = 0; i < loops; ++i) {
+    uint8_t num = pd->get_pdo_num();
+    for (uint8_t n = 1; n <= num && n <= PDO_3; ++n) pd->load_pdo((PDO_NUM)n);
+  }
+  ush_printf(self, "%ld loops, heap delta %ld bytes\r\n", loops, probe.delta());
+}
+
+// clk_sys cycles per loop, from the microseconds a loop of n took
+static uint32_t cycles_per_loop(uint32_t us, long loops) {
+  return (uint64_t)us * (clock_get_hz(clk_sys) / 1000000) / loops;
+}
+
+// unitbench cmd file execute callback
+static void unitbench_exec_callback(struct ush_object *self,
+                                    struct ush_file_descriptor const *file, int argc,
+                                    char *argv[]) {
+  if (argc > 2) {
+    ush_print_status(self, USH_STATUS_ERROR_COMMAND_WRONG_ARGUMENTS);
+    return;
+  }
+  long loops = (argc == 2) ? atol(argv[1]) : 100000;
+  if (loops <= 0) {
+    ush_print_status(self, USH_STATUS_ERROR_COMMAND_WRONG_ARGUMENTS);
+    return;
+  }
+
+  // volatile on both ends, so neither path is folded away
+  volatile uint16_t raw = 180;  // 9V fixed PDO code
+  volatile float volts, amps;
+  volatile int32_t mv, ma;
+
+  // the old path: PDO fields and ADC codes scaled to float volts and amps
+  uint32_t start = time_us_32();
+  for (long i = 0; i < loops; ++i) {
+    volts = (raw * 50) / 1000.0;
+    amps = (raw * 10) / 1000.0;
+    volts = (raw * 80) / 1000.0f;
+    amps = (raw * 24) / 1000.0f;
+  }
+  uint32_t float_us = time_us_32() - start;
+
+  start = time_us_32();
+  for (long i = 0; i < loops; ++i) {
+    mv = PD_FIXED_VOLTAGE::decode(raw).value();
+    ma = PD_FIXED_CURRENT::decode(raw).value();
+    mv = AP33772_ADC_VOLTAGE::decode(raw).value();
+    ma = AP33772_ADC_CURRENT::decode(raw).value();
+  }
+  uint32_t fixed_us = time_us_32() - start;
+  (void)volts, (void)amps, (void)mv, (void)ma;
+
+  ush_printf(self, "float: %lu cycles, Quantity: %lu cycles per 4 conversions\r\n",
+             (unsigned long)cycles_per_loop(float_us, loops),
+             (unsigned long)cycles_per_loop(fixed_us, loops));
+}
+
+// rasterbench cmd file execute callback
+static void rasterbench_exec_callback(struct ush_object *self,
+                                      struct ush_file_descriptor const *file, int argc,
+                                      char *argv[]) {
+  if (argc > 2) {
+    ush_print_status(self, USH_STATUS_ERROR_COMMAND_WRONG_ARGUMENTS);
+    return;
+  }
+  long loops = (argc == 2) ? atol(argv[1]) : 1000;
+  if (loops <= 0) {
+    ush_print_status(self, USH_STATUS_ERROR_COMMAND_WRONG_ARGUMENTS);
+    return;
+  }
+
+  // a 128x64 framebuffer, word aligned like OLED's
+  alignas(4) static uint8_t frame[128 * 64 / 8];
+  volatile uint8_t x1 = 0, y1 = 5, x2 = 127, y2 = 58;  // not folded away
+  volatile uint8_t r = 30;
+
+  // the old path: float slope and one multiply-add per column, shallow lines only
+  uint32_t start = time_us_32();
+  for (long i = 0; i < loops; ++i) {
+    float slope = (float)(y2 - y1) / (float)(x2 - x1);
+    for (uint8_t x = x1; x <= x2; ++x) {
+      uint8_t y = slope * (float)(x - x1) + (float)y1;
+      frame[x + 128 * (y / 8)] |= 0x01 << (y % 8);
+    }
+  }
+  uint32_t float_us = time_us_32() - start;
+
+  start = time_us_32();
+  for (long i = 0; i < loops; ++i) raster_line(frame, 128, 64, x1, y1, x2, y2);
+  uint32_t line_us = time_us_32() - start;
+
+  start = time_us_32();
+  for (long i = 0; i < loops; ++i) {
+    raster_line(frame, 128, 64, y1, x1, y2, x2 / 2);  // (5, 0) - (58, 63)
+  }
+  uint32_t steep_us = time_us_32() - start;
+
+  start = time_us_32();
+  for (long i = 0; i < loops; ++i) raster_circle(frame, 128, 64, 64, 32, r);
+  uint32_t circle_us = time_us_32() - start;
+
+  start = time_us_32();
+  for (long i = 0; i < loops; ++i) raster_filled_circle(frame, 128, 64, 64, 32, r);
+  uint32_t filled_us = time_us_32() - start;
+
+  ush_printf(self, "float line: %lu, line: %lu, steep line: %lu cycles\r\n",
+             (unsigned long)cycles_per_loop(float_us, loops),
+             (unsigned long)cycles_per_loop(line_us, loops),
+             (unsigned long)cycles_per_loop(steep_us, loops));
+  ush_printf(self, "circle r30: %lu, filled circle r30: %lu cycles\r\n",
+             (unsigned long)cycles_per_loop(circle_us, loops),
+             (unsigned long)cycles_per_loop(filled_us, loops));
+}
+
 // cmd commands handler
 static struct ush_node_object cmd;
 
@@ -21,6 +159,24 @@ static const struct ush_file_descriptor cmd_files[] = {
     .help = NULL,
     .exec = reboot_exec_callback,
   },
+  {
+    .name = "heapsoak",
+    .description = "check the STUSB4500 read path for heap growth",
+    .help = "usage: heapsoak [loops]\r\n",
+    .exec = heapsoak_exec_callback,
+  },
+  {
+    .name = "unitbench",
+    .description = "time float against Quantity unit conversions",
+    .help = "usage: unitbench [loops]\r\n",
+    .exec = unitbench_exec_callback,
+  },
+  {
+    .name = "rasterbench",
+    .description = "time the line and circle kernels per primitive",
+    .help = "usage: rasterbench [loops]\r\n",
+    .exec = rasterbench_exec_callback,
+  },
 };
 
 extern struct ush_object ush;
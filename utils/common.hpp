@@ -31,8 +31,8 @@ static constexpr uint I2C_DEFAULT_SCL = PICO_DEFAULT_I2C_SCL_PIN;
 
 /* Default SPI Params */
 static constexpr uint32_t SPI_DEFAULT_BAUDRATE = 1000000;  // 1MHz
-static constexpr uint SPI_DEFAULT_MOSI = PICO_DEFAULT_SPI_RX_PIN;
-static constexpr uint SPI_DEFAULT_MISO = PICO_DEFAULT_SPI_TX_PIN;
+static constexpr uint SPI_DEFAULT_MOSI = PICO_DEFAULT_SPI_TX_PIN;
+static constexpr uint SPI_DEFAULT_MISO = PICO_DEFAULT_SPI_RX_PIN;
 static constexpr uint SPI_DEFAULT_SCLK = PICO_DEFAULT_SPI_SCK_PIN;
 static constexpr uint SPI_DEFAULT_CS = PICO_DEFAULT_SPI_CSN_PIN;
 
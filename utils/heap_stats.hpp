@@ -0,0 +1,44 @@
+/** @file heap_stats.hpp
+ *
+ * @brief Heap usage probe, used to check that driver paths do not allocate.
+ *
+ * @par
+ * Reads the allocator's in-use byte count through mallinfo(), which newlib
+ * (the pico-sdk C library) and glibc both provide, so the same check runs on
+ * the board and on a host build.
+ */
+
+#ifndef _HEAP_STATS_H
+#define _HEAP_STATS_H
+
+#include <malloc.h>
+#include <stddef.h>
+
+/**
+ * @return bytes currently allocated from the heap.
+ */
+static inline size_t heap_in_use() { return mallinfo().uordblks; }
+
+/**
+ * @brief Records heap use at construction, delta() reports the growth since.
+ *
+ * @code
+ * HeapProbe probe;
+ * for (int i = 0; i < 1000000; ++i) pd->get_pdo_num();
+ * assert(probe.delta() == 0);
+ * @endcode
+ */
+class HeapProbe {
+ public:
+  HeapProbe() : start(heap_in_use()) {}
+
+  long delta() const { return (long)heap_in_use() - (long)start; }
+  void reset() { start = heap_in_use(); }
+
+ private:
+  size_t start;
+};
+
+#endif  // END _HEAP_STATS_H
+
+/* END OF FILE */
@@ -0,0 +1,74 @@
+/** @file history_ring.hpp
+ *
+ * @brief A lock-free ring that keeps the newest N - 1 items.
+ *
+ * @par
+ * Unlike SPSCRing, a full ring overwrites its oldest item, so the consumer
+ * never has to keep up and can copy out recent history at any time. The
+ * producer (usually an IRQ handler) is the only writer. Readers copy without
+ * disabling interrupts and then drop anything the producer may have
+ * overwritten during the copy. The slot the producer writes next is never
+ * read, which is why one slot of N is not readable.
+ */
+
+#ifndef _HISTORY_RING_H
+#define _HISTORY_RING_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "hardware/sync.h"
+
+template <typename T, uint16_t N>
+class HistoryRing {
+  static_assert(N > 1 && (N & (N - 1)) == 0, "ring length must be a power of two");
+
+ public:
+  /* producer side */
+  void push(const T &item) {
+    uint32_t h = head;
+    slots[h & (N - 1)] = item;
+    __dmb();
+    head = h + 1;
+  }
+
+  /* items pushed since construction or clear() */
+  uint32_t get_count() const { return head; }
+  uint16_t size() const { return head < N ? head : N - 1; }
+
+  /**
+   * @brief Copies up to max of the newest items into dst, oldest first.
+   *
+   * @return number of items copied
+   */
+  size_t copy_latest(T *dst, size_t max) const {
+    uint32_t h = head;
+    __dmb();
+    size_t n = h < N ? h : N - 1;
+    if (n > max) n = max;
+    uint32_t first = h - n;
+    for (size_t i = 0; i < n; ++i) dst[i] = slots[(first + i) & (N - 1)];
+    __dmb();
+
+    /* the producer may have wrapped onto the start of the copy */
+    uint32_t oldest_intact = head + 1 - N;
+    if ((int32_t)(oldest_intact - first) > 0) {
+      size_t lost = oldest_intact - first;
+      if (lost >= n) return 0;
+      memmove(dst, &dst[lost], (n - lost) * sizeof(T));
+      n -= lost;
+    }
+    return n;
+  }
+
+  /* only while the producer is stopped */
+  void clear() { head = 0; }
+
+ private:
+  T slots[N];
+  volatile uint32_t head = 0;  // written by the producer only
+};
+
+#endif  // END _HISTORY_RING_H
+
+/* END OF FILE */
@@ -0,0 +1,70 @@
+/** @file spsc_ring.hpp
+ *
+ * @brief A lock-free single producer, single consumer ring buffer.
+ *
+ * @par
+ * The producer (usually an IRQ handler) only writes head and the consumer
+ * only writes tail, so neither side needs to disable interrupts. A memory
+ * barrier orders the slot copy against the index update. When the ring is
+ * full new items are dropped and counted.
+ */
+
+#ifndef _SPSC_RING_H
+#define _SPSC_RING_H
+
+#include <stdint.h>
+
+#include "hardware/sync.h"
+
+template <typename T, uint8_t N>
+class SPSCRing {
+  static_assert(N > 1 && (N & (N - 1)) == 0, "ring length must be a power of two");
+
+ public:
+  /**
+   * @brief Producer side.
+   * @return false if the ring was full and item was dropped
+   */
+  bool push(const T &item) {
+    uint8_t h = head;
+    if ((uint8_t)(h - tail) == N) {
+      ++dropped;
+      return false;
+    }
+    slots[h & (N - 1)] = item;
+    __dmb();
+    head = h + 1;
+    return true;
+  }
+
+  /**
+   * @brief Consumer side.
+   * @return false if the ring was empty
+   */
+  bool pop(T *item) {
+    uint8_t t = tail;
+    if (t == head) return false;
+    __dmb();
+    *item = slots[t & (N - 1)];
+    __dmb();
+    tail = t + 1;
+    return true;
+  }
+
+  uint8_t size() const { return head - tail; }
+  bool empty() const { return head == tail; }
+
+  /* items lost to a full ring since the last reset_dropped() */
+  uint32_t get_dropped() const { return dropped; }
+  void reset_dropped() { dropped = 0; }
+
+ private:
+  T slots[N];
+  volatile uint8_t head = 0;  // written by the producer only
+  volatile uint8_t tail = 0;  // written by the consumer only
+  volatile uint32_t dropped = 0;
+};
+
+#endif  // END _SPSC_RING_H
+
+/* END OF FILE */
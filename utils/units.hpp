@@ -0,0 +1,125 @@
+/** @file units.hpp
+ *
+ * @brief Fixed-point electrical quantities for the USB-PD drivers.
+ *
+ * @par
+ * Each quantity is an integer count of one fixed unit wrapped in its own
+ * type, so a voltage cannot be passed where a current is expected and the
+ * drivers never touch float. The RP2040 has no FPU, so every float multiply
+ * or divide on a polled path is a soft-float library call. UnitCode converts
+ * a quantity to and from a chip's register encoding:
+ *
+ * @code
+ * Millivolts v = PD_FIXED_VOLTAGE::decode(pdo.fixed.voltage);  // 50mV LSB
+ * rdo.pps.voltage = PD_PPS_RDO_VOLTAGE::encode(9000_mV);       // 20mV LSB
+ * Milliwatts p = v * 3000_mA;
+ * @endcode
+ */
+
+#ifndef _UNITS_H
+#define _UNITS_H
+
+#include <stdint.h>
+
+template <typename TAG>
+class Quantity {
+ public:
+  constexpr Quantity() : count(0) {}
+  constexpr explicit Quantity(int32_t count) : count(count) {}
+
+  constexpr int32_t value() const { return count; }
+
+  constexpr Quantity operator+(Quantity other) const {
+    return Quantity(count + other.count);
+  }
+
+  constexpr Quantity operator-(Quantity other) const {
+    return Quantity(count - other.count);
+  }
+
+  constexpr Quantity operator*(int32_t k) const { return Quantity(count * k); }
+  constexpr Quantity operator/(int32_t k) const { return Quantity(count / k); }
+  constexpr int32_t operator/(Quantity other) const { return count / other.count; }
+
+  constexpr Quantity &operator+=(Quantity other) {
+    count += other.count;
+    return *this;
+  }
+
+  constexpr Quantity &operator-=(Quantity other) {
+    count -= other.count;
+    return *this;
+  }
+
+  constexpr bool operator==(Quantity other) const { return count == other.count; }
+  constexpr bool operator!=(Quantity other) const { return count != other.count; }
+  constexpr bool operator<(Quantity other) const { return count < other.count; }
+  constexpr bool operator<=(Quantity other) const { return count <= other.count; }
+  constexpr bool operator>(Quantity other) const { return count > other.count; }
+  constexpr bool operator>=(Quantity other) const { return count >= other.count; }
+
+ private:
+  int32_t count;
+};
+
+struct MillivoltTag {};
+struct MilliampTag {};
+struct MilliwattTag {};
+struct CentidegreeTag {};
+
+typedef Quantity<MillivoltTag> Millivolts;
+typedef Quantity<MilliampTag> Milliamps;
+typedef Quantity<MilliwattTag> Milliwatts;
+typedef Quantity<CentidegreeTag> Centidegrees;  // 0.01 C
+
+constexpr Millivolts operator""_mV(unsigned long long count) { return Millivolts(count); }
+constexpr Milliamps operator""_mA(unsigned long long count) { return Milliamps(count); }
+constexpr Milliwatts operator""_mW(unsigned long long count) { return Milliwatts(count); }
+constexpr Centidegrees operator""_cC(unsigned long long count) {
+  return Centidegrees(count);
+}
+
+/* 48V * 5A is 2.4e8 before the divide, well inside int32_t */
+constexpr Milliwatts operator*(Millivolts v, Milliamps i) {
+  return Milliwatts(v.value() * i.value() / 1000);
+}
+
+constexpr Milliwatts operator*(Milliamps i, Millivolts v) { return v * i; }
+
+/**
+ * @brief A register encoding of QUANTITY with an LSB of LSB units. encode()
+ * rounds down and maps negative values to 0.
+ */
+template <typename QUANTITY, int32_t LSB>
+struct UnitCode {
+  static_assert(LSB > 0, "LSB must be positive");
+
+  typedef QUANTITY quantity;
+
+  static constexpr uint32_t encode(QUANTITY q) {
+    return q.value() < 0 ? 0 : (uint32_t)(q.value() / LSB);
+  }
+
+  static constexpr QUANTITY decode(uint32_t raw) { return QUANTITY((int32_t)raw * LSB); }
+
+  /* raw scaled by 256, e.g. the mean of several codes */
+  static constexpr QUANTITY decode_q8(uint32_t raw_q8) {
+    return QUANTITY((int32_t)(raw_q8 * LSB) >> 8);
+  }
+
+  /* true if q survives an encode/decode round trip */
+  static constexpr bool exact(QUANTITY q) {
+    return q.value() >= 0 && q.value() % LSB == 0;
+  }
+};
+
+/* USB-PD data object encodings */
+typedef UnitCode<Millivolts, 50> PD_FIXED_VOLTAGE;    // fixed supply PDO
+typedef UnitCode<Milliamps, 10> PD_FIXED_CURRENT;     // fixed supply PDO and RDO
+typedef UnitCode<Millivolts, 100> PD_PPS_VOLTAGE;     // PPS APDO
+typedef UnitCode<Milliamps, 50> PD_PPS_CURRENT;       // PPS APDO and RDO
+typedef UnitCode<Millivolts, 20> PD_PPS_RDO_VOLTAGE;  // PPS RDO output voltage
+
+#endif  // END _UNITS_H
+
+/* END OF FILE */